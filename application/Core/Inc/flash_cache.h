@@ -0,0 +1,104 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * flash_cache.h
+ *
+ * @brief Page granular LRU read cache for the W25Q128. Small repeated reads
+ *        of metadata, command records and fragment headers are served from
+ *        RAM. Programs and erases invalidate the pages they touch.
+*/
+
+#ifndef FLASH_CACHE_H_
+#define FLASH_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t hits;          /* Pages served from RAM */
+    uint32_t misses;        /* Pages read into the cache */
+    uint32_t bypassed;      /* Large reads not cached */
+    uint32_t invalidated;   /* Pages dropped by programs and erases */
+} FlashCacheStats_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+/* RAM budget in 256 byte pages, 0 disables the cache */
+#ifndef FLASH_CACHE_PAGES
+#define FLASH_CACHE_PAGES (16U)
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Read through the cache. Reads of several pages bypass it, so streaming a
+ *  fragment does not evict the small records. Not thread safe, call from
+ *  the flash scheduler task only.
+ * 
+ * @param address Start address
+ * @param data Output buffer
+ * @param size Bytes to read
+ * 
+ * @return true on success
+ */
+extern bool FLASH_CACHE_Read(uint32_t address, uint8_t* data, size_t size);
+
+/** Drop cached pages overlapping a range. Call before programming or
+ *  erasing the range.
+ * 
+ * @param address Start address
+ * @param size Range size
+ */
+extern void FLASH_CACHE_Invalidate(uint32_t address, size_t size);
+
+/** Get the cache counters
+ * 
+ * @return Counters since start-up
+ */
+extern FlashCacheStats_t FLASH_CACHE_GetStats(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF flash_cache.h */
+
+#endif /* FLASH_CACHE_H_ */
@@ -0,0 +1,141 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * flash_scheduler.h
+ *
+ * @brief W25Q128 I/O scheduler. One task owns the chip and serves requests
+ *        by priority class. Critical reads are served during long erases by
+ *        suspending the erase.
+*/
+
+#ifndef FLASH_SCHEDULER_H_
+#define FLASH_SCHEDULER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+/** Request priority, lower value is served first */
+typedef enum
+{
+    FLASH_CLASS_CRITICAL,   /* Reads, may interrupt an erase */
+    FLASH_CLASS_NORMAL,     /* Programs */
+    FLASH_CLASS_BACKGROUND, /* Erases */
+    FLASH_CLASS_COUNT,
+} FlashClass_t;
+
+/** Queue latency of one class, from submit to start of service */
+typedef struct
+{
+    uint32_t requests;
+    uint32_t totalWaitMs;
+    uint32_t maxWaitMs;
+    uint32_t servedInSuspend; /* Requests served with an erase suspended */
+} FlashClassStats_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Start the scheduler task. Requests made before this are executed directly
+ *  by the calling task.
+ * 
+ * @return true on success
+ */
+extern bool FLASH_SCHED_Init(void);
+
+/** Read through the page cache, usable as MemoryConfig_t Reader.
+ *  FLASH_CLASS_CRITICAL.
+ * 
+ * @param address Start address
+ * @param data Output buffer
+ * @param size Bytes to read
+ * 
+ * @return true on success
+ */
+extern bool FLASH_SCHED_Read(uint32_t address, uint8_t* data, size_t size);
+
+/** Program with W25Q128_WriteFlash, usable as MemoryConfig_t Writer.
+ *  FLASH_CLASS_NORMAL.
+ * 
+ * @param address Start address
+ * @param data Data to write
+ * @param size Data size
+ * 
+ * @return true on success
+ */
+extern bool FLASH_SCHED_Write(uint32_t address, const uint8_t* data, size_t size);
+
+/** Program with W25Qxx_INTERFACE_WriteAndVerifyFlash, usable as
+ *  MemoryConfig_t Writer. FLASH_CLASS_NORMAL.
+ * 
+ * @param address Start address
+ * @param data Data to write
+ * @param size Data size
+ * 
+ * @return true on success
+ */
+extern bool FLASH_SCHED_WriteAndVerify(uint32_t address, const uint8_t* data, size_t size);
+
+/** Erase with W25Q128_EraseFlash, usable as MemoryConfig_t Eraser.
+ *  FLASH_CLASS_BACKGROUND.
+ * 
+ * @param address 4 KB aligned start address
+ * @param size Multiple of 4 KB
+ * 
+ * @return true on success
+ */
+extern bool FLASH_SCHED_Erase(uint32_t address, size_t size);
+
+/** Get the queue latency statistics of a class
+ * 
+ * @param cls Request class
+ * @param out Statistics
+ * 
+ * @return false if cls is invalid
+ */
+extern bool FLASH_SCHED_GetStats(FlashClass_t cls, FlashClassStats_t* out);
+
+/** Print the statistics of all classes */
+extern void FLASH_SCHED_PrintStats(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF flash_scheduler.h */
+
+#endif /* FLASH_SCHEDULER_H_ */
@@ -0,0 +1,77 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * fw_backup.h
+ *
+ * @brief Background copy of the running firmware from internal flash into a
+ *        fragment slot. The slot holds the signed metadata of this firmware
+ *        and hash chained fragments, so it is a rollback target without any
+ *        upload from the host.
+*/
+
+#ifndef FW_BACKUP_H_
+#define FW_BACKUP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Start the backup task. A new slot is prepared by the task: the slot and
+ *  its fragment index are erased and FIRMWARE_METADATA is written. Otherwise
+ *  the slot must already hold FIRMWARE_METADATA, and the fragments stored in
+ *  it are kept, so an interrupted backup continues where it stopped.
+ * 
+ * @param slot Slot number
+ * @param address Slot start address in the W25Q128
+ * @param size Slot size
+ * @param prepare Erase the slot and write the metadata first
+ * 
+ * @return false if a backup is already running or the task can't be created
+ */
+extern bool BACKUP_Start(uint32_t slot, uint32_t address, uint32_t size, bool prepare);
+
+/** Get the slot being written by the backup task
+ * 
+ * @return slot number, -1 if no backup is running
+ */
+extern int BACKUP_ActiveSlot(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF fw_backup.h */
+
+#endif /* FW_BACKUP_H_ */
@@ -38,8 +38,11 @@ extern "C" {
 /* INCLUDE DIRECTIVES                                                         */
 /*----------------------------------------------------------------------------*/
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "fragmentstore/fragmentstore.h"
+
 /*----------------------------------------------------------------------------*/
 /* PUBLIC FUNCTION DECLARATIONS                                               */
 /*----------------------------------------------------------------------------*/
@@ -56,6 +59,19 @@ extern const uint8_t* KEYSTORE_GetMetadataPublicKey(void);
  */
 extern const uint8_t* KEYSTORE_GetFragmentPublicKey(void);
 
+/** 256-bit (32 byte) ed25519 public key of the firmware signature
+ * 
+ * @return public key
+ */
+extern const uint8_t* KEYSTORE_GetFirmwarePublicKey(void);
+
+/** Check the metadata signature with the metadata public key
+ * 
+ * @param metadata Pointer to metadata structure
+ * @return metadata is valid
+ */
+extern bool KEYSTORE_VerifyMetadata(const Metadata_t* metadata);
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
@@ -39,6 +39,7 @@ extern "C" {
 /*----------------------------------------------------------------------------*/
 
 #include "fragmentstore/fragmentstore.h"
+#include "digest_table.h"
 
 /*----------------------------------------------------------------------------*/
 /* PUBLIC VARIABLE DEFINITIONS                                                */
@@ -46,6 +47,8 @@ extern "C" {
 
 extern const Metadata_t FIRMWARE_METADATA;
 
+extern const DigestTable_t FIRMWARE_DIGESTS;
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
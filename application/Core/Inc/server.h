@@ -49,6 +49,24 @@ extern "C" {
 /* PUBLIC MACRO DEFINITIONS                                                   */
 /*----------------------------------------------------------------------------*/
 
+/* Protocol extensions of this server. The FwUpdateLibs response codes and
+   data identifiers are small values, the extensions use the top of the range. */
+
+/** Response to a fragment reference that no other slot can resolve, or
+ *  that is not verifyMethod 0. It is only sent for references, a malformed
+ *  fragment PDU still gets PROTOCOL_NACK_REQUEST_OUT_OF_RANGE. The client
+ *  sends the full fragment. A resolved reference is recorded in the
+ *  fragment index without writing the fragment.
+ */
+#define SERVER_NACK_REFERENCE_UNRESOLVED    (0xF0U)
+
+/** WriteDataById query with a fragment reference (a fragment without its
+ *  content). Nothing is written. PROTOCOL_ACK_OK if a slot holds the
+ *  content, SERVER_NACK_REFERENCE_UNRESOLVED if not, so the client knows
+ *  which form to send before sending anything.
+ */
+#define SERVER_DATA_ID_FRAGMENT_LOOKUP      (0xF0U)
+
 /*----------------------------------------------------------------------------*/
 /* PUBLIC VARIABLE DEFINITIONS                                                */
 /*----------------------------------------------------------------------------*/
@@ -61,6 +79,8 @@ extern void SERVER_UdpUpdateServer(w25qxx_handle_t* arg);
 
 extern void SERVER_NotifyCallback(void);
 
+extern void SERVER_PrintStats(void);
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
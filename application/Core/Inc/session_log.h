@@ -0,0 +1,194 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * session_log.h
+ *
+ * @brief Capture of an update session for replay on the host. Received
+ *        PDUs, response checksums, protocol callback results and flash
+ *        operation latencies are recorded as a stream of records, each
+ *        timestamped relative to the previous one. Recording is off until
+ *        SESSION_LOG_Start(), then every call appends to a datagram sized
+ *        buffer that is passed to the writer when full or flushed.
+*/
+
+#ifndef SESSION_LOG_H_
+#define SESSION_LOG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define SESSION_LOG_MAGIC       (0x474C5353U) /* "SSLG" */
+#define SESSION_LOG_VERSION     (1U)
+
+/* Writer calls are at most one UDP datagram */
+#define SESSION_LOG_BUFFER_SIZE (1472U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+typedef enum
+{
+    SESSION_REC_START,          /* SessionStart_t */
+    SESSION_REC_PDU,            /* Received packet */
+    SESSION_REC_RESPONSE,       /* SessionResponse_t */
+    SESSION_REC_CALLBACK,       /* SessionCallback_t, arg is SessionCallbackId_t */
+    SESSION_REC_FLASH,          /* SessionFlash_t, arg is SessionFlashOp_t */
+} SessionRecordType_t;
+
+typedef enum
+{
+    SESSION_CB_READ_DATA,
+    SESSION_CB_WRITE_DATA,
+    SESSION_CB_PUT_METADATA,
+    SESSION_CB_PUT_FRAGMENT,
+    SESSION_CB_COUNT,
+} SessionCallbackId_t;
+
+typedef enum
+{
+    SESSION_FLASH_READ,
+    SESSION_FLASH_WRITE,
+    SESSION_FLASH_ERASE,
+    SESSION_FLASH_COUNT,
+} SessionFlashOp_t;
+
+/** Record header, followed by size bytes. Little endian. */
+typedef struct __attribute__((packed))
+{
+    uint8_t  type;              /* SessionRecordType_t */
+    uint8_t  arg;
+    uint16_t size;
+    uint32_t deltaUs;           /* Since the previous record */
+} SessionRecord_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t version;
+} SessionStart_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t crc;               /* CRC32 of the response PDU */
+    uint16_t size;
+} SessionResponse_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t  result;            /* PROTOCOL_ACK_OK or NACK code */
+    uint32_t durationUs;
+} SessionCallback_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t address;
+    uint32_t size;
+    uint32_t durationUs;
+    uint8_t  ok;
+} SessionFlash_t;
+
+/** Receives the log stream in pieces of at most SESSION_LOG_BUFFER_SIZE */
+typedef void (*SessionLogWriter_t)(const uint8_t* data, size_t size);
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Start recording with a start record
+ * 
+ * @param writer Log stream output
+ */
+extern void SESSION_LOG_Start(SessionLogWriter_t writer);
+
+/** Flush and stop recording */
+extern void SESSION_LOG_Stop(void);
+
+/** Check if recording
+ * 
+ * @return true after SESSION_LOG_Start()
+ */
+extern bool SESSION_LOG_Active(void);
+
+/** Get the time base of the recorded durations
+ * 
+ * @return Free running microseconds
+ */
+extern uint32_t SESSION_LOG_Now(void);
+
+/** Record a received PDU
+ * 
+ * @param pdu Packet
+ * @param size Packet size
+ */
+extern void SESSION_LOG_Pdu(const uint8_t* pdu, size_t size);
+
+/** Record the response sent for the last PDU
+ * 
+ * @param response Packet
+ * @param size Packet size
+ */
+extern void SESSION_LOG_Response(const uint8_t* response, size_t size);
+
+/** Record a protocol callback result
+ * 
+ * @param id Callback
+ * @param result Returned ACK or NACK code
+ * @param startUs SESSION_LOG_Now() at the call
+ */
+extern void SESSION_LOG_Callback(SessionCallbackId_t id, uint8_t result, uint32_t startUs);
+
+/** Record a flash operation
+ * 
+ * @param op Operation
+ * @param address Start address
+ * @param size Bytes
+ * @param ok Operation result
+ * @param startUs SESSION_LOG_Now() at the call
+ */
+extern void SESSION_LOG_Flash(SessionFlashOp_t op, uint32_t address, size_t size, bool ok, uint32_t startUs);
+
+/** Pass the buffered records to the writer */
+extern void SESSION_LOG_Flush(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF session_log.h */
+
+#endif /* SESSION_LOG_H_ */
@@ -0,0 +1,87 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * slot_alloc.h
+ *
+ * @brief Allocation of firmware slots in the external flash partition table.
+ *        Slots are sized to the firmware and placed in free slot space. When
+ *        no space is left the least recently allocated unprotected slot is
+ *        evicted.
+*/
+
+#ifndef SLOT_ALLOC_H_
+#define SLOT_ALLOC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "partition_table.h"
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Allocate a slot in the table. Only the table in RAM is changed, store it
+ *  before using the slot.
+ * 
+ * @param table Partition table
+ * @param size Extent size, see PARTITION_SlotSizeFor
+ * @param protectMask Slots that may not be evicted, bit per slot number.
+ *                    Slots referred to by a fragment index are always kept.
+ * @param slot Output slot number
+ * @param evictedMask Output slots evicted to make room
+ * 
+ * @return true on success
+ */
+extern bool SLOT_ALLOC_Allocate(
+    PartitionTable_t* table,
+    uint32_t size,
+    uint32_t protectMask,
+    uint32_t* slot,
+    uint32_t* evictedMask);
+
+/** Write the table into the older copy with an incremented sequence. The
+ *  other copy stays valid if the write is interrupted.
+ * 
+ * @param table Partition table, sequence and CRC are updated
+ * 
+ * @return true on success
+ */
+extern bool SLOT_ALLOC_Store(PartitionTable_t* table);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF slot_alloc.h */
+
+#endif /* SLOT_ALLOC_H_ */
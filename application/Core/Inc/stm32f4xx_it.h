@@ -56,7 +56,11 @@ void EXTI15_10_IRQHandler(void);
 void TIM6_DAC_IRQHandler(void);
 void ETH_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void DMA1_Stream0_IRQHandler(void);
+void DMA1_Stream5_IRQHandler(void);
+void SPI3_IRQHandler(void);
 void TIM6_Delay_us(uint32_t us);
+uint32_t TIM6_GetTime_us(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
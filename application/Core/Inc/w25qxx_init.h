@@ -41,6 +41,36 @@ extern "C" {
 #include "driver_w25qxx.h"
 #include "stm32f4xx_hal.h"
 
+#include <stdbool.h>
+#include <stddef.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+/** Called between the busy polls of an erase started by W25Q128_EraseFlash.
+ *  The hook may suspend the erase, read outside [begin, end) and resume.
+ */
+typedef void (*W25qEraseHook_t)(uint32_t begin, uint32_t end);
+
+/** Check done by W25Q128_WriteFlash after programming */
+typedef enum
+{
+    W25Q_VERIFY_READBACK,   /* Read back and compare */
+    W25Q_VERIFY_CRC,        /* Read back and compare a hardware CRC, no copy of the data */
+    W25Q_VERIFY_STATUS,     /* Driver status only, content is verified later per slot */
+} W25qVerifyPolicy_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+/* Slot data crosses the bus once. The update server verifies the slot content
+   against the firmware signature before it accepts an install command. */
+#ifndef W25Q_VERIFY_POLICY
+#define W25Q_VERIFY_POLICY W25Q_VERIFY_STATUS
+#endif
+
 /*----------------------------------------------------------------------------*/
 /* PUBLIC FUNCTION DECLARATIONS                                               */
 /*----------------------------------------------------------------------------*/
@@ -55,6 +85,78 @@ extern "C" {
  */
 extern w25qxx_handle_t* W25Q128_Init(SPI_HandleTypeDef* hspi, GPIO_TypeDef* csPort, uint16_t csPin);
 
+/** Erase a range, usable as MemoryConfig_t Eraser. Aligned 64 KB and 32 KB
+ *  blocks with several dirty sectors are erased with one block erase and
+ *  sectors that are already blank are skipped. A range erased here is known
+ *  blank until the next page program, so erasing it again costs nothing.
+ * 
+ * @param address 4 KB aligned start address
+ * @param size Multiple of 4 KB
+ * 
+ * @return true if the whole range is erased
+ */
+extern bool W25Q128_EraseFlash(uint32_t address, size_t size);
+
+/** Program a range, usable as MemoryConfig_t Writer. The range must be
+ *  erased. Each page is written with one page program, then the range is
+ *  checked according to the verify policy.
+ * 
+ * @param address Start address
+ * @param data Data to write
+ * @param size Data size
+ * 
+ * @return true if written and verified
+ */
+extern bool W25Q128_WriteFlash(uint32_t address, const uint8_t* data, size_t size);
+
+/** Select the check done by W25Q128_WriteFlash. W25Q_VERIFY_STATUS is only
+ *  safe for data that is verified before use, like fragment slots.
+ * 
+ * @param policy Verify policy, W25Q_VERIFY_POLICY by default
+ */
+extern void W25Q128_SetVerifyPolicy(W25qVerifyPolicy_t policy);
+
+/** Set the hook called during erases
+ * 
+ * @param hook Hook or NULL
+ */
+extern void W25Q128_SetEraseHook(W25qEraseHook_t hook);
+
+/** Suspend an ongoing erase or program (0x75). Does nothing if the chip
+ *  completed the operation already.
+ * 
+ * @return true if the chip accepts reads
+ */
+extern bool W25Q128_Suspend(void);
+
+/** Resume a suspended erase or program (0x7A)
+ * 
+ * @return true on success
+ */
+extern bool W25Q128_Resume(void);
+
+/** Read with the fast read command without going through the driver. Usable
+ *  from the erase hook while suspended.
+ * 
+ * @param address Start address
+ * @param data Output buffer
+ * @param size Bytes to read
+ * 
+ * @return true on success
+ */
+extern bool W25Q128_Read(uint32_t address, uint8_t* data, size_t size);
+
+/** Poll the status register until the chip is not busy. The calling task
+ *  yields between polls instead of sleeping a tick, which suits a page
+ *  program but not an erase. Call only after the scheduler has started.
+ *  The busy polls of the driver during a page program end up here.
+ * 
+ * @param timeoutMs Maximum wait
+ * 
+ * @return true if the chip is ready, false on timeout or SPI error
+ */
+extern bool W25Q128_WaitReady(uint32_t timeoutMs);
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
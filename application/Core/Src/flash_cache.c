@@ -0,0 +1,184 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * flash_cache.c
+ *
+ * @brief Page granular LRU read cache for the W25Q128. Misses read the whole
+ *        page with the fast read command, which is also allowed while an
+ *        erase is suspended.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "flash_cache.h"
+#include "w25qxx_init.h"
+
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t address;   /* Page aligned */
+    uint32_t lastUse;
+    bool valid;
+    uint8_t data[256];
+} CachePage_t;
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define PAGE_SIZE       (256U)
+
+/* Reads of this size or larger go directly to the flash */
+#define BYPASS_SIZE     (2U * PAGE_SIZE)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+#if FLASH_CACHE_PAGES > 0
+static CachePage_t f_pages[FLASH_CACHE_PAGES];
+static uint32_t f_useCounter = 0U;
+#endif
+
+static FlashCacheStats_t f_stats;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+#if FLASH_CACHE_PAGES > 0
+/** Get the cached page, reading it into the least recently used entry on a
+ *  miss.
+ * 
+ * @return Page or NULL if the read failed
+ */
+static CachePage_t* GetPage(uint32_t pageAddress)
+{
+    CachePage_t* victim = &f_pages[0];
+
+    for (size_t i = 0U; i < FLASH_CACHE_PAGES; i++)
+    {
+        CachePage_t* page = &f_pages[i];
+
+        if (page->valid && (page->address == pageAddress))
+        {
+            page->lastUse = ++f_useCounter;
+            f_stats.hits++;
+            return page;
+        }
+
+        if (!page->valid)
+        {
+            victim = page;
+        }
+        else if (victim->valid && (page->lastUse < victim->lastUse))
+        {
+            victim = page;
+        }
+    }
+
+    victim->valid = false;
+
+    if (!W25Q128_Read(pageAddress, victim->data, PAGE_SIZE))
+    {
+        return NULL;
+    }
+
+    victim->address = pageAddress;
+    victim->lastUse = ++f_useCounter;
+    victim->valid = true;
+    f_stats.misses++;
+    return victim;
+}
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+bool FLASH_CACHE_Read(uint32_t address, uint8_t* data, size_t size)
+{
+#if FLASH_CACHE_PAGES > 0
+    if (size < BYPASS_SIZE)
+    {
+        size_t offset = 0U;
+
+        while (offset < size)
+        {
+            const uint32_t addr = address + offset;
+            const uint32_t inPage = addr % PAGE_SIZE;
+            const size_t len = ((size - offset) < (PAGE_SIZE - inPage)) ? (size - offset) : (PAGE_SIZE - inPage);
+            const CachePage_t* page = GetPage(addr - inPage);
+
+            if (page == NULL)
+            {
+                return false;
+            }
+
+            memcpy(&data[offset], &page->data[inPage], len);
+            offset += len;
+        }
+
+        return true;
+    }
+#endif
+
+    f_stats.bypassed++;
+    return W25Q128_Read(address, data, size);
+}
+
+void FLASH_CACHE_Invalidate(uint32_t address, size_t size)
+{
+#if FLASH_CACHE_PAGES > 0
+    for (size_t i = 0U; i < FLASH_CACHE_PAGES; i++)
+    {
+        CachePage_t* page = &f_pages[i];
+
+        if (page->valid &&
+            (page->address < (address + size)) &&
+            ((page->address + PAGE_SIZE) > address))
+        {
+            page->valid = false;
+            f_stats.invalidated++;
+        }
+    }
+#else
+    (void)address;
+    (void)size;
+#endif
+}
+
+FlashCacheStats_t FLASH_CACHE_GetStats(void)
+{
+    return f_stats;
+}
+
+/* EoF flash_cache.c */
@@ -0,0 +1,368 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * flash_scheduler.c
+ *
+ * @brief W25Q128 I/O scheduler task. Callers block on a semaphore of their
+ *        request while the task serves the queues in class order. Between
+ *        the busy polls of an erase, queued critical reads outside the erased
+ *        block are served with the erase suspended.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "flash_scheduler.h"
+#include "flash_cache.h"
+#include "w25qxx_init.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "w25qxx/flash_interface.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef enum
+{
+    FLASH_OP_READ,
+    FLASH_OP_WRITE,
+    FLASH_OP_WRITE_VERIFY,
+    FLASH_OP_ERASE,
+} FlashOp_t;
+
+typedef struct
+{
+    FlashOp_t op;
+    FlashClass_t cls;
+    uint32_t address;
+    uint8_t* data;
+    const uint8_t* src;
+    size_t size;
+    TickType_t queuedAt;
+    bool result;
+    SemaphoreHandle_t done;
+} FlashRequest_t;
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define QUEUE_LENGTH            (8U)
+#define TASK_STACK_WORDS        (384U)
+
+/* Above commTask, so queued work starts as soon as it is submitted */
+#define TASK_PRIORITY           (tskIDLE_PRIORITY + 25U)
+
+/* Reads served per suspend, bounds the delay added to the erase */
+#define MAX_READS_PER_SUSPEND   (4U)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static TaskHandle_t f_task = NULL;
+static StaticTask_t f_taskTcb;
+static StackType_t f_taskStack[TASK_STACK_WORDS];
+
+static QueueHandle_t f_queue[FLASH_CLASS_COUNT];
+static StaticQueue_t f_queueCtrl[FLASH_CLASS_COUNT];
+static uint8_t f_queueStorage[FLASH_CLASS_COUNT][QUEUE_LENGTH * sizeof(FlashRequest_t*)];
+
+/* Counts queued requests over all classes */
+static SemaphoreHandle_t f_pending = NULL;
+static StaticSemaphore_t f_pendingCtrl;
+
+static FlashClassStats_t f_stats[FLASH_CLASS_COUNT];
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static bool Execute(const FlashRequest_t* req)
+{
+    if (req->op != FLASH_OP_READ)
+    {
+        FLASH_CACHE_Invalidate(req->address, req->size);
+    }
+
+    switch (req->op)
+    {
+    case FLASH_OP_READ:
+        return FLASH_CACHE_Read(req->address, req->data, req->size);
+    case FLASH_OP_WRITE:
+        return W25Q128_WriteFlash(req->address, req->src, req->size);
+    case FLASH_OP_WRITE_VERIFY:
+        return W25Qxx_INTERFACE_WriteAndVerifyFlash(req->address, req->src, req->size);
+    case FLASH_OP_ERASE:
+        return W25Q128_EraseFlash(req->address, req->size);
+    default:
+        return false;
+    }
+}
+
+static void RecordWait(const FlashRequest_t* req, bool inSuspend)
+{
+    FlashClassStats_t* stats = &f_stats[req->cls];
+    const uint32_t waitMs = (uint32_t)((xTaskGetTickCount() - req->queuedAt) * portTICK_PERIOD_MS);
+
+    stats->requests++;
+    stats->totalWaitMs += waitMs;
+    stats->maxWaitMs = (waitMs > stats->maxWaitMs) ? waitMs : stats->maxWaitMs;
+
+    if (inSuspend)
+    {
+        stats->servedInSuspend++;
+    }
+}
+
+static bool Overlaps(const FlashRequest_t* req, uint32_t begin, uint32_t end)
+{
+    return (req->address < end) && ((req->address + req->size) > begin);
+}
+
+/** Erase hook. Runs in the scheduler task inside the erase busy loop. */
+static void ServeDuringErase(uint32_t begin, uint32_t end)
+{
+    FlashRequest_t* req = NULL;
+    bool suspended = false;
+
+    for (uint32_t served = 0U; served < MAX_READS_PER_SUSPEND; served++)
+    {
+        if ((xQueuePeek(f_queue[FLASH_CLASS_CRITICAL], &req, 0) != pdTRUE) ||
+            (req->op != FLASH_OP_READ) ||
+            Overlaps(req, begin, end))
+        {
+            break;
+        }
+
+        if (!suspended)
+        {
+            if (!W25Q128_Suspend())
+            {
+                break;
+            }
+            suspended = true;
+        }
+
+        (void)xQueueReceive(f_queue[FLASH_CLASS_CRITICAL], &req, 0);
+        (void)xSemaphoreTake(f_pending, 0);
+
+        RecordWait(req, true);
+        req->result = FLASH_CACHE_Read(req->address, req->data, req->size);
+        (void)xSemaphoreGive(req->done);
+    }
+
+    if (suspended && !W25Q128_Resume())
+    {
+        printf("Flash erase resume failed\r\n");
+    }
+}
+
+static bool NextRequest(FlashRequest_t** req)
+{
+    for (size_t cls = 0U; cls < FLASH_CLASS_COUNT; cls++)
+    {
+        if (xQueueReceive(f_queue[cls], req, 0) == pdTRUE)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void SchedulerTask(void* argument)
+{
+    (void)argument;
+
+    for (;;)
+    {
+        FlashRequest_t* req = NULL;
+
+        (void)xSemaphoreTake(f_pending, portMAX_DELAY);
+
+        /* A request may have been served by the erase hook already */
+        if (!NextRequest(&req))
+        {
+            continue;
+        }
+
+        RecordWait(req, false);
+        req->result = Execute(req);
+        (void)xSemaphoreGive(req->done);
+    }
+}
+
+static bool Submit(FlashRequest_t* req)
+{
+    /* Before start-up and from the scheduler itself the request runs directly */
+    if ((f_task == NULL) ||
+        (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) ||
+        (xTaskGetCurrentTaskHandle() == f_task))
+    {
+        return Execute(req);
+    }
+
+    StaticSemaphore_t doneCtrl;
+    req->done = xSemaphoreCreateBinaryStatic(&doneCtrl);
+    req->queuedAt = xTaskGetTickCount();
+    req->result = false;
+
+    if (xQueueSend(f_queue[req->cls], &req, portMAX_DELAY) != pdTRUE)
+    {
+        vSemaphoreDelete(req->done);
+        return false;
+    }
+
+    (void)xSemaphoreGive(f_pending);
+    (void)xSemaphoreTake(req->done, portMAX_DELAY);
+    vSemaphoreDelete(req->done);
+
+    return req->result;
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+bool FLASH_SCHED_Init(void)
+{
+    if (f_task != NULL)
+    {
+        return true;
+    }
+
+    memset(f_stats, 0, sizeof(f_stats));
+
+    for (size_t cls = 0U; cls < FLASH_CLASS_COUNT; cls++)
+    {
+        f_queue[cls] = xQueueCreateStatic(QUEUE_LENGTH, sizeof(FlashRequest_t*), f_queueStorage[cls], &f_queueCtrl[cls]);
+    }
+
+    f_pending = xSemaphoreCreateCountingStatic(FLASH_CLASS_COUNT * QUEUE_LENGTH, 0U, &f_pendingCtrl);
+
+    W25Q128_SetEraseHook(ServeDuringErase);
+
+    f_task = xTaskCreateStatic(SchedulerTask, "flashSched", TASK_STACK_WORDS, NULL, TASK_PRIORITY, f_taskStack, &f_taskTcb);
+    return f_task != NULL;
+}
+
+bool FLASH_SCHED_Read(uint32_t address, uint8_t* data, size_t size)
+{
+    FlashRequest_t req = {
+        .op = FLASH_OP_READ,
+        .cls = FLASH_CLASS_CRITICAL,
+        .address = address,
+        .data = data,
+        .size = size,
+    };
+
+    return Submit(&req);
+}
+
+bool FLASH_SCHED_Write(uint32_t address, const uint8_t* data, size_t size)
+{
+    FlashRequest_t req = {
+        .op = FLASH_OP_WRITE,
+        .cls = FLASH_CLASS_NORMAL,
+        .address = address,
+        .src = data,
+        .size = size,
+    };
+
+    return Submit(&req);
+}
+
+bool FLASH_SCHED_WriteAndVerify(uint32_t address, const uint8_t* data, size_t size)
+{
+    FlashRequest_t req = {
+        .op = FLASH_OP_WRITE_VERIFY,
+        .cls = FLASH_CLASS_NORMAL,
+        .address = address,
+        .src = data,
+        .size = size,
+    };
+
+    return Submit(&req);
+}
+
+bool FLASH_SCHED_Erase(uint32_t address, size_t size)
+{
+    FlashRequest_t req = {
+        .op = FLASH_OP_ERASE,
+        .cls = FLASH_CLASS_BACKGROUND,
+        .address = address,
+        .size = size,
+    };
+
+    return Submit(&req);
+}
+
+bool FLASH_SCHED_GetStats(FlashClass_t cls, FlashClassStats_t* out)
+{
+    if ((cls >= FLASH_CLASS_COUNT) || (out == NULL))
+    {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    *out = f_stats[cls];
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+void FLASH_SCHED_PrintStats(void)
+{
+    static const char* const names[FLASH_CLASS_COUNT] = {
+        "critical", "normal", "background"
+    };
+
+    for (size_t cls = 0U; cls < FLASH_CLASS_COUNT; cls++)
+    {
+        FlashClassStats_t stats;
+        (void)FLASH_SCHED_GetStats((FlashClass_t)cls, &stats);
+
+        printf("Flash %-10s %lu requests, avg wait %lu ms, max %lu ms, %lu during erase\r\n",
+            names[cls],
+            stats.requests,
+            (stats.requests > 0U) ? (stats.totalWaitMs / stats.requests) : 0U,
+            stats.maxWaitMs,
+            stats.servedInSuspend);
+    }
+
+    const FlashCacheStats_t cache = FLASH_CACHE_GetStats();
+    printf("Flash cache %lu hits, %lu misses, %lu bypassed, %lu invalidated\r\n",
+        cache.hits, cache.misses, cache.bypassed, cache.invalidated);
+}
+
+/* EoF flash_scheduler.c */
@@ -0,0 +1,360 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * fw_backup.c
+ *
+ * @brief Background copy of the running firmware into a fragment slot. The
+ *        image is cut from the end of FIRMWARE_METADATA to the end of the
+ *        firmware, like the fragments the bootloader installs. The device has
+ *        no fragment signing key, so the fragments use verifyMethod 1, the
+ *        hash chain described at ValidateFragment of updateserver.c. The
+ *        chain value goes into signature and the content digest into sha512.
+ *        The installer checks the whole content against the firmware
+ *        signature of the metadata.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "fw_backup.h"
+#include "flash_scheduler.h"
+#include "fragment_index.h"
+#include "keystore.h"
+#include "metadata.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sha512.h"
+#include "fragmentstore/fragmentstore.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define TASK_STACK_WORDS        (512U)
+
+/* Below every other task, the copy only uses idle time */
+#define TASK_PRIORITY           (tskIDLE_PRIORITY + 1U)
+
+#define W25Qxx_SECTOR_SIZE      (4096U)
+#define CONTENT_SIZE            (sizeof(((Fragment_t*)0)->content))
+#define CHAINED_MSG_SIZE        (sizeof(Fragment_t) - sizeof(((Fragment_t*)0)->signature))
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static TaskHandle_t f_task = NULL;
+static StaticTask_t f_taskTcb;
+static StackType_t f_taskStack[TASK_STACK_WORDS];
+
+static volatile int f_activeSlot = -1;
+static bool f_prepare;
+static MemoryConfig_t f_conf;
+static FragmentArea_t f_fa;
+static Fragment_t f_frag;
+static uint8_t f_chain[64];
+
+/* Image range of the fragments */
+static uint32_t f_dataStart;
+static uint32_t f_dataEnd;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Fragments of the backup only need to lie within the image, the content
+ *  is verified when the chain is followed
+ */
+static bool BackupFragmentInImage(const Fragment_t* frag)
+{
+    return (frag->size <= sizeof(frag->content)) &&
+           (frag->startAddress >= f_dataStart) &&
+           ((frag->startAddress + frag->size) <= f_dataEnd);
+}
+
+/** Advance the hash chain over a fragment
+ * 
+ * @param frag Fragment
+ * @param out Chain value of the fragment
+ */
+static void ChainFragment(const Fragment_t* frag, uint8_t* out)
+{
+    sha512_context ctx;
+    sha512_init(&ctx);
+    sha512_update(&ctx, f_chain, sizeof(f_chain));
+    sha512_update(&ctx, (const uint8_t*)frag, CHAINED_MSG_SIZE);
+    sha512_final(&ctx, out);
+}
+
+/** Check a fragment left by an earlier backup against the running image
+ * 
+ * @param number Fragment number
+ * @param address Image address of the fragment
+ * @param size Content size
+ * 
+ * @return fragment matches and continues the chain
+ */
+static bool CheckStored(uint32_t number, uint32_t address, uint32_t size)
+{
+    uint8_t chain[64];
+
+    if ((f_frag.firmwareId != FIRMWARE_METADATA.firmwareId) ||
+        (f_frag.number != number) ||
+        (f_frag.startAddress != address) ||
+        (f_frag.size != size) ||
+        (0 != memcmp(f_frag.content, (const uint8_t*)address, size)))
+    {
+        return false;
+    }
+
+    if (f_frag.verifyMethod == 1U)
+    {
+        ChainFragment(&f_frag, chain);
+        if (0 != memcmp(chain, f_frag.signature, sizeof(chain)))
+        {
+            return false;
+        }
+        memcpy(f_chain, f_frag.signature, sizeof(f_chain));
+    }
+    else
+    {
+        /* Uploaded fragment, the update server continues from its digest */
+        memcpy(f_chain, f_frag.sha512, sizeof(f_chain));
+    }
+
+    return true;
+}
+
+/** Build the next fragment of the chain from internal flash
+ * 
+ * @param number Fragment number
+ * @param address Image address of the fragment
+ * @param size Content size
+ */
+static void MakeFragment(uint32_t number, uint32_t address, uint32_t size)
+{
+    memset(&f_frag, 0xFF, sizeof(f_frag));
+
+    f_frag.firmwareId = FIRMWARE_METADATA.firmwareId;
+    f_frag.number = number;
+    f_frag.startAddress = address;
+    f_frag.size = size;
+    f_frag.verifyMethod = 1U;
+    memcpy(f_frag.content, (const uint8_t*)address, size);
+
+    /* Content digest, so the fragment index can serve fragment references */
+    (void)sha512(f_frag.content, size, f_frag.sha512);
+
+    ChainFragment(&f_frag, f_chain);
+    memcpy(f_frag.signature, f_chain, sizeof(f_chain));
+}
+
+static void IndexFragment(uint32_t slot)
+{
+    FragmentIndexEntry_t entry;
+
+    if ((f_frag.number >= FRAGMENT_INDEX_MAX_ENTRIES) ||
+        FRAGMENT_INDEX_Lookup(FLASH_SCHED_Read, slot, f_frag.firmwareId, f_frag.number, &entry))
+    {
+        return;
+    }
+
+    FRAGMENT_INDEX_MakeEntry(
+        &entry,
+        f_frag.firmwareId,
+        f_frag.number,
+        f_frag.startAddress,
+        f_frag.size,
+        f_frag.sha512
+    );
+
+    if (!FLASH_SCHED_Write(
+            FRAGMENT_INDEX_EntryAddress(slot, f_frag.number), (const uint8_t*)&entry, sizeof(entry)))
+    {
+        printf("Backup indexing of fragment %lu failed\r\n", f_frag.number);
+    }
+}
+
+/** Erase the slot and its fragment index and write the metadata of the
+ *  running firmware
+ * 
+ * @param slot Slot number
+ * @return slot is ready for fragments
+ */
+static bool PrepareSlot(uint32_t slot)
+{
+    /* Block erases first, FA_EraseArea then finds the sectors blank */
+    if (!FLASH_SCHED_Erase(f_conf.baseAddress, f_conf.memorySize))
+    {
+        printf("Block erase of backup slot %lu failed\r\n", slot);
+    }
+
+    return FLASH_SCHED_Erase(FRAGMENT_INDEX_AreaAddress(slot), FRAGMENT_INDEX_SLOT_SIZE) &&
+           (FA_ERR_OK == FA_EraseArea(&f_fa)) &&
+           (FA_ERR_OK == FA_WriteMetadata(&f_fa, &FIRMWARE_METADATA));
+}
+
+static void BackupTask(void* arg)
+{
+    const uint32_t slot = (uint32_t)f_activeSlot;
+    const uint32_t count = (f_dataEnd - f_dataStart + CONTENT_SIZE - 1U) / CONTENT_SIZE;
+    const TickType_t startTick = xTaskGetTickCount();
+    uint32_t written = 0U;
+    uint32_t number = 0U;
+
+    (void)arg;
+
+    if (f_prepare && !PrepareSlot(slot))
+    {
+        printf("Preparing backup slot %lu failed\r\n", slot);
+        f_activeSlot = -1;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    memcpy(f_chain, FIRMWARE_METADATA.metadataSignature, sizeof(f_chain));
+    printf("Backing up firmware %lX into slot %lu, %lu fragments\r\n",
+        FIRMWARE_METADATA.firmwareId, slot, count);
+
+    for (; number < count; number++)
+    {
+        const uint32_t address = f_dataStart + (number * CONTENT_SIZE);
+        const uint32_t remaining = f_dataEnd - address;
+        const uint32_t size = (remaining < CONTENT_SIZE) ? remaining : CONTENT_SIZE;
+
+        const FA_ReturnCode_t stored = FA_ReadFragment(&f_fa, number, &f_frag);
+        FragmentIndexEntry_t entry;
+
+        if (stored == FA_ERR_OK)
+        {
+            if (!CheckStored(number, address, size))
+            {
+                printf("Stored fragment %lu differs from the backup, backup stopped\r\n", number);
+                break;
+            }
+            continue;
+        }
+
+        if (FRAGMENT_INDEX_Lookup(FLASH_SCHED_Read, slot, FIRMWARE_METADATA.firmwareId, number, &entry) &&
+            FRAGMENT_INDEX_IsReference(&entry))
+        {
+            /* Uploaded as a reference, the content is in another slot and
+               the chain continues from the digest like after any uploaded
+               fragment. The installer checks the content. */
+            if ((entry.startAddress != address) || (entry.size != size))
+            {
+                printf("Referenced fragment %lu differs from the backup, backup stopped\r\n", number);
+                break;
+            }
+            memcpy(f_chain, entry.sha512, sizeof(f_chain));
+            continue;
+        }
+
+        MakeFragment(number, address, size);
+
+        const FA_ReturnCode_t code = FA_WriteFragment(&f_fa, number, &f_frag);
+        if (code != FA_ERR_OK)
+        {
+            printf("Backup write of fragment %lu failed: %i\r\n", number, code);
+            break;
+        }
+
+        IndexFragment(slot);
+        written++;
+    }
+
+    if (number == count)
+    {
+        printf("Backup of firmware %lX complete, wrote %lu fragments in %lu ms\r\n",
+            FIRMWARE_METADATA.firmwareId,
+            written,
+            (uint32_t)((xTaskGetTickCount() - startTick) * portTICK_PERIOD_MS));
+    }
+
+    f_activeSlot = -1;
+    vTaskDelete(NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+bool BACKUP_Start(uint32_t slot, uint32_t address, uint32_t size, bool prepare)
+{
+    /* Once per boot, the task memory is static */
+    if (f_task != NULL)
+    {
+        return false;
+    }
+
+    f_dataStart = (uint32_t)&FIRMWARE_METADATA + sizeof(Metadata_t);
+    f_dataEnd = FIRMWARE_METADATA.startAddress + FIRMWARE_METADATA.firmwareSize;
+
+    if (f_dataEnd <= f_dataStart)
+    {
+        return false;
+    }
+
+    /* Own accessors, the session log of the server is not shared */
+    f_conf = (MemoryConfig_t) {
+        .baseAddress = address,
+        .sectorSize = W25Qxx_SECTOR_SIZE,
+        .memorySize = size,
+        .eraseValue = 0xFF,
+
+        .Reader = FLASH_SCHED_Read,
+        .Writer = FLASH_SCHED_Write,
+        .Eraser = FLASH_SCHED_Erase,
+    };
+
+    if (FA_ERR_OK != FA_InitStruct(&f_fa, &f_conf, BackupFragmentInImage, KEYSTORE_VerifyMetadata))
+    {
+        return false;
+    }
+
+    f_prepare = prepare;
+    f_activeSlot = (int)slot;
+    f_task = xTaskCreateStatic(BackupTask, "fwBackup", TASK_STACK_WORDS, NULL, TASK_PRIORITY, f_taskStack, &f_taskTcb);
+
+    if (f_task == NULL)
+    {
+        f_activeSlot = -1;
+        return false;
+    }
+
+    return true;
+}
+
+int BACKUP_ActiveSlot(void)
+{
+    return f_activeSlot;
+}
+
+/* EoF fw_backup.c */
@@ -35,6 +35,8 @@
 #include "keystore.h"
 #include "generated_public_key.h"
 
+#include "ed25519.h"
+
 static_assert(sizeof(generated_public_key) == 32U, "Generated public key must be 32 bytes!");
 
 /*----------------------------------------------------------------------------*/
@@ -51,4 +53,22 @@ const uint8_t* KEYSTORE_GetFragmentPublicKey(void)
     return generated_public_key;
 }
 
+const uint8_t* KEYSTORE_GetFirmwarePublicKey(void)
+{
+    return generated_public_key;
+}
+
+bool KEYSTORE_VerifyMetadata(const Metadata_t* metadata)
+{
+    const uint8_t* msg = (const uint8_t*)metadata;
+    const size_t msgLen = sizeof(Metadata_t) - sizeof(metadata->metadataSignature);
+
+    return 1 == ed25519_verify(
+        metadata->metadataSignature,
+        msg,
+        msgLen,
+        KEYSTORE_GetMetadataPublicKey()
+    );
+}
+
 /* EoF keystore.c */
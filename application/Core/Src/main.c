@@ -27,6 +27,7 @@
 #include "niram/no_init_ram.h"
 #include "driver_w25qxx.h"
 #include "w25qxx_init.h"
+#include "flash_scheduler.h"
 #include "w25qxx/flash_interface.h"
 /* USER CODE END Includes */
 
@@ -71,6 +72,9 @@ const osThreadAttr_t blueLedTask_attributes = {
 };
 /* USER CODE BEGIN PV */
 
+DMA_HandleTypeDef hdma_spi3_rx;
+DMA_HandleTypeDef hdma_spi3_tx;
+
 static uint8_t f_w25q_verify_mem[512];
 
 /* USER CODE END PV */
@@ -412,6 +416,11 @@ void startCommTask(void *argument)
     if (W25Qxx_INTERFACE_Init(hnd, f_w25q_verify_mem, sizeof(f_w25q_verify_mem)))
     {
       printf("W25Q128_Init OK!\r\n");
+
+      if (!FLASH_SCHED_Init())
+      {
+        printf("FLASH_SCHED_Init failed\r\n");
+      }
     }
     else
     {
@@ -72,4 +72,14 @@ const Metadata_t FIRMWARE_METADATA __attribute__((section (".metadata"))) =
 
 _Static_assert(sizeof(FIRMWARE_METADATA) <= 0x200U, "Metadata too large");
 
+/* Linked last in flash. Digests are generated after build */
+const DigestTable_t FIRMWARE_DIGESTS __attribute__((section (".digests"))) =
+{
+    .magic = DIGEST_TABLE_MAGIC,
+    .baseAddress = (uint32_t)&FIRMWARE_METADATA,
+    .imageStart = (uint32_t)ISR_VECTOR_START,
+    .segmentSize = DIGEST_SEGMENT_SIZE,
+    .segmentCount = 0U,
+};
+
 /* EoF metadata.c */
@@ -0,0 +1,175 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * session_log.c
+ *
+ * @brief Capture of an update session. Records are only accessed from the
+ *        server task, so no locking is needed.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "session_log.h"
+#include "stm32f4xx_it.h"
+
+#include "crc/crc32.h"
+
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static SessionLogWriter_t f_writer = NULL;
+static uint32_t f_lastUs = 0U;
+static uint8_t f_buffer[SESSION_LOG_BUFFER_SIZE];
+static size_t f_used = 0U;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static void Append(SessionRecordType_t type, uint8_t arg, const void* data, size_t size)
+{
+    if (f_writer == NULL)
+    {
+        return;
+    }
+
+    const uint32_t now = SESSION_LOG_Now();
+    const SessionRecord_t rec = {
+        .type = (uint8_t)type,
+        .arg = arg,
+        .size = (uint16_t)size,
+        .deltaUs = now - f_lastUs,
+    };
+    f_lastUs = now;
+
+    if ((f_used + sizeof(rec) + size) > sizeof(f_buffer))
+    {
+        SESSION_LOG_Flush();
+    }
+
+    /* Only a full size PDU does not fit an empty buffer */
+    if ((sizeof(rec) + size) > sizeof(f_buffer))
+    {
+        f_writer((const uint8_t*)&rec, sizeof(rec));
+        f_writer((const uint8_t*)data, size);
+        return;
+    }
+
+    memcpy(&f_buffer[f_used], &rec, sizeof(rec));
+    memcpy(&f_buffer[f_used + sizeof(rec)], data, size);
+    f_used += sizeof(rec) + size;
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+void SESSION_LOG_Start(SessionLogWriter_t writer)
+{
+    const SessionStart_t start = {
+        .magic = SESSION_LOG_MAGIC,
+        .version = SESSION_LOG_VERSION,
+    };
+
+    f_writer = writer;
+    f_used = 0U;
+    f_lastUs = SESSION_LOG_Now();
+
+    Append(SESSION_REC_START, 0U, &start, sizeof(start));
+}
+
+void SESSION_LOG_Stop(void)
+{
+    SESSION_LOG_Flush();
+    f_writer = NULL;
+}
+
+bool SESSION_LOG_Active(void)
+{
+    return f_writer != NULL;
+}
+
+uint32_t SESSION_LOG_Now(void)
+{
+    return TIM6_GetTime_us();
+}
+
+void SESSION_LOG_Pdu(const uint8_t* pdu, size_t size)
+{
+    Append(SESSION_REC_PDU, 0U, pdu, size);
+}
+
+void SESSION_LOG_Response(const uint8_t* response, size_t size)
+{
+    if (f_writer == NULL)
+    {
+        return;
+    }
+
+    const SessionResponse_t res = {
+        .crc = CRC32_Calculate(response, size),
+        .size = (uint16_t)size,
+    };
+
+    Append(SESSION_REC_RESPONSE, 0U, &res, sizeof(res));
+}
+
+void SESSION_LOG_Callback(SessionCallbackId_t id, uint8_t result, uint32_t startUs)
+{
+    const SessionCallback_t cb = {
+        .result = result,
+        .durationUs = SESSION_LOG_Now() - startUs,
+    };
+
+    Append(SESSION_REC_CALLBACK, (uint8_t)id, &cb, sizeof(cb));
+}
+
+void SESSION_LOG_Flash(SessionFlashOp_t op, uint32_t address, size_t size, bool ok, uint32_t startUs)
+{
+    const SessionFlash_t flash = {
+        .address = address,
+        .size = (uint32_t)size,
+        .durationUs = SESSION_LOG_Now() - startUs,
+        .ok = ok ? 1U : 0U,
+    };
+
+    Append(SESSION_REC_FLASH, (uint8_t)op, &flash, sizeof(flash));
+}
+
+void SESSION_LOG_Flush(void)
+{
+    if ((f_writer != NULL) && (f_used > 0U))
+    {
+        f_writer(f_buffer, f_used);
+    }
+
+    f_used = 0U;
+}
+
+/* EoF session_log.c */
@@ -0,0 +1,227 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * slot_alloc.c
+ *
+ * @brief Allocation of firmware slots in the external flash partition table.
+ *        Extents are placed first fit, starting from the lowest free address.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "slot_alloc.h"
+#include "flash_scheduler.h"
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t begin;
+    uint32_t end;
+} SlotSpace_t;
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static const SlotSpace_t f_spaces[] = {
+    { 0U, PARTITION_RESERVED_BEGIN },
+    { PARTITION_RESERVED_END, PARTITION_FLASH_SIZE },
+};
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static bool Overlaps(const PartitionTable_t* table, uint32_t address, uint32_t size)
+{
+    for (uint32_t i = 0U; i < PARTITION_MAX_SLOTS; i++)
+    {
+        const PartitionSlot_t* s = &table->slots[i];
+
+        if ((s->size != PARTITION_UNUSED) &&
+            (address < (s->address + s->size)) &&
+            (s->address < (address + size)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** Find a free extent. Candidates are the start of each slot space and the
+ *  end of each used slot, so the lowest fitting gap is found.
+ * 
+ * @param table Partition table
+ * @param size Extent size
+ * @param address Output extent address
+ * 
+ * @return Free extent found
+ */
+static bool FindFreeExtent(const PartitionTable_t* table, uint32_t size, uint32_t* address)
+{
+    bool found = false;
+
+    for (uint32_t c = 0U; c <= PARTITION_MAX_SLOTS; c++)
+    {
+        for (uint32_t sp = 0U; sp < (sizeof(f_spaces) / sizeof(f_spaces[0])); sp++)
+        {
+            uint32_t candidate;
+
+            if (c == PARTITION_MAX_SLOTS)
+            {
+                candidate = f_spaces[sp].begin;
+            }
+            else if (table->slots[c].size != PARTITION_UNUSED)
+            {
+                candidate = table->slots[c].address + table->slots[c].size;
+            }
+            else
+            {
+                continue;
+            }
+
+            if ((candidate < f_spaces[sp].begin) ||
+                (candidate >= f_spaces[sp].end) ||
+                (size > (f_spaces[sp].end - candidate)) ||
+                Overlaps(table, candidate, size))
+            {
+                continue;
+            }
+
+            if (!found || (candidate < *address))
+            {
+                *address = candidate;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+static bool FindUnusedEntry(const PartitionTable_t* table, uint32_t* slot)
+{
+    for (uint32_t i = 0U; i < PARTITION_MAX_SLOTS; i++)
+    {
+        if (table->slots[i].size == PARTITION_UNUSED)
+        {
+            *slot = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool EvictLeastRecent(PartitionTable_t* table, uint32_t protectMask, uint32_t* evictedMask)
+{
+    uint32_t victim = PARTITION_MAX_SLOTS;
+
+    /* Evicting a slot would break the references to its fragments */
+    protectMask |= PARTITION_ReferencedSlots(table);
+
+    for (uint32_t i = 0U; i < PARTITION_MAX_SLOTS; i++)
+    {
+        const PartitionSlot_t* s = &table->slots[i];
+
+        if ((s->size == PARTITION_UNUSED) || ((protectMask & (1UL << i)) != 0U))
+        {
+            continue;
+        }
+
+        if ((victim == PARTITION_MAX_SLOTS) || (s->lastUsed < table->slots[victim].lastUsed))
+        {
+            victim = i;
+        }
+    }
+
+    if (victim == PARTITION_MAX_SLOTS)
+    {
+        return false;
+    }
+
+    table->slots[victim].size = PARTITION_UNUSED;
+    *evictedMask |= (1UL << victim);
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+bool SLOT_ALLOC_Allocate(
+    PartitionTable_t* table,
+    uint32_t size,
+    uint32_t protectMask,
+    uint32_t* slot,
+    uint32_t* evictedMask)
+{
+    *evictedMask = 0U;
+
+    if ((size == 0U) || ((size % PARTITION_ALIGN) != 0U))
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        uint32_t entry = 0U;
+        uint32_t address = 0U;
+
+        if (FindUnusedEntry(table, &entry) && FindFreeExtent(table, size, &address))
+        {
+            table->slots[entry].address = address;
+            table->slots[entry].size = size;
+            table->slots[entry].lastUsed = table->sequence + 1U;
+            table->slots[entry].refMask = 0U;
+            *slot = entry;
+            return true;
+        }
+
+        if (!EvictLeastRecent(table, protectMask, evictedMask))
+        {
+            return false;
+        }
+    }
+}
+
+bool SLOT_ALLOC_Store(PartitionTable_t* table)
+{
+    table->magic = PARTITION_MAGIC;
+    table->sequence++;
+    table->crc = PARTITION_Crc(table);
+
+    const uint32_t address = PARTITION_CopyAddress(table->sequence);
+
+    return FLASH_SCHED_Erase(address, PARTITION_SECTOR_SIZE) &&
+           FLASH_SCHED_WriteAndVerify(address, (const uint8_t*)table, sizeof(*table));
+}
+
+/* EoF slot_alloc.c */
@@ -61,7 +61,9 @@ extern ETH_HandleTypeDef heth;
 extern TIM_HandleTypeDef htim6;
 
 /* USER CODE BEGIN EV */
-
+extern SPI_HandleTypeDef hspi3;
+extern DMA_HandleTypeDef hdma_spi3_rx;
+extern DMA_HandleTypeDef hdma_spi3_tx;
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -213,6 +215,30 @@ void ETH_IRQHandler(void)
 }
 
 /* USER CODE BEGIN 1 */
+/**
+  * @brief This function handles DMA1 stream0 global interrupt.
+  */
+void DMA1_Stream0_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_spi3_rx);
+}
+
+/**
+  * @brief This function handles DMA1 stream5 global interrupt.
+  */
+void DMA1_Stream5_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_spi3_tx);
+}
+
+/**
+  * @brief This function handles SPI3 global interrupt.
+  */
+void SPI3_IRQHandler(void)
+{
+  HAL_SPI_IRQHandler(&hspi3);
+}
+
 void TIM6_Delay_us(uint32_t us)
 {
   uint32_t start = __HAL_TIM_GET_COUNTER(&htim6);
@@ -222,4 +248,19 @@ void TIM6_Delay_us(uint32_t us)
     // Busy wait
   }
 }
+
+/* TIM6 is the HAL time base, counting microseconds of the current tick */
+uint32_t TIM6_GetTime_us(void)
+{
+  uint32_t ms;
+  uint32_t us;
+
+  do
+  {
+    ms = HAL_GetTick();
+    us = __HAL_TIM_GET_COUNTER(&htim6);
+  } while (ms != HAL_GetTick());
+
+  return (ms * 1000U) + us;
+}
 /* USER CODE END 1 */
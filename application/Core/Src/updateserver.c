@@ -52,12 +52,19 @@
 
 #include "crc/crc32.h"
 #include "ed25519.h"
+#include "ed25519_extra.h"
 #include "sha512.h"
 #include "fragmentstore/default_app_types.h"
 #include "fragmentstore/fragmentstore.h"
 #include "fragmentstore/command.h"
 #include "updateserver/transfer.h"
 #include "w25qxx/flash_interface.h"
+#include "flash_scheduler.h"
+#include "fragment_index.h"
+#include "fw_backup.h"
+#include "partition_table.h"
+#include "session_log.h"
+#include "slot_alloc.h"
 
 /*----------------------------------------------------------------------------*/
 /* PRIVATE TYPE DEFINITIONS                                                   */
@@ -67,7 +74,9 @@
 /* MACRO DEFINITIONS                                                          */
 /*----------------------------------------------------------------------------*/
 
+#ifndef UDP_PORT
 #define UDP_PORT 7
+#endif
 
 #define KB (1024U)
 #define MB (1024U * KB)
@@ -94,10 +103,43 @@ server_addr.sin_port = htons(port); \
 server_addr.sin_addr.s_addr = address;
 
 #define W25Qxx_SECTOR_SIZE (4U*KB)
-#define UPDATE_SLOT_SIZE    (2U*MB)
+
+/* Captured sessions are streamed to this port of the client */
+#define SESSION_LOG_PORT (UDP_PORT + 1)
 
 #define MIN(a,b) (((a) < (b)) ? (a) : (b))
 
+#define member_size(type, member) (sizeof( ((type *)0)->member ))
+
+/* A fragment reference is a fragment without its content */
+#define FRAGMENT_TAIL_OFFSET    (offsetof(Fragment_t, content) + member_size(Fragment_t, content))
+#define FRAGMENT_REF_SIZE       (sizeof(Fragment_t) - member_size(Fragment_t, content))
+
+/* Fragments hashed into the slot content check after a fragment write and
+   per repeat of the update command, about 1 ms and 40 ms of work */
+#define CHECK_STEP_WRITE        (2U)
+#define CHECK_STEP_COMMAND      (64U)
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef enum
+{
+    CONTENT_PENDING,
+    CONTENT_VALID,
+    CONTENT_INVALID,
+} ContentState_t;
+
+/* Slot content check in progress, one slot at a time */
+typedef struct
+{
+    int                 slot;       /* -1 if no check is running */
+    size_t              number;     /* Next fragment to hash */
+    uint32_t            nextStart;  /* Address the next fragment starts at */
+    ed25519_multipart_t ctx;
+} ContentCheck_t;
+
 /*----------------------------------------------------------------------------*/
 /* VARIABLE DEFINITIONS                                                       */
 /*----------------------------------------------------------------------------*/
@@ -105,8 +147,10 @@ server_addr.sin_addr.s_addr = address;
 static bool             f_resetRequest;
 static UpdateServer_t   f_us;
 static TransferBuffer_t f_tb;
-static FragmentArea_t   f_fa[3];
-static Metadata_t       f_metadata[3];
+static FragmentArea_t   f_fa[PARTITION_MAX_SLOTS];
+static Metadata_t       f_metadata[PARTITION_MAX_SLOTS];
+static MemoryConfig_t   f_slotConf[PARTITION_MAX_SLOTS];
+static PartitionTable_t f_table;
 static CommandArea_t    f_ca;
 static uint8_t          f_memBlock[5 * 1024];
 static w25qxx_handle_t* f_w25q128 = NULL;
@@ -114,16 +158,66 @@ static uint8_t          f_lastHash[64];
 static size_t           f_lastHashIndex = SIZE_MAX;
 static uint32_t         f_lastHashFwId = 0U;
 static Fragment_t       f_tempFragMem;
+static Fragment_t       f_refFragMem;
+static bool             f_contentVerified[PARTITION_MAX_SLOTS];
+static ContentCheck_t   f_check = { .slot = -1 };
+static uint32_t         f_dedupCount = 0U;
+static uint32_t         f_busyCount = 0U;
+
+#ifdef ENABLE_SESSION_LOG
+static int                f_captureSock = -1;
+static struct sockaddr_in f_captureAddr;
+#endif
 
 /*----------------------------------------------------------------------------*/
 /* PRIVATE FUNCTION DEFINITIONS                                               */
 /*----------------------------------------------------------------------------*/
 
+/** Answer busy and count it, the client repeats the request after a delay */
+static uint8_t BusyRepeat(void)
+{
+    f_busyCount++;
+    return PROTOCOL_NACK_BUSY_REPEAT_REQUEST;
+}
+
 static bool MetadataEqual(const Metadata_t* a, const Metadata_t* b)
 {
     return 0 == memcmp(a, b, sizeof(Metadata_t));
 }
 
+static bool SlotInUse(int slot)
+{
+    return f_table.slots[slot].size != PARTITION_UNUSED;
+}
+
+/** The slot is being written by the firmware backup task */
+static bool SlotBackingUp(int slot)
+{
+#ifdef ENABLE_FIRMWARE_BACKUP
+    return slot == BACKUP_ActiveSlot();
+#else
+    (void)slot;
+    return false;
+#endif
+}
+
+/** Find the slot holding a firmware
+ * 
+ * @param firmwareId Metadata firmwareId
+ * @return slot number, -1 if not found
+ */
+static int FindSlotForFirmware(uint32_t firmwareId)
+{
+    for (int i = 0; i < (int)PARTITION_MAX_SLOTS; i++)
+    {
+        if (SlotInUse(i) && (f_metadata[i].firmwareId == firmwareId))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
 static bool EnsureLastHash(const Fragment_t* next)
 {
     if ((next->number > 0) &&
@@ -135,15 +229,7 @@ static bool EnsureLastHash(const Fragment_t* next)
     }
     else
     {
-        int slot = -1;
-        for (int i = 0; i < 3; i++)
-        {
-            if (f_metadata[i].firmwareId == next->firmwareId)
-            {
-                slot = i;
-                break;
-            }
-        }
+        const int slot = FindSlotForFirmware(next->firmwareId);
 
         if (slot < 0)
         {
@@ -159,10 +245,26 @@ static bool EnsureLastHash(const Fragment_t* next)
         }
         else
         {
+            /* A reference is verifyMethod 0, its chain value is in the index */
+            FragmentIndexEntry_t entry;
+            if (FRAGMENT_INDEX_Lookup(
+                    FLASH_SCHED_Read, (uint32_t)slot, next->firmwareId, next->number - 1U, &entry) &&
+                FRAGMENT_INDEX_IsReference(&entry))
+            {
+                memcpy(f_lastHash, entry.sha512, 64U);
+                f_lastHashIndex = entry.number;
+                f_lastHashFwId = f_metadata[slot].firmwareId;
+                return true;
+            }
+
+            /* Otherwise the index holds only the sha512 field, the chain
+               value of a verifyMethod 1 fragment needs the fragment itself */
             const FA_ReturnCode_t ret = FA_ReadFragmentForce(&f_fa[slot], next->number - 1U, &f_tempFragMem);
             if (ret == FA_ERR_OK)
             {
-                memcpy(f_lastHash, f_tempFragMem.sha512, 64U);
+                memcpy(f_lastHash,
+                    (f_tempFragMem.verifyMethod == 1U) ? f_tempFragMem.signature : f_tempFragMem.sha512,
+                    64U);
                 f_lastHashIndex = f_tempFragMem.number;
                 f_lastHashFwId = f_metadata[slot].firmwareId;
                 return true;
@@ -172,7 +274,14 @@ static bool EnsureLastHash(const Fragment_t* next)
     }
 }
 
-/** Validate one fragment
+/** Validate one fragment. verifyMethod 0 is an ed25519 signature over the
+ *  fragment without its signature. verifyMethod 1 is a hash chain, the
+ *  signature is the SHA-512 of the previous chain value and the fragment
+ *  without its signature. The chain starts from the metadata signature.
+ *  The chain value of a verifyMethod 1 fragment is its signature, of a
+ *  verifyMethod 0 fragment its sha512 field. The sha512 field is never a
+ *  chain value, it is the fragment digest that the fragment index and
+ *  reference lookup rely on, whoever wrote the fragment.
  * 
  * @param frag Pointer to fragment structure
  * @return fragment is valid
@@ -217,22 +326,255 @@ bool ValidateFragment(const Fragment_t* frag)
     }
 }
 
-/** Validate one fragment
+/** Erase the fragment index of a slot
  * 
- * @param metadata Pointer to metadata structure
- * @return metadata is valid
+ * @param slot Fragment slot index
  */
-bool ValidateMetadata(const Metadata_t* metadata)
+static void EraseIndex(uint8_t slot)
 {
-    const uint8_t* msg = (const uint8_t*)metadata;
-    const size_t msgLen = sizeof(Metadata_t) - sizeof(metadata->metadataSignature);
+    if (!FLASH_SCHED_Erase(FRAGMENT_INDEX_AreaAddress(slot), FRAGMENT_INDEX_SLOT_SIZE))
+    {
+        printf("Erase of slot %i index failed\r\n", (int)slot);
+    }
+}
+
+/** Add a written fragment to the index of its slot. Failures only leave the
+ *  index shorter, readers fall back to the fragment area.
+ * 
+ * @param slot Fragment slot index
+ * @param frag Written fragment
+ */
+static void IndexFragment(uint8_t slot, const Fragment_t* frag)
+{
+    FragmentIndexEntry_t entry;
+
+    if (FRAGMENT_INDEX_Lookup(FLASH_SCHED_Read, slot, frag->firmwareId, frag->number, &entry))
+    {
+        /* Repeated fragment */
+        return;
+    }
+
+    if (frag->number >= FRAGMENT_INDEX_MAX_ENTRIES)
+    {
+        return;
+    }
 
-    return 1 == ed25519_verify(
-        metadata->metadataSignature,
-        msg,
-        msgLen,
-        KEYSTORE_GetMetadataPublicKey()
+    FRAGMENT_INDEX_MakeEntry(
+        &entry,
+        frag->firmwareId,
+        frag->number,
+        frag->startAddress,
+        frag->size,
+        frag->sha512
     );
+
+    if (!FLASH_SCHED_Write(
+            FRAGMENT_INDEX_EntryAddress(slot, frag->number), (const uint8_t*)&entry, sizeof(entry)))
+    {
+        printf("Indexing fragment %u.%lu failed\r\n", slot, frag->number);
+    }
+}
+
+/** Erase a fragment slot. The slot is erased with block erases first, so the
+ *  sector by sector erase of FA_EraseArea finds the whole slot blank.
+ * 
+ * @param slot Fragment slot index
+ * @return FA_EraseArea result
+ */
+static FA_ReturnCode_t EraseSlot(uint8_t slot)
+{
+    f_contentVerified[slot] = false;
+    if (f_check.slot == (int)slot)
+    {
+        f_check.slot = -1;
+    }
+
+    if (!FLASH_SCHED_Erase(f_table.slots[slot].address, f_table.slots[slot].size))
+    {
+        printf("Block erase of slot %i failed\r\n", (int)slot);
+    }
+
+    EraseIndex(slot);
+
+    /* The references went with the index */
+    if (f_table.slots[slot].refMask != 0U)
+    {
+        f_table.slots[slot].refMask = 0U;
+        if (!SLOT_ALLOC_Store(&f_table))
+        {
+            printf("Storing the partition table failed\r\n");
+        }
+    }
+
+    return FA_EraseArea(&f_fa[slot]);
+}
+
+/** Read a fragment of a slot. A reference entry in the fragment index is
+ *  followed to the slot holding the content, the address range and digest
+ *  must match the entry. The other header fields are then those of the
+ *  fragment in that slot.
+ * 
+ * @param slot Slot holding valid metadata
+ * @param number Fragment number
+ * @param frag Output fragment
+ * @return FA_ReadFragmentForce result, FA_ERR_INVALID for a broken reference
+ */
+static FA_ReturnCode_t ReadSlotFragment(int slot, size_t number, Fragment_t* frag)
+{
+    FragmentIndexEntry_t entry;
+
+    if (!FRAGMENT_INDEX_Lookup(FLASH_SCHED_Read, (uint32_t)slot, f_metadata[slot].firmwareId, (uint32_t)number, &entry) ||
+        !FRAGMENT_INDEX_IsReference(&entry))
+    {
+        return FA_ReadFragmentForce(&f_fa[slot], number, frag);
+    }
+
+    if ((entry.refSlot >= PARTITION_MAX_SLOTS) || !SlotInUse((int)entry.refSlot))
+    {
+        return FA_ERR_INVALID;
+    }
+
+    const FA_ReturnCode_t ret = FA_ReadFragmentForce(&f_fa[entry.refSlot], entry.refNumber, frag);
+
+    if ((ret == FA_ERR_OK) &&
+        ((frag->startAddress != entry.startAddress) ||
+         (frag->size != entry.size) ||
+         (0 != memcmp(frag->sha512, entry.sha512, sizeof(entry.sha512)))))
+    {
+        return FA_ERR_INVALID;
+    }
+
+    return ret;
+}
+
+/** Advance the check of the slot content against the firmware signature
+ *  of its metadata. Slot writes only check the driver status
+ *  (W25Q_VERIFY_STATUS), so a bad program is found here by reading the
+ *  slot back once per update instead of after every write. The check runs
+ *  a few fragments per request: behind the fragment writes, so an in-order
+ *  upload is checked when its last fragment lands, and in steps answered
+ *  with busy when the update command finds the check unfinished. No
+ *  request waits for a whole slot. The result is kept until the slot is
+ *  written.
+ * 
+ * @param slot Slot holding valid metadata
+ * @param maxFragments Fragments to hash in this call
+ * @param complete The upload is complete, a missing fragment fails the check
+ * @return CONTENT_VALID, CONTENT_INVALID or CONTENT_PENDING
+ */
+static ContentState_t CheckSlotContent(int slot, size_t maxFragments, bool complete)
+{
+    const Metadata_t* meta = &f_metadata[slot];
+    const uint32_t end = meta->startAddress + meta->firmwareSize;
+    Fragment_t* frag = &f_tempFragMem;
+
+    if (f_contentVerified[slot])
+    {
+        return CONTENT_VALID;
+    }
+
+    if (f_check.slot != slot)
+    {
+        if (1 != ed25519_multipart_init(&f_check.ctx, meta->firmwareSignature, KEYSTORE_GetFirmwarePublicKey()))
+        {
+            f_check.slot = -1;
+            return CONTENT_INVALID;
+        }
+        f_check.slot = slot;
+        f_check.number = 0U;
+        f_check.nextStart = 0U;
+    }
+
+    for (size_t n = 0U; (n < maxFragments) && (f_check.nextStart < end); n++)
+    {
+        if ((ReadSlotFragment(slot, f_check.number, frag) != FA_ERR_OK) ||
+            ((f_check.number > 0U) && (frag->startAddress != f_check.nextStart)) ||
+            (frag->size > sizeof(frag->content)) ||
+            (frag->size == 0U))
+        {
+            if (!complete)
+            {
+                /* Not uploaded yet, or the upload is out of order */
+                return CONTENT_PENDING;
+            }
+            printf("Slot %i fragment %u missing or out of order\r\n", slot, f_check.number);
+            f_check.slot = -1;
+            return CONTENT_INVALID;
+        }
+
+        const uint32_t fragEnd = frag->startAddress + frag->size;
+        const uint32_t first = (frag->startAddress < meta->startAddress) ? meta->startAddress : frag->startAddress;
+        const uint32_t last = (fragEnd > end) ? end : fragEnd;
+
+        if ((last > first) &&
+            (1 != ed25519_multipart_continue(&f_check.ctx, &frag->content[first - frag->startAddress], last - first)))
+        {
+            f_check.slot = -1;
+            return CONTENT_INVALID;
+        }
+
+        f_check.nextStart = fragEnd;
+        f_check.number++;
+    }
+
+    if (f_check.nextStart < end)
+    {
+        return CONTENT_PENDING;
+    }
+
+    f_check.slot = -1;
+    f_contentVerified[slot] = (1 == ed25519_multipart_end(&f_check.ctx));
+    return f_contentVerified[slot] ? CONTENT_VALID : CONTENT_INVALID;
+}
+
+/** Find another slot whose fragment index holds the content of a reference,
+ *  a fragment with the same number, address range and digest. Consecutive
+ *  releases share their unchanged fragments this way. Only the index is read.
+ *  The content must be stored in that slot, not referenced in turn, and only
+ *  verifyMethod 0 references resolve, see fragment_index.h.
+ * 
+ * @param data Fragment without content, FRAGMENT_REF_SIZE bytes
+ * @param first First slot to search
+ * @return slot number, -1 if no slot holds the content
+ */
+static int FindReferenceSlot(const uint8_t* data, int first)
+{
+    /* The digest follows the content, so it starts the tail of a reference */
+    const uint8_t* sha512 = &data[offsetof(Fragment_t, content) + offsetof(Fragment_t, sha512) - FRAGMENT_TAIL_OFFSET];
+    uint32_t firmwareId;
+    uint32_t number;
+    uint32_t startAddress;
+    uint32_t fragSize;
+    uint32_t verifyMethod;
+
+    memcpy(&verifyMethod, &data[offsetof(Fragment_t, verifyMethod)], sizeof(verifyMethod));
+    if (verifyMethod != 0U)
+    {
+        return -1;
+    }
+
+    memcpy(&firmwareId, &data[offsetof(Fragment_t, firmwareId)], sizeof(firmwareId));
+    memcpy(&number, &data[offsetof(Fragment_t, number)], sizeof(number));
+    memcpy(&startAddress, &data[offsetof(Fragment_t, startAddress)], sizeof(startAddress));
+    memcpy(&fragSize, &data[offsetof(Fragment_t, size)], sizeof(fragSize));
+
+    for (int i = first; i < (int)PARTITION_MAX_SLOTS; i++)
+    {
+        FragmentIndexEntry_t entry;
+
+        if (SlotInUse(i) &&
+            (f_metadata[i].firmwareId != firmwareId) &&
+            FRAGMENT_INDEX_Lookup(FLASH_SCHED_Read, (uint32_t)i, f_metadata[i].firmwareId, number, &entry) &&
+            !FRAGMENT_INDEX_IsReference(&entry) &&
+            (entry.startAddress == startAddress) &&
+            (entry.size == fragSize) &&
+            (0 == memcmp(entry.sha512, sha512, sizeof(entry.sha512))))
+        {
+            return i;
+        }
+    }
+
+    return -1;
 }
 
 static uint8_t ReadDataById(
@@ -277,15 +619,36 @@ static uint8_t WriteDataById(
         }
         printf("Received update metadata %lX\r\n", CRC32_Calculate(in, size));
         const Metadata_t* metadata = (const Metadata_t*)in;
-        if (!ValidateMetadata(metadata))
+        if (!KEYSTORE_VerifyMetadata(metadata))
         {
             printf("Update metadata validity check failed!\r\n");
             return PROTOCOL_NACK_INVALID_REQUEST;
         }
+        for (int i = 0; i < (int)PARTITION_MAX_SLOTS; i++)
+        {
+            if (!SlotInUse(i) || !MetadataEqual(&f_metadata[i], metadata))
+            {
+                continue;
+            }
+            if (SlotBackingUp(i))
+            {
+                return BusyRepeat();
+            }
+            const ContentState_t state = CheckSlotContent(i, CHECK_STEP_COMMAND, true);
+            if (state == CONTENT_PENDING)
+            {
+                return BusyRepeat();
+            }
+            if (state == CONTENT_INVALID)
+            {
+                printf("Slot %i content does not match the firmware signature!\r\n", i);
+                return PROTOCOL_NACK_REQUEST_FAILED;
+            }
+        }
         if (!CA_WriteInstallCommand(&f_ca, COMMAND_TYPE_INSTALL_FIRMWARE, metadata))
         {
             printf("Writing update command failed!\r\n");
-            return PROTOCOL_NACK_BUSY_REPEAT_REQUEST;
+            return BusyRepeat();
         }
         return PROTOCOL_ACK_OK;
 
@@ -294,7 +657,7 @@ static uint8_t WriteDataById(
         {
             printf("Received specific rollback command to %lx\r\n", CRC32_Calculate(in, size));
             const Metadata_t* metadata = (const Metadata_t*)in;
-            if (!ValidateMetadata(metadata))
+            if (!KEYSTORE_VerifyMetadata(metadata))
             {
                 printf("Rollback metadata validity check failed!\r\n");
                 return PROTOCOL_NACK_INVALID_REQUEST;
@@ -302,7 +665,7 @@ static uint8_t WriteDataById(
             if (!CA_WriteInstallCommand(&f_ca, COMMAND_TYPE_ROLLBACK, metadata))
             {
                 printf("Writing rollback command failed!\r\n");
-                return PROTOCOL_NACK_BUSY_REPEAT_REQUEST;
+                return BusyRepeat();
             }
         }
         else
@@ -311,7 +674,7 @@ static uint8_t WriteDataById(
             if (!CA_WriteInstallCommand(&f_ca, COMMAND_TYPE_ROLLBACK, NULL))
             {
                 printf("Writing rollback command failed!\r\n");
-                return PROTOCOL_NACK_BUSY_REPEAT_REQUEST;
+                return BusyRepeat();
             }
         }
 
@@ -323,73 +686,198 @@ static uint8_t WriteDataById(
         return PROTOCOL_ACK_OK;
 
     case PROTOCOL_DATA_ID_ERASE_SLOT:
-        if ((size == 1U) && (*in < 3U))
+        if ((size == 1U) && (*in < PARTITION_MAX_SLOTS) && SlotInUse(*in))
         {
             const uint8_t slot = *in;
+            if (SlotBackingUp(slot))
+            {
+                return BusyRepeat();
+            }
+            if ((PARTITION_ReferencedSlots(&f_table) & (1UL << slot)) != 0U)
+            {
+                printf("Slot %i holds fragments of another slot\r\n", (int)slot);
+                return PROTOCOL_NACK_REQUEST_FAILED;
+            }
             printf("Erasing slot %i...\r\n", (int)slot);
-            const FA_ReturnCode_t res = FA_EraseArea(&f_fa[slot]);
+            const FA_ReturnCode_t res = EraseSlot(slot);
             if (res == FA_ERR_OK)
             {
                 printf("OK\r\n");
+                FLASH_SCHED_PrintStats();
                 memset(&f_metadata[slot], 0, sizeof(Metadata_t));
                 return PROTOCOL_ACK_OK;
             }
             
             printf("FAILED\r\n");
-            return PROTOCOL_NACK_BUSY_REPEAT_REQUEST;
+            return BusyRepeat();
         }
         else
         {
             return PROTOCOL_NACK_INVALID_REQUEST;
         }
 
+    case SERVER_DATA_ID_FRAGMENT_LOOKUP:
+        if (size != FRAGMENT_REF_SIZE)
+        {
+            return PROTOCOL_NACK_INVALID_REQUEST;
+        }
+        return (FindReferenceSlot(in, 0) >= 0)
+            ? PROTOCOL_ACK_OK
+            : SERVER_NACK_REFERENCE_UNRESOLVED;
+
     default:
         return PROTOCOL_NACK_REQUEST_OUT_OF_RANGE;
     }
 }
 
+/* Flash access of the fragment and command areas, timed for the session log */
+static bool LoggedRead(uint32_t address, uint8_t* data, size_t size)
+{
+    const uint32_t start = SESSION_LOG_Now();
+    const bool ok = FLASH_SCHED_Read(address, data, size);
+    SESSION_LOG_Flash(SESSION_FLASH_READ, address, size, ok, start);
+    return ok;
+}
+
+static bool LoggedWrite(uint32_t address, const uint8_t* data, size_t size)
+{
+    const uint32_t start = SESSION_LOG_Now();
+    const bool ok = FLASH_SCHED_Write(address, data, size);
+    SESSION_LOG_Flash(SESSION_FLASH_WRITE, address, size, ok, start);
+    return ok;
+}
+
+static bool LoggedWriteAndVerify(uint32_t address, const uint8_t* data, size_t size)
+{
+    const uint32_t start = SESSION_LOG_Now();
+    const bool ok = FLASH_SCHED_WriteAndVerify(address, data, size);
+    SESSION_LOG_Flash(SESSION_FLASH_WRITE, address, size, ok, start);
+    return ok;
+}
+
+static bool LoggedErase(uint32_t address, size_t size)
+{
+    const uint32_t start = SESSION_LOG_Now();
+    const bool ok = FLASH_SCHED_Erase(address, size);
+    SESSION_LOG_Flash(SESSION_FLASH_ERASE, address, size, ok, start);
+    return ok;
+}
+
+/** Bind the fragment area of a slot to its extent in the partition table
+ * 
+ * @param slot Slot number
+ * @return FA_InitStruct result
+ */
+static FA_ReturnCode_t ConfigureSlot(uint32_t slot)
+{
+    f_slotConf[slot] = (MemoryConfig_t) {
+        .baseAddress = f_table.slots[slot].address,
+        .sectorSize = W25Qxx_SECTOR_SIZE,
+        .memorySize = f_table.slots[slot].size,
+        .eraseValue = 0xFF,
+
+        .Reader = LoggedRead,
+        .Writer = LoggedWrite,
+        .Eraser = LoggedErase,
+    };
+
+    return FA_InitStruct(&f_fa[slot], &f_slotConf[slot], ValidateFragment, KEYSTORE_VerifyMetadata);
+}
+
+/** Find or allocate a slot for incoming metadata. A new slot is sized to the
+ *  firmware. The slots of the running firmware and of the rescue image are
+ *  protected, an incoming rescue image replaces the old one. Empty slots
+ *  are released before anything is evicted. Slots that hold fragments of
+ *  another slot are neither released nor evicted.
+ * 
+ * @param in Incoming metadata
+ * @param alreadyExists Set if the metadata is already stored
+ * @return slot number, -1 if no slot can be allocated
+ */
 static int FindSlotForMetadata(const Metadata_t* in, bool* alreadyExists)
 {
-    int slot = -1;
-    if (in->type == DEFAULT_APP_TYPE_RESCUE)
+    uint32_t protectMask = 0U;
+    uint32_t releaseMask = 0U;
+
+    for (int i = 0; i < (int)PARTITION_MAX_SLOTS; i++)
     {
-        for (int i = 0; i < 3; i++)
+        if (!SlotInUse(i))
+        {
+            continue;
+        }
+        if (MetadataEqual(&f_metadata[i], in))
         {
-            if (f_metadata[i].type == DEFAULT_APP_TYPE_RESCUE)
+            /* Incoming metadata already exits */
+            *alreadyExists = true;
+            return i;
+        }
+        if (MetadataEqual(&f_metadata[i], &FIRMWARE_METADATA))
+        {
+            protectMask |= (1UL << i);
+        }
+        else if (f_metadata[i].type == DEFAULT_APP_TYPE_RESCUE)
+        {
+            if (in->type == DEFAULT_APP_TYPE_RESCUE)
             {
                 /* Always replace the existing rescue image */
-                slot = i;
-                *alreadyExists = MetadataEqual(in, &f_metadata[i]);
-                break;
+                releaseMask |= (1UL << i);
             }
-            if (!MetadataEqual(&f_metadata[i], &FIRMWARE_METADATA))
+            else
             {
-                /* If rescue app doesn't already exist */
-                /* Ensure we don't overwrite the copy of the current firmware or the rescue firmware */
-                slot = i;
+                protectMask |= (1UL << i);
             }
         }
+        else if (f_metadata[i].firmwareId == 0U)
+        {
+            releaseMask |= (1UL << i);
+        }
     }
-    else
+
+    /* Forged metadata may not evict anything */
+    if (!KEYSTORE_VerifyMetadata(in))
     {
-        for (int i = 0; i < 3; i++)
+        return -1;
+    }
+
+    /* Released only now, so an early return leaves the table untouched.
+       Slots holding fragments of another slot stay. */
+    releaseMask &= ~PARTITION_ReferencedSlots(&f_table);
+
+    for (int i = 0; i < (int)PARTITION_MAX_SLOTS; i++)
+    {
+        if ((releaseMask & (1UL << i)) != 0U)
         {
-            if (MetadataEqual(&f_metadata[i], in))
-            {
-                /* Incoming metadata already exits */
-                slot = i;
-                *alreadyExists = true;
-                break;
-            }
-            if (!MetadataEqual(&f_metadata[i], &FIRMWARE_METADATA) &&
-                (f_metadata[i].type != DEFAULT_APP_TYPE_RESCUE))
-            {
-                /* Ensure we don't overwrite the copy of the current firmware or the rescue firmware */
-                slot = i;
-            }
+            f_table.slots[i].size = PARTITION_UNUSED;
         }
     }
-    return slot;
+
+    uint32_t slot = 0U;
+    uint32_t evictedMask = 0U;
+
+    if (!SLOT_ALLOC_Allocate(&f_table, PARTITION_SlotSizeFor(in->firmwareSize), protectMask, &slot, &evictedMask) ||
+        !SLOT_ALLOC_Store(&f_table))
+    {
+        (void)PARTITION_Read(FLASH_SCHED_Read, &f_table);
+        return -1;
+    }
+
+    for (uint32_t i = 0U; i < PARTITION_MAX_SLOTS; i++)
+    {
+        if (!SlotInUse((int)i))
+        {
+            memset(&f_metadata[i], 0, sizeof(Metadata_t));
+        }
+    }
+
+    printf("Allocated slot %lu: %lu KB at %08lX\r\n",
+        slot, f_table.slots[slot].size / KB, f_table.slots[slot].address);
+
+    if ((FA_ERR_OK != ConfigureSlot(slot)) || (FA_ERR_OK != EraseSlot((uint8_t)slot)))
+    {
+        return -1;
+    }
+
+    return (int)slot;
 }
 
 static uint8_t PutMetadata(
@@ -429,13 +917,14 @@ static uint8_t PutMetadata(
     if (code == FA_ERR_OK)
     {
         (void)memcpy(&f_metadata[slot], meta, sizeof(Metadata_t));
+        EraseIndex((uint8_t)slot);
         printf("Wrote metadata to slot %i\r\n", slot);
         return PROTOCOL_ACK_OK;
     }
     else if (code == FA_ERR_BUSY)
     {
         printf("Write service busy\r\n");
-        return PROTOCOL_NACK_BUSY_REPEAT_REQUEST;
+        return BusyRepeat();
     }
     else
     {
@@ -444,28 +933,128 @@ static uint8_t PutMetadata(
     }
 }
 
+/** Rebuild a fragment from a reference. The content is read from a slot
+ *  found by FindReferenceSlot, so the fragment can be validated like a
+ *  received one before the reference is recorded.
+ * 
+ * @param data Fragment without content, FRAGMENT_REF_SIZE bytes
+ * @param source Output slot holding the content
+ * @return rebuilt fragment, NULL if no slot holds the content
+ */
+static const Fragment_t* ResolveReference(const uint8_t* data, int* source)
+{
+    Fragment_t* frag = &f_refFragMem;
+    uint32_t number;
+
+    memcpy(&number, &data[offsetof(Fragment_t, number)], sizeof(number));
+
+    for (int i = FindReferenceSlot(data, 0); i >= 0; i = FindReferenceSlot(data, i + 1))
+    {
+        if (FA_ReadFragmentForce(&f_fa[i], number, frag) != FA_ERR_OK)
+        {
+            continue;
+        }
+
+        /* Keep the content, take everything else from the reference */
+        memcpy(frag, data, offsetof(Fragment_t, content));
+        memcpy((uint8_t*)frag + FRAGMENT_TAIL_OFFSET,
+            &data[offsetof(Fragment_t, content)],
+            sizeof(Fragment_t) - FRAGMENT_TAIL_OFFSET);
+
+        *source = i;
+        return frag;
+    }
+
+    return NULL;
+}
+
+/** Record a validated fragment as a reference in the fragment index of its
+ *  slot. Nothing is written to the fragment area. The referenced slot is
+ *  added to the refMask of the slot in the partition table first, so a
+ *  reset never leaves a reference to a slot that may be evicted.
+ * 
+ * @param slot Slot of the fragment
+ * @param frag Fragment rebuilt by ResolveReference
+ * @param source Slot holding the content
+ * @return FA_ERR_OK, FA_ERR_INVALID if the fragment is not valid or
+ *         FA_ERR_BUSY if a flash write failed
+ */
+static FA_ReturnCode_t StoreReference(int slot, const Fragment_t* frag, int source)
+{
+    const uint32_t bit = 1UL << source;
+    FragmentIndexEntry_t entry;
+
+    if (!ValidateFragment(frag))
+    {
+        return FA_ERR_INVALID;
+    }
+
+    if ((f_table.slots[slot].refMask & bit) == 0U)
+    {
+        f_table.slots[slot].refMask |= bit;
+        if (!SLOT_ALLOC_Store(&f_table))
+        {
+            (void)PARTITION_Read(FLASH_SCHED_Read, &f_table);
+            return FA_ERR_BUSY;
+        }
+    }
+
+    FRAGMENT_INDEX_MakeReference(
+        &entry,
+        frag->firmwareId,
+        frag->number,
+        frag->startAddress,
+        frag->size,
+        frag->sha512,
+        (uint32_t)source,
+        frag->number
+    );
+
+    if (!FLASH_SCHED_Write(
+            FRAGMENT_INDEX_EntryAddress((uint32_t)slot, frag->number), (const uint8_t*)&entry, sizeof(entry)))
+    {
+        return FA_ERR_BUSY;
+    }
+
+    f_dedupCount++;
+    return FA_ERR_OK;
+}
+
+/** Store a received fragment. A fragment of FRAGMENT_REF_SIZE bytes is a
+ *  reference without content, it is recorded in the fragment index only
+ *  and acknowledged without a fragment write. A client may ask first with
+ *  SERVER_DATA_ID_FRAGMENT_LOOKUP, or send the reference and fall back to
+ *  the full fragment on SERVER_NACK_REFERENCE_UNRESOLVED. Any other size is
+ *  malformed and gets PROTOCOL_NACK_REQUEST_OUT_OF_RANGE. A fragment that
+ *  is already stored is acknowledged without writing.
+ * 
+ * @param data Fragment or fragment reference
+ * @param size Data size
+ * @return protocol response code
+ */
 static uint8_t PutFragment(
     const uint8_t* data, 
     size_t size)
 {
     printf("Received fragment %lX\r\n", CRC32_Calculate(data, size));
 
-    if (size != sizeof(Fragment_t))
-    {
-        return PROTOCOL_NACK_REQUEST_OUT_OF_RANGE;
-    }
-
     const Fragment_t* frag = (const Fragment_t*)data;
+    int source = -1;
 
-    int slot = -1;
-    for (int i = 0; i < 3; i++)
+    if (size == FRAGMENT_REF_SIZE)
     {
-        if (frag->firmwareId == f_metadata[i].firmwareId)
+        frag = ResolveReference(data, &source);
+        if (frag == NULL)
         {
-            slot = i;
-            break;
+            return SERVER_NACK_REFERENCE_UNRESOLVED;
         }
     }
+    else if (size != sizeof(Fragment_t))
+    {
+        return PROTOCOL_NACK_REQUEST_OUT_OF_RANGE;
+    }
+
+    const int slot = FindSlotForFirmware(frag->firmwareId);
 
     if (slot < 0)
     {
@@ -473,17 +1062,47 @@ static uint8_t PutFragment(
         return PROTOCOL_NACK_REQUEST_FAILED;
     }
 
-    FA_ReturnCode_t code =  FA_WriteFragment(&f_fa[slot], frag->number, frag);
+    if (SlotBackingUp(slot))
+    {
+        return BusyRepeat();
+    }
+
+    FragmentIndexEntry_t entry;
+    if (FRAGMENT_INDEX_Lookup(FLASH_SCHED_Read, (uint32_t)slot, frag->firmwareId, frag->number, &entry) &&
+        (0 == memcmp(entry.sha512, frag->sha512, sizeof(entry.sha512))))
+    {
+        printf("Fragment %u.%lu already stored\r\n", slot, frag->number);
+        return PROTOCOL_ACK_OK;
+    }
+
+    FA_ReturnCode_t code = (source >= 0)
+        ? StoreReference(slot, frag, source)
+        : FA_WriteFragment(&f_fa[slot], frag->number, frag);
 
     if (code == FA_ERR_OK)
     {
-        printf("Wrote fragment to slot %u.%lu\r\n", slot, frag->number);
+        f_contentVerified[slot] = false;
+        if ((f_check.slot == slot) && (frag->number < f_check.number))
+        {
+            /* Hashed part changed, start over */
+            f_check.slot = -1;
+        }
+        if (source >= 0)
+        {
+            printf("Fragment %u.%lu refers to slot %i (%lu reused)\r\n", slot, frag->number, source, f_dedupCount);
+        }
+        else
+        {
+            IndexFragment((uint8_t)slot, frag);
+            printf("Wrote fragment to slot %u.%lu\r\n", slot, frag->number);
+        }
+        (void)CheckSlotContent(slot, CHECK_STEP_WRITE, false);
         return PROTOCOL_ACK_OK;
     }
     else if (code == FA_ERR_BUSY)
     {
         printf("Write service busy\r\n");
-        return PROTOCOL_NACK_BUSY_REPEAT_REQUEST;
+        return BusyRepeat();
     }
     else
     {
@@ -492,68 +1111,173 @@ static uint8_t PutFragment(
     }
 }
 
+/* Protocol callbacks as registered, with results and durations logged */
+static uint8_t LoggedReadDataById(uint8_t id, uint8_t* out, size_t maxSize, size_t* size)
+{
+    const uint32_t start = SESSION_LOG_Now();
+    const uint8_t res = ReadDataById(id, out, maxSize, size);
+    SESSION_LOG_Callback(SESSION_CB_READ_DATA, res, start);
+    return res;
+}
+
+static uint8_t LoggedWriteDataById(uint8_t id, const uint8_t* in, size_t size)
+{
+    const uint32_t start = SESSION_LOG_Now();
+    const uint8_t res = WriteDataById(id, in, size);
+    SESSION_LOG_Callback(SESSION_CB_WRITE_DATA, res, start);
+    return res;
+}
+
+static uint8_t LoggedPutMetadata(const uint8_t* data, size_t size)
+{
+    const uint32_t start = SESSION_LOG_Now();
+    const uint8_t res = PutMetadata(data, size);
+    SESSION_LOG_Callback(SESSION_CB_PUT_METADATA, res, start);
+    return res;
+}
+
+static uint8_t LoggedPutFragment(const uint8_t* data, size_t size)
+{
+    const uint32_t start = SESSION_LOG_Now();
+    const uint8_t res = PutFragment(data, size);
+    SESSION_LOG_Callback(SESSION_CB_PUT_FRAGMENT, res, start);
+    return res;
+}
+
+#ifdef ENABLE_FIRMWARE_BACKUP
+/** Copy the running firmware into a slot unless a slot already holds it.
+ *  A slot with the metadata of the running firmware is continued, it may
+ *  hold an interrupted backup or upload. A new slot only takes free space,
+ *  the backup never evicts another firmware. Only the allocation happens
+ *  here, the backup task erases the slot and writes the metadata, so the
+ *  server is not held up by the erase.
+ */
+static void StartBackup(void)
+{
+    int slot = FindSlotForFirmware(FIRMWARE_METADATA.firmwareId);
+    bool prepare = false;
+
+    if ((slot >= 0) && !MetadataEqual(&f_metadata[slot], &FIRMWARE_METADATA))
+    {
+        /* Fragments are routed by firmwareId, a second slot with the same id
+           would never receive them */
+        printf("Slot %i holds other metadata of firmware %lX, no backup\r\n",
+            slot, FIRMWARE_METADATA.firmwareId);
+        return;
+    }
+
+    if (slot < 0)
+    {
+        uint32_t protectMask = 0U;
+        uint32_t newSlot = 0U;
+        uint32_t evictedMask = 0U;
+
+        if (!KEYSTORE_VerifyMetadata(&FIRMWARE_METADATA))
+        {
+            printf("Running firmware is not signed, no backup\r\n");
+            return;
+        }
+
+        for (int i = 0; i < (int)PARTITION_MAX_SLOTS; i++)
+        {
+            if (SlotInUse(i) && (f_metadata[i].firmwareId != 0U))
+            {
+                protectMask |= (1UL << i);
+            }
+        }
+
+        if (!SLOT_ALLOC_Allocate(&f_table, PARTITION_SlotSizeFor(FIRMWARE_METADATA.firmwareSize), protectMask, &newSlot, &evictedMask) ||
+            !SLOT_ALLOC_Store(&f_table))
+        {
+            (void)PARTITION_Read(FLASH_SCHED_Read, &f_table);
+            printf("No free space for a firmware backup\r\n");
+            return;
+        }
+
+        slot = (int)newSlot;
+
+        for (int i = 0; i < (int)PARTITION_MAX_SLOTS; i++)
+        {
+            if (!SlotInUse(i))
+            {
+                memset(&f_metadata[i], 0, sizeof(Metadata_t));
+            }
+        }
+
+        if (FA_ERR_OK != ConfigureSlot((uint32_t)slot))
+        {
+            printf("Preparing backup slot %i failed\r\n", slot);
+            return;
+        }
+
+        f_contentVerified[slot] = false;
+        prepare = true;
+    }
+
+    /* Set first, the slot is busy for uploads from here on */
+    memcpy(&f_metadata[slot], &FIRMWARE_METADATA, sizeof(Metadata_t));
+
+    if (!BACKUP_Start((uint32_t)slot, f_table.slots[slot].address, f_table.slots[slot].size, prepare))
+    {
+        printf("Starting the firmware backup failed\r\n");
+        if (prepare)
+        {
+            memset(&f_metadata[slot], 0, sizeof(Metadata_t));
+        }
+    }
+}
+#endif
+
+#ifdef ENABLE_SESSION_LOG
+static void CaptureWrite(const uint8_t* data, size_t size)
+{
+    (void)sendto(f_captureSock, data, size, 0, (struct sockaddr*)&f_captureAddr, sizeof(f_captureAddr));
+}
+#endif
+
 /*----------------------------------------------------------------------------*/
 /* PUBLIC FUNCTION DEFINITIONS                                                */
 /*----------------------------------------------------------------------------*/
 
+void SERVER_PrintStats(void)
+{
+    printf("Answered %lu busy requests, reused %lu fragments\r\n", f_busyCount, f_dedupCount);
+}
+
 void SERVER_UdpUpdateServer(w25qxx_handle_t *arg)
 {
     f_resetRequest = false;
     f_w25q128 = arg;
     REQUIRE(f_w25q128 != NULL);
 
-    static const MemoryConfig_t memConf[4] = {
-        // Fragment area 0
-        {
-            .baseAddress = 0x0,
-            .sectorSize = W25Qxx_SECTOR_SIZE,
-            .memorySize = UPDATE_SLOT_SIZE,
-            .eraseValue = 0xFF,
-
-            .Reader = W25Qxx_INTERFACE_ReadFlash,
-            .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
-            .Eraser = W25Qxx_INTERFACE_EraseFlash,
-        },
-        // Fragment area 1
-        {
-            .baseAddress = UPDATE_SLOT_SIZE,
-            .sectorSize = W25Qxx_SECTOR_SIZE,
-            .memorySize = UPDATE_SLOT_SIZE,
-            .eraseValue = 0xFF,
-
-            .Reader = W25Qxx_INTERFACE_ReadFlash,
-            .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
-            .Eraser = W25Qxx_INTERFACE_EraseFlash,
-        },
-        // Fragment area 2
-        {
-            .baseAddress = 2U * UPDATE_SLOT_SIZE,
-            .sectorSize = W25Qxx_SECTOR_SIZE,
-            .memorySize = UPDATE_SLOT_SIZE,
-            .eraseValue = 0xFF,
-
-            .Reader = W25Qxx_INTERFACE_ReadFlash,
-            .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
-            .Eraser = W25Qxx_INTERFACE_EraseFlash,
-        },
-        // Update command area
-        {
-            .baseAddress = 3U * UPDATE_SLOT_SIZE,
-            .sectorSize = W25Qxx_SECTOR_SIZE,
-            .memorySize = 3U * W25Qxx_SECTOR_SIZE,
-            .eraseValue = 0xFF,
-
-            .Reader = W25Qxx_INTERFACE_ReadFlash,
-            .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
-            .Eraser = W25Qxx_INTERFACE_EraseFlash,
-        },
+    static const MemoryConfig_t caConf = {
+        .baseAddress = PARTITION_COMMAND_AREA_ADDRESS,
+        .sectorSize = W25Qxx_SECTOR_SIZE,
+        .memorySize = PARTITION_COMMAND_AREA_SIZE,
+        .eraseValue = 0xFF,
+
+        .Reader = LoggedRead,
+        .Writer = LoggedWriteAndVerify,
+        .Eraser = LoggedErase,
     };
 
-    for (int i = 0; i < 3; i++)
+    if (!PARTITION_Read(FLASH_SCHED_Read, &f_table))
     {
-        REQUIRE(FA_ERR_OK == FA_InitStruct(&f_fa[i], &memConf[i], ValidateFragment, ValidateMetadata));
+        printf("No partition table, using the default slots\r\n");
+    }
+
+    for (int i = 0; i < (int)PARTITION_MAX_SLOTS; i++)
+    {
+        memset(&f_metadata[i], 0, sizeof(Metadata_t));
+
+        if (!SlotInUse(i))
+        {
+            continue;
+        }
+
+        REQUIRE(FA_ERR_OK == ConfigureSlot((uint32_t)i));
         const FA_ReturnCode_t res = FA_ReadMetadata(&f_fa[i], &f_metadata[i]);
-        printf("Slot %i metadata ", i);
+        printf("Slot %i (%lu KB) metadata ", i, f_table.slots[i].size / KB);
         switch (res)
         {
             case FA_ERR_OK:
@@ -564,7 +1288,7 @@ void SERVER_UdpUpdateServer(w25qxx_handle_t *arg)
                 break;
             case FA_ERR_INVALID:
                 printf("INVALID\r\n");
-                FA_EraseArea(&f_fa[i]);
+                (void)EraseSlot((uint8_t)i);
                 break;
             case FA_ERR_BUSY:
                 printf("BUSY\r\n");
@@ -581,8 +1305,13 @@ void SERVER_UdpUpdateServer(w25qxx_handle_t *arg)
             memset(&f_metadata[i], 0, sizeof(Metadata_t));
         }
     }
-    REQUIRE(CA_InitStruct(&f_ca, &memConf[3], &CRC32_Calculate));
-    REQUIRE(US_InitServer(&f_us, ReadDataById, WriteDataById, PutMetadata, PutFragment));
+    REQUIRE(CA_InitStruct(&f_ca, &caConf, &CRC32_Calculate));
+
+#ifdef ENABLE_FIRMWARE_BACKUP
+    StartBackup();
+#endif
+
+    REQUIRE(US_InitServer(&f_us, LoggedReadDataById, LoggedWriteDataById, LoggedPutMetadata, LoggedPutFragment));
     REQUIRE(TRANSFER_Init(&f_tb, &f_us, f_memBlock, sizeof(f_memBlock)));
 
     int sock;
@@ -617,6 +1346,19 @@ void SERVER_UdpUpdateServer(w25qxx_handle_t *arg)
 
         SERVER_NotifyCallback();
 
+#ifdef ENABLE_SESSION_LOG
+        /* Capture the session of the first client */
+        if (!SESSION_LOG_Active())
+        {
+            f_captureSock = sock;
+            f_captureAddr = client_addr;
+            f_captureAddr.sin_port = htons(SESSION_LOG_PORT);
+            SESSION_LOG_Start(CaptureWrite);
+        }
+#endif
+
+        SESSION_LOG_Pdu(packet, (size_t)recvLen);
+
         const size_t resSize = TRANSFER_Process(&f_tb, packet, recvLen, sizeof(packet));
 
         sendto(
@@ -628,16 +1370,21 @@ void SERVER_UdpUpdateServer(w25qxx_handle_t *arg)
             client_addr_len
         );
 
+        SESSION_LOG_Response(packet, resSize);
+        SESSION_LOG_Flush();
+
         if (f_resetRequest)
         {
             break;
         }
     }
 
+    SESSION_LOG_Stop();
     close(sock);
 
     if (f_resetRequest)
     {
+        SERVER_PrintStats();
         printf("Executing reset request\r\n");
         TIM6_Delay_us(1000);
         system_reset_graceful();
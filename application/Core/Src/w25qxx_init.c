@@ -33,9 +33,12 @@
 
 #include "w25qxx_init.h"
 #include "stm32f4xx_it.h"
+#include "FreeRTOS.h"
+#include "task.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdarg.h>
 
@@ -49,6 +52,15 @@ typedef struct
     SPI_HandleTypeDef* hspi;
     GPIO_TypeDef* csPort;
     uint16_t csPin;
+    TaskHandle_t waiter;        /* Task blocked on a DMA transfer */
+    volatile bool dmaError;
+    uint32_t blankBegin;        /* Range known to be erased, empty if equal */
+    uint32_t blankEnd;
+    uint32_t eraseBegin;        /* Range of the ongoing erase, empty if equal */
+    uint32_t eraseEnd;
+    W25qEraseHook_t eraseHook;
+    bool suspended;
+    bool programming;           /* Page program in flight */
 } ImplHandle_t;
 
 /*----------------------------------------------------------------------------*/
@@ -69,16 +81,163 @@ if (NULL == ptr)\
     return NULL;\
 }
 
+#define SPI_TIMEOUT_MS      (1000U)
+
+/* Shorter transfers are faster with polling than with DMA setup */
+#define DMA_MIN_LEN         (32U)
+
+/* CCM RAM is not reachable by the DMA controllers */
+#define CCMRAM_BEGIN        (0x10000000U)
+#define CCMRAM_END          (0x10010000U)
+
+#define CMD_READ_DATA       (0x03U)
+#define CMD_FAST_READ       (0x0BU)
+#define READ_CMD_LEN        (4U)
+#define FAST_READ_CMD_LEN   (5U)
+#define CMD_READ_STATUS1    (0x05U)
+#define STATUS1_BUSY        (0x01U)
+#define CMD_PAGE_PROGRAM    (0x02U)
+#define CMD_READ_STATUS2    (0x35U)
+#define STATUS2_SUS         (0x80U)
+#define CMD_SUSPEND         (0x75U)
+#define CMD_RESUME          (0x7AU)
+
+/* tSUS is 20 us max, poll a bit longer before giving up */
+#define SUSPEND_POLL_US     (5U)
+#define SUSPEND_POLLS       (20U)
+
+#define SECTOR_SIZE         (0x1000U)
+#define BLOCK_32K_SIZE      (0x8000U)
+#define BLOCK_64K_SIZE      (0x10000U)
+#define SECTORS_PER_64K     (BLOCK_64K_SIZE / SECTOR_SIZE)
+#define SECTORS_PER_32K     (BLOCK_32K_SIZE / SECTOR_SIZE)
+
+/* Dirty sector count from which a block erase is faster than sector erases.
+   Typical W25Q128 times: 4 KB 45 ms, 32 KB 120 ms, 64 KB 150 ms. */
+#define BLOCK_64K_MIN_DIRTY (4U)
+#define BLOCK_32K_MIN_DIRTY (3U)
+
+#define READ_CHUNK          (1024U)
+#define ERASED_WORD         (0xFFFFFFFFU)
+
+#define PAGE_SIZE           (256U)
+
+/* tPP is 0.7 ms typical, 3 ms max. A 1 ms sleep per page would cap writes
+   at 256 B/ms, so page programs are polled with yields instead. */
+#define PROGRAM_TIMEOUT_MS  (10U)
+#define PROGRAM_POLL_US     (20U)
+
 /*----------------------------------------------------------------------------*/
 /* VARIABLE DEFINITIONS                                                       */
 /*----------------------------------------------------------------------------*/
 
 static ImplHandle_t f_impl;
 
+/* Blank check and write verify buffer, word aligned for the compare */
+static uint32_t f_readBuf[READ_CHUNK / sizeof(uint32_t)];
+
+static W25qVerifyPolicy_t f_verifyPolicy = W25Q_VERIFY_POLICY;
+
 /*----------------------------------------------------------------------------*/
 /* PRIVATE FUNCTION DEFINITIONS                                               */
 /*----------------------------------------------------------------------------*/
 
+static bool SchedulerRunning(void)
+{
+    return xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+}
+
+static bool UseDma(const uint8_t* buf, uint32_t len)
+{
+    const uint32_t addr = (uint32_t)buf;
+
+    return (len >= DMA_MIN_LEN) &&
+           (len <= 0xFFFFU) &&
+           ((addr < CCMRAM_BEGIN) || (addr >= CCMRAM_END)) &&
+           SchedulerRunning();
+}
+
+/** Block the calling task until the DMA transfer started after this call
+ *  completes. Must be called before starting the transfer.
+ */
+static void PrepareWait(void)
+{
+    f_impl.dmaError = false;
+    (void)ulTaskNotifyTake(pdTRUE, 0);
+    f_impl.waiter = xTaskGetCurrentTaskHandle();
+}
+
+static HAL_StatusTypeDef WaitDma(void)
+{
+    const uint32_t done = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SPI_TIMEOUT_MS));
+    f_impl.waiter = NULL;
+
+    if (done == 0U)
+    {
+        (void)HAL_SPI_Abort(f_impl.hspi);
+        return HAL_TIMEOUT;
+    }
+
+    return f_impl.dmaError ? HAL_ERROR : HAL_OK;
+}
+
+static HAL_StatusTypeDef Transmit(uint8_t* buf, uint32_t len)
+{
+    if (!UseDma(buf, len))
+    {
+        return HAL_SPI_Transmit(f_impl.hspi, buf, len, SPI_TIMEOUT_MS);
+    }
+
+    PrepareWait();
+    HAL_StatusTypeDef hal = HAL_SPI_Transmit_DMA(f_impl.hspi, buf, len);
+    return (hal == HAL_OK) ? WaitDma() : hal;
+}
+
+static HAL_StatusTypeDef Receive(uint8_t* buf, uint32_t len)
+{
+    if (!UseDma(buf, len))
+    {
+        return HAL_SPI_Receive(f_impl.hspi, buf, len, SPI_TIMEOUT_MS);
+    }
+
+    PrepareWait();
+    HAL_StatusTypeDef hal = HAL_SPI_Receive_DMA(f_impl.hspi, buf, len);
+    return (hal == HAL_OK) ? WaitDma() : hal;
+}
+
+static void NotifyWaiter(SPI_HandleTypeDef* hspi, bool error)
+{
+    if ((hspi != f_impl.hspi) || (f_impl.waiter == NULL))
+    {
+        return;
+    }
+
+    BaseType_t woken = pdFALSE;
+    f_impl.dmaError = error;
+    vTaskNotifyGiveFromISR(f_impl.waiter, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    NotifyWaiter(hspi, false);
+}
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    NotifyWaiter(hspi, false);
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    NotifyWaiter(hspi, false);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi)
+{
+    NotifyWaiter(hspi, true);
+}
+
 uint8_t W25QXX_INT_SpiInit(void)
 {
     /* SPI initialization occurs outside of this module! */
@@ -112,6 +271,26 @@ uint8_t W25QXX_INT_SpiWriteRead(uint8_t instruction, uint8_t instruction_line,
         return 1;
     }
     
+    if ((in_len > 0U) && (in_buf[0] == CMD_PAGE_PROGRAM))
+    {
+        f_impl.blankBegin = 0U;
+        f_impl.blankEnd = 0U;
+    }
+
+    /* Fast read allows the full SPI clock for bulk reads */
+    uint8_t fastRead[FAST_READ_CMD_LEN];
+
+    if ((in_len == READ_CMD_LEN) && (in_buf[0] == CMD_READ_DATA) && (out_len > 0U))
+    {
+        fastRead[0] = CMD_FAST_READ;
+        fastRead[1] = in_buf[1];
+        fastRead[2] = in_buf[2];
+        fastRead[3] = in_buf[3];
+        fastRead[4] = 0x00U; /* Dummy byte */
+        in_buf = fastRead;
+        in_len = FAST_READ_CMD_LEN;
+    }
+
     HAL_GPIO_WritePin(f_impl.csPort, f_impl.csPin, GPIO_PIN_RESET);
 
     uint8_t res = 0;
@@ -119,7 +298,7 @@ uint8_t W25QXX_INT_SpiWriteRead(uint8_t instruction, uint8_t instruction_line,
 
     if (in_len > 0U)
     {
-        hal = HAL_SPI_Transmit(f_impl.hspi, in_buf, in_len, 1000);
+        hal = Transmit(in_buf, in_len);
 
         if (hal != HAL_OK)
         {
@@ -129,7 +308,7 @@ uint8_t W25QXX_INT_SpiWriteRead(uint8_t instruction, uint8_t instruction_line,
 
     if ((res == 0U) && (out_len > 0U))
     {
-        hal = HAL_SPI_Receive(f_impl.hspi, out_buf, out_len, 1000);
+        hal = Receive(out_buf, out_len);
 
         if (hal != HAL_OK)
         {
@@ -142,8 +321,23 @@ uint8_t W25QXX_INT_SpiWriteRead(uint8_t instruction, uint8_t instruction_line,
     return res;
 }
 
+/* The driver polls the busy flag with these delays during erase and program.
+   Sleeping lets lwIP and other tasks run while the chip is busy. */
 void W25QXX_INT_Delay_ms(uint32_t ms)
 {
+    /* Let the owner serve reads between the busy polls of an erase */
+    if ((f_impl.eraseEnd > f_impl.eraseBegin) && (f_impl.eraseHook != NULL) && !f_impl.suspended)
+    {
+        f_impl.eraseHook(f_impl.eraseBegin, f_impl.eraseEnd);
+    }
+
+    if (SchedulerRunning())
+    {
+        const TickType_t ticks = pdMS_TO_TICKS(ms);
+        vTaskDelay((ticks > 0U) ? ticks : 1U);
+        return;
+    }
+
     for (uint32_t i = 0; i < ms; i++)
     {
         TIM6_Delay_us(1000U);
@@ -152,7 +346,27 @@ void W25QXX_INT_Delay_ms(uint32_t ms)
 
 void W25QXX_INT_Delay_us(uint32_t us)
 {
+    /* The driver polls a page program with short delays. Wait in the status
+       poll until the program ends, yielding between the polls. */
+    if (f_impl.programming && SchedulerRunning())
+    {
+        (void)W25Q128_WaitReady(PROGRAM_TIMEOUT_MS);
+        return;
+    }
+
+    if (us >= 1000U)
+    {
+        W25QXX_INT_Delay_ms(us / 1000U);
+        us %= 1000U;
+    }
+
     TIM6_Delay_us(us);
+
+    /* Short poll intervals cannot sleep, give the CPU to other ready tasks */
+    if (SchedulerRunning())
+    {
+        taskYIELD();
+    }
 }
 
 void W25QXX_INT_DebugPrint(const char* const fmt, ...)
@@ -177,6 +391,193 @@ void W25QXX_INT_DebugPrint(const char* const fmt, ...)
     (void)printf(str);
 }
 
+static bool Command(uint8_t cmd)
+{
+    return 0U == W25QXX_INT_SpiWriteRead(0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, &cmd, 1U, NULL, 0U, 1U);
+}
+
+static bool ReadStatus(uint8_t cmd, uint8_t* status)
+{
+    return 0U == W25QXX_INT_SpiWriteRead(0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, &cmd, 1U, status, 1U, 1U);
+}
+
+/** Run a driver erase function, recording the range for the erase hook */
+static bool EraseCommand(uint8_t (*erase)(w25qxx_handle_t*, uint32_t), uint32_t address, uint32_t size)
+{
+    f_impl.eraseBegin = address;
+    f_impl.eraseEnd = address + size;
+
+    const bool ok = (0U == erase(&f_impl.w25q128, address));
+
+    f_impl.eraseBegin = 0U;
+    f_impl.eraseEnd = 0U;
+    return ok;
+}
+
+static bool KnownBlank(uint32_t address, uint32_t size)
+{
+    return (address >= f_impl.blankBegin) && ((address + size) <= f_impl.blankEnd);
+}
+
+static bool SectorBlank(uint32_t address)
+{
+    if (KnownBlank(address, SECTOR_SIZE))
+    {
+        return true;
+    }
+
+    for (uint32_t offset = 0U; offset < SECTOR_SIZE; offset += READ_CHUNK)
+    {
+        if (0U != w25qxx_read(&f_impl.w25q128, address + offset, (uint8_t*)f_readBuf, READ_CHUNK))
+        {
+            return false;
+        }
+
+        for (size_t i = 0U; i < (READ_CHUNK / sizeof(uint32_t)); i += 4U)
+        {
+            if ((f_readBuf[i] & f_readBuf[i + 1U] &
+                 f_readBuf[i + 2U] & f_readBuf[i + 3U]) != ERASED_WORD)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/** Get a bit mask of the sectors to erase in [address, address + count sectors)
+ * 
+ * @return bit i set if sector i is not blank
+ */
+static uint32_t DirtySectors(uint32_t address, uint32_t count)
+{
+    uint32_t dirty = 0U;
+
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        if (!SectorBlank(address + (i * SECTOR_SIZE)))
+        {
+            dirty |= (1UL << i);
+        }
+    }
+
+    return dirty;
+}
+
+static uint32_t CountBits(uint32_t mask)
+{
+    return (uint32_t)__builtin_popcount(mask);
+}
+
+static bool EraseSectors(uint32_t address, uint32_t dirty, uint32_t count)
+{
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        if (((dirty & (1UL << i)) != 0U) &&
+            !EraseCommand(w25qxx_sector_erase_4k, address + (i * SECTOR_SIZE), SECTOR_SIZE))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool Erase32k(uint32_t address, uint32_t dirty)
+{
+    if (CountBits(dirty) >= BLOCK_32K_MIN_DIRTY)
+    {
+        return EraseCommand(w25qxx_block_erase_32k, address, BLOCK_32K_SIZE);
+    }
+
+    return EraseSectors(address, dirty, SECTORS_PER_32K);
+}
+
+static bool Erase64k(uint32_t address)
+{
+    const uint32_t dirty = DirtySectors(address, SECTORS_PER_64K);
+
+    if (CountBits(dirty) >= BLOCK_64K_MIN_DIRTY)
+    {
+        return EraseCommand(w25qxx_block_erase_64k, address, BLOCK_64K_SIZE);
+    }
+
+    const uint32_t lowMask = (1UL << SECTORS_PER_32K) - 1U;
+
+    return Erase32k(address, dirty & lowMask) &&
+           Erase32k(address + BLOCK_32K_SIZE, dirty >> SECTORS_PER_32K);
+}
+
+static void CrcReset(void)
+{
+    __HAL_RCC_CRC_CLK_ENABLE();
+    CRC->CR = CRC_CR_RESET;
+}
+
+/** Feed bytes to the CRC unit. Only the last call of a sequence may have a
+ *  length that is not a multiple of 4, the tail is padded with zeros.
+ */
+static uint32_t CrcFeed(const uint8_t* data, size_t len)
+{
+    size_t i = 0U;
+
+    for (; (i + 4U) <= len; i += 4U)
+    {
+        uint32_t word;
+        memcpy(&word, &data[i], sizeof(word));
+        CRC->DR = word;
+    }
+
+    if (i < len)
+    {
+        uint32_t word = 0U;
+        memcpy(&word, &data[i], len - i);
+        CRC->DR = word;
+    }
+
+    return CRC->DR;
+}
+
+static bool VerifyReadback(uint32_t address, const uint8_t* data, size_t size)
+{
+    for (size_t offset = 0U; offset < size; offset += READ_CHUNK)
+    {
+        const size_t len = ((size - offset) < READ_CHUNK) ? (size - offset) : READ_CHUNK;
+
+        if ((0U != w25qxx_read(&f_impl.w25q128, address + offset, (uint8_t*)f_readBuf, len)) ||
+            (0 != memcmp(f_readBuf, &data[offset], len)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool VerifyCrc(uint32_t address, const uint8_t* data, size_t size)
+{
+    CrcReset();
+    const uint32_t expected = CrcFeed(data, size);
+
+    CrcReset();
+    uint32_t actual = 0U;
+
+    for (size_t offset = 0U; offset < size; offset += READ_CHUNK)
+    {
+        const size_t len = ((size - offset) < READ_CHUNK) ? (size - offset) : READ_CHUNK;
+
+        if (0U != w25qxx_read(&f_impl.w25q128, address + offset, (uint8_t*)f_readBuf, len))
+        {
+            return false;
+        }
+
+        actual = CrcFeed((const uint8_t*)f_readBuf, len);
+    }
+
+    return actual == expected;
+}
+
 /*----------------------------------------------------------------------------*/
 /* PUBLIC FUNCTION DEFINITIONS                                                */
 /*----------------------------------------------------------------------------*/
@@ -208,4 +609,182 @@ w25qxx_handle_t* W25Q128_Init(SPI_HandleTypeDef* hspi, GPIO_TypeDef* csPort, uin
     return &f_impl.w25q128;
 }
 
+bool W25Q128_EraseFlash(uint32_t address, size_t size)
+{
+    if (((address % SECTOR_SIZE) != 0U) || ((size % SECTOR_SIZE) != 0U))
+    {
+        return false;
+    }
+
+    const uint32_t end = address + (uint32_t)size;
+    uint32_t addr = address;
+
+    while (addr < end)
+    {
+        bool ok;
+
+        if (KnownBlank(addr, SECTOR_SIZE))
+        {
+            addr += SECTOR_SIZE;
+            continue;
+        }
+
+        if (((addr % BLOCK_64K_SIZE) == 0U) && ((end - addr) >= BLOCK_64K_SIZE))
+        {
+            ok = Erase64k(addr);
+            addr += BLOCK_64K_SIZE;
+        }
+        else
+        {
+            ok = SectorBlank(addr) || EraseCommand(w25qxx_sector_erase_4k, addr, SECTOR_SIZE);
+            addr += SECTOR_SIZE;
+        }
+
+        if (!ok)
+        {
+            return false;
+        }
+    }
+
+    /* Extend the known blank range if the erased range joins it */
+    if ((address <= f_impl.blankEnd) && (end >= f_impl.blankBegin) && (f_impl.blankEnd > f_impl.blankBegin))
+    {
+        f_impl.blankBegin = (address < f_impl.blankBegin) ? address : f_impl.blankBegin;
+        f_impl.blankEnd = (end > f_impl.blankEnd) ? end : f_impl.blankEnd;
+    }
+    else
+    {
+        f_impl.blankBegin = address;
+        f_impl.blankEnd = end;
+    }
+
+    return true;
+}
+
+bool W25Q128_WriteFlash(uint32_t address, const uint8_t* data, size_t size)
+{
+    size_t offset = 0U;
+
+    /* One page program per page, only the first and last can be partial */
+    while (offset < size)
+    {
+        const uint32_t addr = address + offset;
+        const size_t pageLeft = PAGE_SIZE - (addr % PAGE_SIZE);
+        const size_t len = ((size - offset) < pageLeft) ? (size - offset) : pageLeft;
+
+        f_impl.programming = true;
+        const uint8_t res = w25qxx_page_program(&f_impl.w25q128, addr, (uint8_t*)&data[offset], (uint16_t)len);
+        f_impl.programming = false;
+
+        if (0U != res)
+        {
+            return false;
+        }
+
+        offset += len;
+    }
+
+    switch (f_verifyPolicy)
+    {
+    case W25Q_VERIFY_READBACK:
+        return VerifyReadback(address, data, size);
+    case W25Q_VERIFY_CRC:
+        return VerifyCrc(address, data, size);
+    case W25Q_VERIFY_STATUS:
+    default:
+        return true;
+    }
+}
+
+void W25Q128_SetVerifyPolicy(W25qVerifyPolicy_t policy)
+{
+    f_verifyPolicy = policy;
+}
+
+void W25Q128_SetEraseHook(W25qEraseHook_t hook)
+{
+    f_impl.eraseHook = hook;
+}
+
+bool W25Q128_Suspend(void)
+{
+    uint8_t status = STATUS1_BUSY;
+
+    if (f_impl.suspended || !Command(CMD_SUSPEND))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0U; (i < SUSPEND_POLLS) && ((status & STATUS1_BUSY) != 0U); i++)
+    {
+        TIM6_Delay_us(SUSPEND_POLL_US);
+
+        if (!ReadStatus(CMD_READ_STATUS1, &status))
+        {
+            return false;
+        }
+    }
+
+    if ((status & STATUS1_BUSY) != 0U)
+    {
+        return false;
+    }
+
+    /* The erase may have completed before the suspend command */
+    f_impl.suspended = ReadStatus(CMD_READ_STATUS2, &status) && ((status & STATUS2_SUS) != 0U);
+    return true;
+}
+
+bool W25Q128_Resume(void)
+{
+    if (!f_impl.suspended)
+    {
+        return true;
+    }
+
+    f_impl.suspended = false;
+    return Command(CMD_RESUME);
+}
+
+bool W25Q128_Read(uint32_t address, uint8_t* data, size_t size)
+{
+    uint8_t cmd[FAST_READ_CMD_LEN] = {
+        CMD_FAST_READ,
+        (uint8_t)(address >> 16),
+        (uint8_t)(address >> 8),
+        (uint8_t)address,
+        0x00U, /* Dummy byte */
+    };
+
+    return 0U == W25QXX_INT_SpiWriteRead(0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, cmd, sizeof(cmd), data, size, 1U);
+}
+
+bool W25Q128_WaitReady(uint32_t timeoutMs)
+{
+    const TickType_t start = xTaskGetTickCount();
+    uint8_t cmd = CMD_READ_STATUS1;
+    uint8_t status = STATUS1_BUSY;
+
+    for (;;)
+    {
+        if (0U != W25QXX_INT_SpiWriteRead(0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, &cmd, 1U, &status, 1U, 1U))
+        {
+            return false;
+        }
+
+        if ((status & STATUS1_BUSY) == 0U)
+        {
+            return true;
+        }
+
+        if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeoutMs))
+        {
+            return false;
+        }
+
+        TIM6_Delay_us(PROGRAM_POLL_US);
+        taskYIELD();
+    }
+}
+
 /* EoF w25qxx_init.c */
@@ -41,11 +41,19 @@ extern "C" {
 #include "config.h"
 #include "keys.h"
 #include "fragmentstore/fragmentstore.h"
+#include "digest_table.h"
 
 /*----------------------------------------------------------------------------*/
 /* PUBLIC TYPE DEFINITIONS                                                    */
 /*----------------------------------------------------------------------------*/
 
+typedef enum
+{
+    APP_IMAGE_ACTIVE = 0,   /* Image at APP_METADATA_ADDRESS */
+    APP_IMAGE_INACTIVE,     /* Image staged in the inactive bank (ENABLE_DUAL_BANK) */
+    APP_IMAGE_COUNT
+} AppImage_t;
+
 /*----------------------------------------------------------------------------*/
 /* PUBLIC MACRO DEFINITIONS                                                   */
 /*----------------------------------------------------------------------------*/
@@ -58,6 +66,46 @@ extern "C" {
 /* PUBLIC FUNCTION DECLARATIONS                                               */
 /*----------------------------------------------------------------------------*/
 
+extern bool APP_STATUS_VerifyImage(AppImage_t image, const KeyContainer_t* keys);
+
+extern const Metadata_t* APP_STATUS_GetImageMetadata(AppImage_t image);
+
+extern bool APP_STATUS_ImageVerifyResult(AppImage_t image);
+
+/** Check if a digest table belongs to the image described by metadata
+ * 
+ * @param metadata Image metadata
+ * @param table Digest table
+ * 
+ * @return true if the table layout matches the image
+ */
+extern bool APP_STATUS_DigestTableMatches(const Metadata_t* metadata, const DigestTable_t* table);
+
+/** Compare image segments against a trusted digest table. The image metadata
+ *  must have been verified with APP_STATUS_VerifyImage.
+ * 
+ * @param image Image to check
+ * @param table Trusted digest table of the image
+ * @param damaged Bit i is set if segment i differs. The segments holding the
+ *                table are set if the table copy in the image differs.
+ * 
+ * @return true if compared
+ */
+extern bool APP_STATUS_CheckSegments(AppImage_t image, const DigestTable_t* table, uint32_t* damaged);
+
+/** Re-check rewritten segments and mark the image valid if they match. All
+ *  other segments must have matched the same table in
+ *  APP_STATUS_CheckSegments, so only the rewritten part is hashed again
+ *  instead of verifying the whole image signature.
+ * 
+ * @param image Image to check
+ * @param table Trusted digest table of the image
+ * @param segments Bit i selects segment i
+ * 
+ * @return true if all selected segments match
+ */
+extern bool APP_STATUS_VerifySegments(AppImage_t image, const DigestTable_t* table, uint32_t segments);
+
 extern bool APP_STATUS_Verify(const KeyContainer_t* keys);
 
 extern const Metadata_t* APP_STATUS_GetMetadata(void);
@@ -68,8 +116,21 @@ extern bool APP_STATUS_LastMetadataVerifyResult(void);
 
 extern void APP_STATUS_PrintMetadata(const Metadata_t* metadata);
 
+/** Verify the rescue image on first use. The result is cached for the rest
+ *  of the boot and, when valid, over resets until power loss. A cached
+ *  result is reused only while the CRC32 of the image still matches.
+ * 
+ * @param keys Public keys
+ * 
+ * @return true if the rescue image is valid
+ */
 extern bool RESCUE_STATUS_Verify(const KeyContainer_t* keys);
 
+/** Drop the cached rescue verification result before rewriting the rescue
+ *  partition
+ */
+extern void RESCUE_STATUS_Invalidate(void);
+
 extern const Metadata_t* RESCUE_STATUS_GetMetadata(void);
 
 extern bool RESCUE_STATUS_LastVerifyResult(void);
@@ -0,0 +1,93 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * bank.h
+ *
+ * @brief STM32F439 dual bank boot selection
+*/
+
+#ifndef BANK_H_
+#define BANK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define BANK_1 (1U)
+#define BANK_2 (2U)
+
+#define BANK_SECTORS_PER_BANK (12U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Get the physical flash bank mapped at 0x08000000
+ * 
+ * @return BANK_1 or BANK_2
+ */
+extern uint32_t BANK_GetActiveBank(void);
+
+/** Translate a sector number of the memory map into the physical sector
+ *  number used by the flash controller. The two differ when bank 2 is mapped
+ *  at 0x08000000.
+ * 
+ * @param sector Sector number by address, FLASH_SECTOR_0 at 0x08000000
+ * 
+ * @return Physical sector number
+ */
+extern uint32_t BANK_PhysicalSector(uint32_t sector);
+
+/** Copy the running bootloader into the inactive bank if it differs
+ * 
+ * @return true if the inactive bank contains the running bootloader
+ */
+extern bool BANK_SyncBootloader(void);
+
+/** Select the inactive bank for the next boot and reset. The caller must have
+ *  verified the image in the inactive bank.
+ * 
+ * @return false if the option bytes could not be programmed. Does not return
+ *         on success.
+ */
+extern bool BANK_ActivateInactive(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF bank.h */
+
+#endif /* BANK_H_ */
@@ -54,9 +54,29 @@ extern "C" {
  */
 #define ENABLE_INSTALL_TRYOUT
 
+/** Defined:    Enable dual bank A/B mode. Images are installed into the inactive
+ *              flash bank and activated by toggling the BFB2 option bit. The
+ *              previous image stays intact in the other bank for rollback.
+ * 
+ *  Undefined:  Single image mode. Images are installed over the running bank.
+ */
+/* #define ENABLE_DUAL_BANK */
+
+#if defined(ENABLE_DUAL_BANK) && defined(ENABLE_RESCUE_PARTITION)
+#error "Dual bank mode uses the rescue partition area for the inactive bank"
+#endif
+
+#define BOOTLOADER_ADDRESS          (0x08000000U)
 #define APP_METADATA_ADDRESS        (0x08010000U)
 #define FIRST_FLASH_ADDRESS         (APP_METADATA_ADDRESS + sizeof(Metadata_t))
+
+#ifdef ENABLE_DUAL_BANK
+// Active bank is always mapped at 0x08000000, inactive bank follows it
+#define LAST_FLASH_ADDRESS          (0x08100000U)
+#define BANK_INACTIVE_OFFSET        (0x00100000U)
+#else
 #define LAST_FLASH_ADDRESS          (0x08200000U)
+#endif
 
 #ifdef ENABLE_RESCUE_PARTITION
 // Rescue partition enabled address
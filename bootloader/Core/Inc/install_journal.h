@@ -0,0 +1,140 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * install_journal.h
+ *
+ * @brief Append-only install progress journal for resuming interrupted installs
+*/
+
+#ifndef INSTALL_JOURNAL_H_
+#define INSTALL_JOURNAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "fragmentstore/fragmentstore.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+/** One journal entry. Entries are 32 bytes so that a page program never
+ *  splits one, and each carries its own CRC to detect torn writes.
+ */
+typedef struct
+{
+    uint32_t type;          /* JOURNAL_RECORD_* */
+    uint32_t sector;        /* Internal flash sector index */
+    uint32_t nextFragment;  /* First fragment not completely programmed */
+    uint32_t contentCrc;    /* BEGIN: target metadata CRC, SECTOR: sector CRC */
+    uint32_t reserved[3];
+    uint32_t recordCrc;     /* CRC32 over all preceding fields */
+} JournalRecord_t;
+
+typedef struct
+{
+    const MemoryConfig_t*   mem;            /* Journal memory area */
+    bool                    active;         /* A BEGIN record exists */
+    uint32_t                installId;      /* CRC32 of the journaled target metadata */
+    uint32_t                writeOffset;    /* Offset of the next free record */
+} InstallJournal_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define JOURNAL_RECORD_BEGIN    (0x4A424547U)
+#define JOURNAL_RECORD_SECTOR   (0x4A534543U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Initialize journal handle on a memory area
+ * 
+ * @param journal Journal handle
+ * @param mem Memory area reserved for the journal. Must be at least one sector
+ * 
+ * @return true if initialized
+ */
+extern bool JOURNAL_InitStruct(InstallJournal_t* journal, const MemoryConfig_t* mem);
+
+/** Start or continue journaling an install of target metadata. An existing
+ *  journal of the same target is kept, any other journal is erased.
+ * 
+ * @param journal Journal handle
+ * @param target Metadata of the image being installed
+ * 
+ * @return true if the journal is ready for records
+ */
+extern bool JOURNAL_Begin(InstallJournal_t* journal, const Metadata_t* target);
+
+/** Find the latest completion record of an internal flash sector
+ * 
+ * @param journal Journal handle
+ * @param sector Internal flash sector index
+ * @param out Record output
+ * 
+ * @return true if the sector has been recorded complete for the active install
+ */
+extern bool JOURNAL_FindSector(InstallJournal_t* journal, uint32_t sector, JournalRecord_t* out);
+
+/** Append a sector completion record
+ * 
+ * @param journal Journal handle
+ * @param sector Internal flash sector index
+ * @param nextFragment First fragment index not completely programmed
+ * @param contentCrc CRC32 of the programmed sector content
+ * 
+ * @return true if written
+ */
+extern bool JOURNAL_MarkSector(
+    InstallJournal_t* journal,
+    uint32_t sector,
+    uint32_t nextFragment,
+    uint32_t contentCrc
+);
+
+/** Erase the journal after a completed install
+ * 
+ * @param journal Journal handle
+ * 
+ * @return true if erased
+ */
+extern bool JOURNAL_Clear(InstallJournal_t* journal);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF install_journal.h */
+
+#endif /* INSTALL_JOURNAL_H_ */
@@ -68,6 +68,13 @@ extern bool INSTALLER_TryRepair(void);
 
 extern bool INSTALLER_TryInstallRescueApp(const Metadata_t** out);
 
+/** Boot the image staged in the inactive bank (ENABLE_DUAL_BANK). Verifies the
+ *  image and resets on success.
+ * 
+ * @return false if activation failed
+ */
+extern bool INSTALLER_ActivateInactiveBank(void);
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
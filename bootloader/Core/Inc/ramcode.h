@@ -0,0 +1,67 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * ramcode.h
+ *
+ * @brief Placement of verification code and scratch state. With
+ *        BOOTLOADER_CRYPTO_IN_RAM the ed25519 and SHA-512 library code runs
+ *        from SRAM and CCM_SCRATCH state lives in CCM RAM, so hashing does
+ *        not wait for flash that is busy with an erase or program operation.
+*/
+
+#ifndef RAMCODE_H_
+#define RAMCODE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+/* Static scratch state. Not zeroed at startup, initialize before use. CCM RAM
+   is not reachable by DMA, so never use it for transfer buffers. */
+#ifdef BOOTLOADER_CRYPTO_IN_RAM
+#define CCM_SCRATCH __attribute__((section(".ccm_scratch")))
+#else
+#define CCM_SCRATCH
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Copy the crypto code to SRAM. Call before any signature or hash
+ *  computation. Does nothing without BOOTLOADER_CRYPTO_IN_RAM.
+ */
+extern void RAMCODE_Init(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF ramcode.h */
+
+#endif /* RAMCODE_H_ */
@@ -41,6 +41,8 @@ extern "C" {
 #include "driver_w25qxx.h"
 #include "stm32f4xx_hal.h"
 
+#include <stdbool.h>
+
 /*----------------------------------------------------------------------------*/
 /* PUBLIC FUNCTION DECLARATIONS                                               */
 /*----------------------------------------------------------------------------*/
@@ -55,6 +57,15 @@ extern "C" {
  */
 extern w25qxx_handle_t* W25Q128_Init(SPI_HandleTypeDef* hspi, GPIO_TypeDef* csPort, uint16_t csPin);
 
+/** Enable sequential read-ahead. After each read the following bytes of the
+ *  same length are fetched with DMA while the caller processes the data, and
+ *  a read of them completes from the buffer. Any other access cancels the
+ *  read-ahead. Disabling waits for nothing, an ongoing transfer is aborted.
+ * 
+ * @param enable true to enable
+ */
+extern void W25Q128_SetReadAhead(bool enable);
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
@@ -33,8 +33,10 @@
 
 #include "app_status.h"
 #include "ed25519.h"
+#include "sha512.h"
 #include "crc/crc32.h"
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
@@ -43,18 +45,33 @@
 /* PRIVATE TYPE DEFINITIONS                                                   */
 /*----------------------------------------------------------------------------*/
 
+/* Verification result of the rescue image, kept over resets */
+typedef struct
+{
+    uint32_t magic;         /* RESCUE_CACHE_MAGIC */
+    uint32_t metadataCrc;   /* CRC32 of the verified rescue metadata */
+    uint32_t imageCrc;      /* CRC32 of the verified rescue image */
+    uint32_t crc;           /* CRC32 of the preceding fields */
+} RescueCache_t;
+
 /*----------------------------------------------------------------------------*/
 /* MACRO DEFINITIONS                                                          */
 /*----------------------------------------------------------------------------*/
 
+#define RESCUE_CACHE_MAGIC (0x52435643U)
+
 /*----------------------------------------------------------------------------*/
 /* VARIABLE DEFINITIONS                                                       */
 /*----------------------------------------------------------------------------*/
 
-static bool f_metadataOk = false;
-static bool f_valid = false;
+static bool f_metadataOk[APP_IMAGE_COUNT] = {false};
+static bool f_valid[APP_IMAGE_COUNT] = {false};
 
 #ifdef ENABLE_RESCUE_PARTITION
+/* Outside of the application RAM, survives resets but not power loss */
+static RescueCache_t f_rescueCache __attribute__((section(".boot_cache")));
+
+static bool f_rescueChecked = false;
 static bool f_rescueValid = false;
 #endif
 
@@ -104,43 +121,176 @@ static bool IsMetadataValid(const Metadata_t* metadata, const uint8_t* publicKey
     return true;
 }
 
-static bool IsApplicationValid(const Metadata_t* metadata, const uint8_t* publicKey)
+#ifdef ENABLE_RESCUE_PARTITION
+static uint32_t RescueCacheCrc(void)
+{
+    return CRC32_Calculate((const uint8_t*)&f_rescueCache, offsetof(RescueCache_t, crc));
+}
+
+/** CRC32 of the rescue image bytes, far cheaper than the signature check */
+static uint32_t RescueImageCrc(const Metadata_t* metadata)
 {
+    return CRC32_Calculate((const uint8_t*)metadata->startAddress, metadata->firmwareSize);
+}
+
+static bool RescueCacheValid(const Metadata_t* metadata, uint32_t metadataCrc)
+{
+    /* The metadata was verified when the entry was stored, so its range is
+       safe to read before the image CRC is compared */
+    return (f_rescueCache.magic == RESCUE_CACHE_MAGIC) &&
+           (f_rescueCache.metadataCrc == metadataCrc) &&
+           (f_rescueCache.crc == RescueCacheCrc()) &&
+           (f_rescueCache.imageCrc == RescueImageCrc(metadata));
+}
+
+static void RescueCacheStore(const Metadata_t* metadata, uint32_t metadataCrc)
+{
+    f_rescueCache.magic = RESCUE_CACHE_MAGIC;
+    f_rescueCache.metadataCrc = metadataCrc;
+    f_rescueCache.imageCrc = RescueImageCrc(metadata);
+    f_rescueCache.crc = RescueCacheCrc();
+}
+#endif
+
+/** Image location offset from its linked address */
+static uint32_t ImageOffset(AppImage_t image)
+{
+#ifdef ENABLE_DUAL_BANK
+    return (image == APP_IMAGE_INACTIVE) ? BANK_INACTIVE_OFFSET : 0U;
+#else
+    (void)image;
+    return 0U;
+#endif
+}
+
+static bool IsVectorTableValid(uint32_t start)
+{
+    uint32_t sp = *(volatile uint32_t*)start;
+    uint32_t pc = *(volatile uint32_t*)(start + 4);
+
+    const bool stackPointerValid = sp == 0x20030000U;
+    const bool programCounterValid = InRange(pc, FIRST_FLASH_ADDRESS, LAST_FLASH_ADDRESS);
+
+    return stackPointerValid && programCounterValid;
+}
+
+static bool IsApplicationValid(const Metadata_t* metadata, const uint8_t* publicKey, uint32_t offset)
+{
+    const uint32_t start = metadata->startAddress + offset;
+
     const uint8_t* sig = metadata->firmwareSignature;
-    const uint8_t* msg = (const uint8_t*)(metadata->startAddress);
+    const uint8_t* msg = (const uint8_t*)(start);
     const size_t   len = metadata->firmwareSize;
 
     if (ed25519_verify(sig, msg, len, publicKey))
     {
-        uint32_t sp = *(volatile uint32_t*)metadata->startAddress;
-        uint32_t pc = *(volatile uint32_t*)(metadata->startAddress + 4);
+        return IsVectorTableValid(start);
+    }
 
-        const bool stackPointerValid = sp == 0x20030000U;
-        const bool programCounterValid = InRange(pc, FIRST_FLASH_ADDRESS, LAST_FLASH_ADDRESS);
+    return false;
+}
 
-        return stackPointerValid && programCounterValid;
+/** Hash the selected segments of an image and compare them to the table
+ * 
+ * @param image Image to check
+ * @param table Trusted digest table of the image
+ * @param segments Bit i selects segment i
+ * @param damaged Bit i is set if selected segment i differs
+ * 
+ * @return true if compared
+ */
+static bool CompareSegments(AppImage_t image, const DigestTable_t* table, uint32_t segments, uint32_t* damaged)
+{
+    if ((image >= APP_IMAGE_COUNT) || !f_metadataOk[image])
+    {
+        return false;
     }
 
-    return false;
+    const Metadata_t* metadata = APP_STATUS_GetImageMetadata(image);
+
+    if (!APP_STATUS_DigestTableMatches(metadata, table))
+    {
+        printf("Digest table does not match the image\r\n");
+        return false;
+    }
+
+    const uint32_t offset = ImageOffset(image);
+    const uint32_t tableAddress = DIGEST_TableAddress(metadata->startAddress, metadata->firmwareSize);
+    uint8_t hash[64];
+
+    *damaged = 0U;
+
+    for (uint32_t i = 0U; i < table->segmentCount; i++)
+    {
+        if ((segments & (1UL << i)) == 0U)
+        {
+            continue;
+        }
+
+        uint32_t start = table->baseAddress + (i * table->segmentSize);
+        uint32_t end = start + table->segmentSize;
+
+        start = (start < table->imageStart) ? table->imageStart : start;
+        end = (end > tableAddress) ? tableAddress : end;
+
+        if (end <= start)
+        {
+            continue;
+        }
+
+        (void)sha512((const unsigned char*)(start + offset), end - start, hash);
+
+        if (0 != memcmp(hash, table->digest[i], DIGEST_SIZE))
+        {
+            *damaged |= (1UL << i);
+        }
+    }
+
+    /* The table itself is not digested, compare it directly */
+    if (0 != memcmp((const void*)(tableAddress + offset), table, sizeof(DigestTable_t)))
+    {
+        const uint32_t first = (tableAddress - table->baseAddress) / table->segmentSize;
+        const uint32_t last = (tableAddress + sizeof(DigestTable_t) - 1U - table->baseAddress) / table->segmentSize;
+
+        for (uint32_t i = first; (i <= last) && (i < DIGEST_TABLE_MAX_SEGMENTS); i++)
+        {
+            *damaged |= (segments & (1UL << i));
+        }
+    }
+
+    return true;
 }
 
 /*----------------------------------------------------------------------------*/
 /* PUBLIC FUNCTION DEFINITIONS                                                */
 /*----------------------------------------------------------------------------*/
 
-bool APP_STATUS_Verify(const KeyContainer_t* keys)
+bool APP_STATUS_VerifyImage(AppImage_t image, const KeyContainer_t* keys)
 {
-    f_metadataOk = false;
-    f_valid = false;
-    const Metadata_t* metadata = (const Metadata_t*)(APP_METADATA_ADDRESS);
+    if (image >= APP_IMAGE_COUNT)
+    {
+        return false;
+    }
+
+    f_metadataOk[image] = false;
+    f_valid[image] = false;
+
+#ifndef ENABLE_DUAL_BANK
+    if (image == APP_IMAGE_INACTIVE)
+    {
+        return false;
+    }
+#endif
+
+    const Metadata_t* metadata = APP_STATUS_GetImageMetadata(image);
 
     if (IsMetadataValid(metadata, keys->metadataPubKey))
     {
-        f_metadataOk = true;
+        f_metadataOk[image] = true;
 
-        if (IsApplicationValid(metadata, keys->firmwarePubKey))
+        if (IsApplicationValid(metadata, keys->firmwarePubKey, ImageOffset(image)))
         {
-            f_valid = true;
+            f_valid[image] = true;
             return true;
         }
     }
@@ -148,19 +298,72 @@ bool APP_STATUS_Verify(const KeyContainer_t* keys)
     return false;
 }
 
+const Metadata_t* APP_STATUS_GetImageMetadata(AppImage_t image)
+{
+    return (const Metadata_t*)(APP_METADATA_ADDRESS + ImageOffset(image));
+}
+
+bool APP_STATUS_ImageVerifyResult(AppImage_t image)
+{
+    return (image < APP_IMAGE_COUNT) && f_valid[image];
+}
+
+bool APP_STATUS_DigestTableMatches(const Metadata_t* metadata, const DigestTable_t* table)
+{
+    if ((table->magic != DIGEST_TABLE_MAGIC) ||
+        (table->segmentSize != DIGEST_SEGMENT_SIZE) ||
+        (table->segmentCount > DIGEST_TABLE_MAX_SEGMENTS) ||
+        (table->baseAddress != APP_METADATA_ADDRESS) ||
+        (table->imageStart != metadata->startAddress) ||
+        (metadata->firmwareSize < sizeof(DigestTable_t)))
+    {
+        return false;
+    }
+
+    const uint32_t tableAddress = DIGEST_TableAddress(metadata->startAddress, metadata->firmwareSize);
+    const uint32_t covered = table->baseAddress + (table->segmentCount * table->segmentSize);
+
+    return covered >= tableAddress;
+}
+
+bool APP_STATUS_CheckSegments(AppImage_t image, const DigestTable_t* table, uint32_t* damaged)
+{
+    return CompareSegments(image, table, UINT32_MAX, damaged);
+}
+
+bool APP_STATUS_VerifySegments(AppImage_t image, const DigestTable_t* table, uint32_t segments)
+{
+    uint32_t damaged = 0U;
+
+    if (!CompareSegments(image, table, segments, &damaged) || (damaged != 0U))
+    {
+        return false;
+    }
+
+    const Metadata_t* metadata = APP_STATUS_GetImageMetadata(image);
+
+    f_valid[image] = IsVectorTableValid(metadata->startAddress + ImageOffset(image));
+    return f_valid[image];
+}
+
+bool APP_STATUS_Verify(const KeyContainer_t* keys)
+{
+    return APP_STATUS_VerifyImage(APP_IMAGE_ACTIVE, keys);
+}
+
 const Metadata_t* APP_STATUS_GetMetadata(void)
 {
-    return (const Metadata_t*)APP_METADATA_ADDRESS;
+    return APP_STATUS_GetImageMetadata(APP_IMAGE_ACTIVE);
 }
 
 bool APP_STATUS_LastVerifyResult(void)
 {
-    return f_valid;
+    return f_valid[APP_IMAGE_ACTIVE];
 }
 
 bool APP_STATUS_LastMetadataVerifyResult(void)
 {
-    return f_metadataOk;
+    return f_metadataOk[APP_IMAGE_ACTIVE];
 }
 
 void APP_STATUS_PrintMetadata(const Metadata_t* metadata)
@@ -192,21 +395,37 @@ void APP_STATUS_PrintMetadata(const Metadata_t* metadata)
 bool RESCUE_STATUS_Verify(const KeyContainer_t* keys)
 {
 #ifdef ENABLE_RESCUE_PARTITION
+    if (f_rescueChecked)
+    {
+        return f_rescueValid;
+    }
+
     const Metadata_t* metadata = (const Metadata_t*)RESCUE_METADATA_ADDRESS;
+    const uint32_t metadataCrc = CRC32_Calculate((const uint8_t*)metadata, sizeof(Metadata_t));
 
-    if (IsMetadataValid(metadata, keys->metadataPubKey))
+    /* The bootloader invalidates the cache before it writes the rescue
+       partition. The image CRC catches content that changed otherwise. */
+    if (RescueCacheValid(metadata, metadataCrc))
     {
-        if (IsApplicationValid(metadata, keys->firmwarePubKey))
+        printf("Rescue verification result from cache\r\n");
+        f_rescueValid = true;
+    }
+    else
+    {
+        f_rescueValid = IsMetadataValid(metadata, keys->metadataPubKey) &&
+                        IsApplicationValid(metadata, keys->firmwarePubKey, 0U);
+
+        if (f_rescueValid)
         {
-            f_rescueValid = true;
-            return true;
+            RescueCacheStore(metadata, metadataCrc);
         }
     }
 
-    return false;
+    f_rescueChecked = true;
+    return f_rescueValid;
 #else
     (void)keys;
-    return f_valid;
+    return f_valid[APP_IMAGE_ACTIVE];
 #endif
 }
 
@@ -215,12 +434,21 @@ const Metadata_t* RESCUE_STATUS_GetMetadata(void)
     return (const Metadata_t*)RESCUE_METADATA_ADDRESS;
 }
 
+void RESCUE_STATUS_Invalidate(void)
+{
+#ifdef ENABLE_RESCUE_PARTITION
+    memset(&f_rescueCache, 0, sizeof(f_rescueCache));
+    f_rescueChecked = false;
+    f_rescueValid = false;
+#endif
+}
+
 bool RESCUE_STATUS_LastVerifyResult(void)
 {
 #ifdef ENABLE_RESCUE_PARTITION
     return f_rescueValid;
 #else
-    return f_valid;
+    return f_valid[APP_IMAGE_ACTIVE];
 #endif
 }
 
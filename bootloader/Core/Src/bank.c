@@ -0,0 +1,191 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * bank.c
+ *
+ * @brief STM32F439 dual bank boot selection. With BFB2 set the system memory
+ *        boots bank 2 and maps it at 0x08000000, so the running code always
+ *        sees the active bank at 0x08000000 and the inactive one at 0x08100000.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "bank.h"
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "stm32f4xx_hal.h"
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define BANK_SIZE                   (0x00100000U)
+#define BOOTLOADER_SIZE             (APP_METADATA_ADDRESS - BOOTLOADER_ADDRESS)
+#define INACTIVE_BOOTLOADER_ADDRESS (BOOTLOADER_ADDRESS + BANK_SIZE)
+
+/* Bootloader occupies sectors 0-3 of a bank */
+#define BOOTLOADER_SECTOR_COUNT     (4U)
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static bool InactiveBootloaderEqual(void)
+{
+    return 0 == memcmp(
+        (const void*)INACTIVE_BOOTLOADER_ADDRESS,
+        (const void*)BOOTLOADER_ADDRESS,
+        BOOTLOADER_SIZE
+    );
+}
+
+static bool EraseInactiveBootloader(void)
+{
+    FLASH_EraseInitTypeDef eraseInitStruct;
+    uint32_t error = 0;
+
+    eraseInitStruct.TypeErase    = FLASH_TYPEERASE_SECTORS;
+    eraseInitStruct.VoltageRange = FLASH_VOLTAGE_RANGE_3; // 2.7V to 3.6V
+    eraseInitStruct.Sector       = BANK_PhysicalSector(FLASH_SECTOR_12);
+    eraseInitStruct.NbSectors    = BOOTLOADER_SECTOR_COUNT;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&eraseInitStruct, &error);
+    HAL_FLASH_Lock();
+
+    if (status != HAL_OK)
+    {
+        printf("Bootloader erase failed error code %lu\r\n", (unsigned long)error);
+        return false;
+    }
+
+    return true;
+}
+
+static bool ProgramInactiveBootloader(void)
+{
+    const uint32_t* src = (const uint32_t*)BOOTLOADER_ADDRESS;
+
+    HAL_FLASH_Unlock();
+
+    for (uint32_t offset = 0U; offset < BOOTLOADER_SIZE; offset += 4U)
+    {
+        HAL_StatusTypeDef status = HAL_FLASH_Program(
+            FLASH_TYPEPROGRAM_WORD,
+            INACTIVE_BOOTLOADER_ADDRESS + offset,
+            src[offset / 4U]
+        );
+
+        if (status != HAL_OK)
+        {
+            printf("HAL_FLASH_Program failed with status %i\r\n", (int)status);
+            HAL_FLASH_Lock();
+            return false;
+        }
+    }
+
+    HAL_FLASH_Lock();
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+uint32_t BANK_GetActiveBank(void)
+{
+    return ((SYSCFG->MEMRMP & SYSCFG_MEMRMP_UFB_MODE) != 0U) ? BANK_2 : BANK_1;
+}
+
+uint32_t BANK_PhysicalSector(uint32_t sector)
+{
+    if (BANK_GetActiveBank() == BANK_1)
+    {
+        return sector;
+    }
+
+    return (sector < BANK_SECTORS_PER_BANK)
+        ? (sector + BANK_SECTORS_PER_BANK)
+        : (sector - BANK_SECTORS_PER_BANK);
+}
+
+bool BANK_SyncBootloader(void)
+{
+    if (InactiveBootloaderEqual())
+    {
+        return true;
+    }
+
+    printf("Copying bootloader to inactive bank\r\n");
+
+    if (!EraseInactiveBootloader() || !ProgramInactiveBootloader())
+    {
+        return false;
+    }
+
+    return InactiveBootloaderEqual();
+}
+
+bool BANK_ActivateInactive(void)
+{
+    FLASH_AdvOBProgramInitTypeDef obInit;
+    memset(&obInit, 0, sizeof(obInit));
+
+    /* BFB2 set boots bank 2, cleared boots bank 1 */
+    obInit.OptionType = OPTIONBYTE_BOOTCONFIG;
+    obInit.BootConfig = (BANK_GetActiveBank() == BANK_1)
+        ? OB_DUAL_BOOT_ENABLE
+        : OB_DUAL_BOOT_DISABLE;
+
+    HAL_FLASH_Unlock();
+    HAL_FLASH_OB_Unlock();
+
+    HAL_StatusTypeDef status = HAL_FLASHEx_AdvOBProgram(&obInit);
+
+    if (status == HAL_OK)
+    {
+        status = HAL_FLASH_OB_Launch();
+    }
+
+    HAL_FLASH_OB_Lock();
+    HAL_FLASH_Lock();
+
+    if (status != HAL_OK)
+    {
+        printf("Boot bank option programming failed with status %i\r\n", (int)status);
+        return false;
+    }
+
+    printf("Boot bank switched. Resetting...\r\n");
+    NVIC_SystemReset();
+
+    return false;
+}
+
+/* EoF bank.c */
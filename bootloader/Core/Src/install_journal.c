@@ -0,0 +1,257 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * install_journal.c
+ *
+ * @brief Append-only install progress journal. Records are only ever appended
+ *        to erased memory, so an interrupted write can at most corrupt the
+ *        record being written. Corrupted records are skipped on scan.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "install_journal.h"
+#include "crc/crc32.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define RECORD_SIZE (sizeof(JournalRecord_t))
+
+_Static_assert(RECORD_SIZE == 32U, "Journal record must be 32 bytes");
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static uint32_t RecordCrc(const JournalRecord_t* rec)
+{
+    return CRC32_Calculate((const uint8_t*)rec, offsetof(JournalRecord_t, recordCrc));
+}
+
+static bool RecordErased(const InstallJournal_t* journal, const JournalRecord_t* rec)
+{
+    const uint8_t* buf = (const uint8_t*)rec;
+    for (size_t i = 0; i < RECORD_SIZE; i++)
+    {
+        if (buf[i] != journal->mem->eraseValue)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ReadRecord(const InstallJournal_t* journal, uint32_t offset, JournalRecord_t* out)
+{
+    return journal->mem->Reader(journal->mem->baseAddress + offset, (uint8_t*)out, RECORD_SIZE);
+}
+
+static bool AppendRecord(InstallJournal_t* journal, JournalRecord_t* rec)
+{
+    if ((journal->writeOffset + RECORD_SIZE) > journal->mem->memorySize)
+    {
+        printf("Install journal full\r\n");
+        return false;
+    }
+
+    memset(rec->reserved, 0, sizeof(rec->reserved));
+    rec->recordCrc = RecordCrc(rec);
+
+    if (!journal->mem->Writer(journal->mem->baseAddress + journal->writeOffset, (const uint8_t*)rec, RECORD_SIZE))
+    {
+        return false;
+    }
+
+    journal->writeOffset += RECORD_SIZE;
+    return true;
+}
+
+/** Scan the journal for the BEGIN record and the first free slot */
+static bool Scan(InstallJournal_t* journal)
+{
+    journal->active = false;
+    journal->installId = 0U;
+    journal->writeOffset = journal->mem->memorySize;
+
+    JournalRecord_t rec;
+
+    for (uint32_t offset = 0U; (offset + RECORD_SIZE) <= journal->mem->memorySize; offset += RECORD_SIZE)
+    {
+        if (!ReadRecord(journal, offset, &rec))
+        {
+            return false;
+        }
+
+        if (RecordErased(journal, &rec))
+        {
+            journal->writeOffset = offset;
+            break;
+        }
+
+        if ((rec.recordCrc == RecordCrc(&rec)) &&
+            (rec.type == JOURNAL_RECORD_BEGIN) &&
+            !journal->active)
+        {
+            journal->active = true;
+            journal->installId = rec.contentCrc;
+        }
+    }
+
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+bool JOURNAL_InitStruct(InstallJournal_t* journal, const MemoryConfig_t* mem)
+{
+    if ((journal == NULL) || (mem == NULL) || (mem->memorySize < mem->sectorSize))
+    {
+        return false;
+    }
+
+    journal->mem = mem;
+    return Scan(journal);
+}
+
+bool JOURNAL_Begin(InstallJournal_t* journal, const Metadata_t* target)
+{
+    if (journal->mem == NULL)
+    {
+        return false;
+    }
+
+    const uint32_t id = CRC32_Calculate((const uint8_t*)target, sizeof(Metadata_t));
+
+    if (journal->active && (journal->installId == id))
+    {
+        printf("Continuing journaled install %08lX\r\n", id);
+        return true;
+    }
+
+    if (!JOURNAL_Clear(journal))
+    {
+        return false;
+    }
+
+    JournalRecord_t rec = {
+        .type = JOURNAL_RECORD_BEGIN,
+        .sector = 0U,
+        .nextFragment = 0U,
+        .contentCrc = id,
+    };
+
+    if (!AppendRecord(journal, &rec))
+    {
+        return false;
+    }
+
+    journal->active = true;
+    journal->installId = id;
+    return true;
+}
+
+bool JOURNAL_FindSector(InstallJournal_t* journal, uint32_t sector, JournalRecord_t* out)
+{
+    if (!journal->active)
+    {
+        return false;
+    }
+
+    bool found = false;
+    JournalRecord_t rec;
+
+    for (uint32_t offset = 0U; offset < journal->writeOffset; offset += RECORD_SIZE)
+    {
+        if (!ReadRecord(journal, offset, &rec))
+        {
+            return false;
+        }
+
+        if ((rec.recordCrc == RecordCrc(&rec)) &&
+            (rec.type == JOURNAL_RECORD_SECTOR) &&
+            (rec.sector == sector))
+        {
+            /* Keep the latest record of the sector */
+            *out = rec;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+bool JOURNAL_MarkSector(
+    InstallJournal_t* journal,
+    uint32_t sector,
+    uint32_t nextFragment,
+    uint32_t contentCrc)
+{
+    if (!journal->active)
+    {
+        return false;
+    }
+
+    JournalRecord_t rec = {
+        .type = JOURNAL_RECORD_SECTOR,
+        .sector = sector,
+        .nextFragment = nextFragment,
+        .contentCrc = contentCrc,
+    };
+
+    return AppendRecord(journal, &rec);
+}
+
+bool JOURNAL_Clear(InstallJournal_t* journal)
+{
+    const MemoryConfig_t* mem = journal->mem;
+
+    for (uint32_t offset = 0U; offset < mem->memorySize; offset += mem->sectorSize)
+    {
+        if (!mem->Eraser(mem->baseAddress + offset, mem->sectorSize))
+        {
+            return false;
+        }
+    }
+
+    journal->active = false;
+    journal->installId = 0U;
+    journal->writeOffset = 0U;
+    return true;
+}
+
+/* EoF install_journal.c */
@@ -32,8 +32,14 @@
 /*----------------------------------------------------------------------------*/
 
 #include "app_status.h"
+#include "bank.h"
 #include "crc/crc32.h"
+#include "fragment_index.h"
+#include "partition_table.h"
 #include "installer.h"
+#include "install_journal.h"
+#include "ramcode.h"
+#include "w25qxx_init.h"
 #include "fragmentstore/default_app_types.h"
 #include "fragmentstore/command.h"
 #include "fragmentstore/fragmentstore.h"
@@ -54,6 +60,8 @@
 typedef struct
 {
     FragmentArea_t      fa;             /* Fragment area handle */
+    bool                metadataOk;     /* Valid metadata was read at init */
+    bool                checked;        /* Content verification has been run */
     bool                valid;          /* This slot contains a valid firmware */
     uint32_t            highestAddr;    /* Highest address of this firmware */
     size_t              lastFragIdx;    /* Index of the last fragment */
@@ -79,12 +87,6 @@ typedef struct
 #define MB (1024U * KB)
 
 #define W25Qxx_SECTOR_SIZE  (4U*KB)
-#define UPDATE_SLOT_SIZE    (2U*MB)
-
-#define SLOT_0_ADDRESS          (0x0U)
-#define SLOT_1_ADDRESS          (UPDATE_SLOT_SIZE)
-#define SLOT_2_ADDRESS          (2U * UPDATE_SLOT_SIZE)
-#define COMMAND_AREA_ADDRESS    (3U * UPDATE_SLOT_SIZE)
 
 #define REQUIRE_V(x) \
 if(!(x)) \
@@ -102,15 +104,27 @@ return false; \
 
 #define MIN(a,b) (((a) < (b)) ? (a) : (b))
 
+/* Offset of the install target from the linked image addresses */
+#ifdef ENABLE_DUAL_BANK
+#define INSTALL_OFFSET  BANK_INACTIVE_OFFSET
+#else
+#define INSTALL_OFFSET  (0U)
+#endif
+
 /*----------------------------------------------------------------------------*/
 /* VARIABLE DEFINITIONS                                                       */
 /*----------------------------------------------------------------------------*/
 
 static CommandArea_t        f_ca;
-static InstallSlot_t        f_slots[3];
+static InstallJournal_t     f_journal;
+static InstallSlot_t        f_slots[PARTITION_MAX_SLOTS];
+static MemoryConfig_t       f_slotConfs[PARTITION_MAX_SLOTS];
 static w25qxx_handle_t*     f_w25q128;
 static KeyContainer_t       f_keys;
 
+/* The APP_IMAGE_INACTIVE verify result is current */
+static bool                 f_inactiveVerified = false;
+
 static const Stm32FlashSector_t f_FLASH_SECTORS[FLASH_SECTOR_TOTAL] = {
     {0x08000000,  16U*KB, FLASH_SECTOR_0 },
     {0x08004000,  16U*KB, FLASH_SECTOR_1 },
@@ -201,16 +215,154 @@ bool ValidateMetadata(const Metadata_t* metadata)
 /* PRIVATE FUNCTION DEFINITIONS                                               */
 /*----------------------------------------------------------------------------*/
 
+/** Read a fragment of a slot. A fragment the update server recorded as a
+ *  reference is not in the fragment area, its index entry names the slot
+ *  holding the content. The address range and digest must match the entry.
+ *  The content is covered by the firmware signature check like any other.
+ * 
+ * @param slot Install slot with metadata read
+ * @param number Fragment number
+ * @param frag Output fragment
+ * @return FA_ReadFragment result
+ */
+static FA_ReturnCode_t ReadFragment(InstallSlot_t* slot, size_t number, Fragment_t* frag)
+{
+    FragmentIndexEntry_t entry;
+    const FA_ReturnCode_t res = FA_ReadFragment(&slot->fa, number, frag);
+
+    /* A reference leaves its place in the fragment area erased */
+    if ((res == FA_ERR_OK) ||
+        !FRAGMENT_INDEX_Lookup(
+            W25Qxx_INTERFACE_ReadFlash,
+            (uint32_t)(slot - f_slots),
+            slot->metadata.firmwareId,
+            (uint32_t)number,
+            &entry) ||
+        !FRAGMENT_INDEX_IsReference(&entry))
+    {
+        return res;
+    }
+
+    if ((entry.refSlot >= PARTITION_MAX_SLOTS) || !f_slots[entry.refSlot].metadataOk)
+    {
+        return FA_ERR_INVALID;
+    }
+
+    if ((FA_ReadFragment(&f_slots[entry.refSlot].fa, entry.refNumber, frag) != FA_ERR_OK) ||
+        (frag->startAddress != entry.startAddress) ||
+        (frag->size != entry.size) ||
+        (0 != memcmp(frag->sha512, entry.sha512, sizeof(entry.sha512))))
+    {
+        return FA_ERR_INVALID;
+    }
+
+    frag->firmwareId = entry.firmwareId;
+    frag->number = entry.number;
+    return FA_ERR_OK;
+}
+
+/** Add the fragment content of a slot to a signature verification
+ * 
+ * @param slot Slot with valid metadata
+ * @param ctx Initialized verification context
+ * @param lastIdx Index of the last fragment
+ * @return all fragments valid and contiguous
+ */
+static bool VerifyFragments(InstallSlot_t* slot, ed25519_multipart_t* ctx, size_t lastIdx)
+{
+    const Metadata_t* meta = &slot->metadata;
+    Fragment_t* frag = &slot->fragMem;
+
+    uint32_t nextStart = (meta->type == DEFAULT_APP_TYPE_RESCUE)
+        ? RESCUE_DATA_BEGIN
+        : FIRST_FLASH_ADDRESS;
+
+    for (size_t i = 0; i <= lastIdx; i++)
+    {
+        const FA_ReturnCode_t res = ReadFragment(slot, i, frag);
+        if (res != FA_ERR_OK)
+        {
+            printf("Fragment %u was not valid\r\n", i);
+            return false;
+        }
+
+        if (frag->startAddress != nextStart)
+        {
+            printf("Fragment %u: unexpected start address: %lX, expected %lX\r\n", i, frag->startAddress, nextStart);
+            return false;
+        }
+        else
+        {
+            nextStart += frag->size;
+        }
+
+        uint32_t verifyOffset = 0U;
+        size_t   verifyLen = frag->size;
+
+        if (frag->startAddress < meta->startAddress)
+        {
+            verifyOffset = meta->startAddress - frag->startAddress;
+        }
+
+        if (verifyOffset < verifyLen)
+        {
+            verifyLen -= verifyOffset;
+        }
+
+        if (verifyLen > 0U)
+        {
+            const int ed = ed25519_multipart_continue(ctx, &frag->content[verifyOffset], verifyLen);
+            if (ed != 1U)
+            {
+                printf("ed25519_multipart_continue failed\r\n");
+                return false;
+            }
+        }
+
+        const uint32_t fragEndAddr = frag->startAddress + frag->size;
+        if (fragEndAddr > slot->highestAddr)
+        {
+            slot->highestAddr = fragEndAddr;
+        }
+    }
+
+    return true;
+}
+
+/** Find the last fragment of a slot. The fragment index gives it with a few
+ *  entry reads, the fragment area is scanned only when the index is missing
+ *  or a fragment follows the indexed last one. Every fragment up to the last
+ *  one is verified afterwards, so the index does not need to be trusted.
+ * 
+ * @param slot Install slot with metadata read
+ * @param lastIdx Output index of the last fragment
+ * 
+ * @return Last fragment found
+ */
+static bool FindLastFragment(InstallSlot_t* slot, size_t* lastIdx)
+{
+    const uint32_t slotIndex = (uint32_t)(slot - f_slots);
+    uint32_t last = 0U;
+
+    if (FRAGMENT_INDEX_FindLast(W25Qxx_INTERFACE_ReadFlash, slotIndex, slot->metadata.firmwareId, &last) &&
+        (FA_ReadFragment(&slot->fa, last + 1U, &slot->fragMem) != FA_ERR_OK))
+    {
+        *lastIdx = last;
+        return true;
+    }
+
+    return FA_ERR_OK == FA_FindLastFragment(&slot->fa, &slot->fragMem, lastIdx);
+}
+
 static bool VerifySlotContent(InstallSlot_t* slot)
 {
     Metadata_t* meta = &slot->metadata;
-    Fragment_t* frag = &slot->fragMem;
 
     FA_ReturnCode_t res = FA_ReadMetadata(&slot->fa, meta);
 
     if (res == FA_ERR_OK)
     {
-        ed25519_multipart_t ctx;
+        static ed25519_multipart_t ctx CCM_SCRATCH;
         int ed = ed25519_multipart_init(
             &ctx, 
             meta->firmwareSignature, 
@@ -224,9 +376,7 @@ static bool VerifySlotContent(InstallSlot_t* slot)
         }
 
         size_t lastIdx = 0U;
-        res = FA_FindLastFragment(&slot->fa, frag, &lastIdx);
-
-        if (res != FA_ERR_OK)
+        if (!FindLastFragment(slot, &lastIdx))
         {
             printf("FA_FindLastFragment failed!\r\n");
             return false;
@@ -234,57 +384,14 @@ static bool VerifySlotContent(InstallSlot_t* slot)
 
         slot->lastFragIdx = lastIdx;
 
-        uint32_t nextStart = (meta->type == DEFAULT_APP_TYPE_RESCUE)
-            ? RESCUE_DATA_BEGIN
-            : FIRST_FLASH_ADDRESS;
+        /* Fragments are read sequentially, fetch the next one while hashing */
+        W25Q128_SetReadAhead(true);
+        const bool fragmentsOk = VerifyFragments(slot, &ctx, lastIdx);
+        W25Q128_SetReadAhead(false);
 
-        for (size_t i = 0; i <= lastIdx; i++)
+        if (!fragmentsOk)
         {
-            res = FA_ReadFragment(&slot->fa, i, frag);
-            if (res != FA_ERR_OK)
-            {
-                printf("Fragment %u was not valid\r\n", i);
-                return false;
-            }
-
-            if (frag->startAddress != nextStart)
-            {
-                printf("Fragment %u: unexpected start address: %lX, expected %lX\r\n", i, frag->startAddress, nextStart);
-                return false;
-            }
-            else
-            {
-                nextStart += frag->size;
-            }
-
-            uint32_t verifyOffset = 0U;
-            size_t   verifyLen = frag->size;
-
-            if (frag->startAddress < meta->startAddress)
-            {
-                verifyOffset = meta->startAddress - frag->startAddress;
-            }
-
-            if (verifyOffset < verifyLen)
-            {
-                verifyLen -= verifyOffset;
-            }
-
-            if (verifyLen > 0U)
-            {
-                ed = ed25519_multipart_continue(&ctx, &frag->content[verifyOffset], verifyLen);
-                if (ed != 1U)
-                {
-                    printf("ed25519_multipart_continue failed\r\n");
-                    return false;
-                }
-            }
-
-            const uint32_t fragEndAddr = frag->startAddress + frag->size;
-            if (fragEndAddr > slot->highestAddr)
-            {
-                slot->highestAddr = fragEndAddr;
-            }
+            return false;
         }
 
         ed = ed25519_multipart_end(&ctx);
@@ -301,59 +408,88 @@ static bool VerifySlotContent(InstallSlot_t* slot)
     return false;
 }
 
+/** Verify the content of a slot on first use. Only the slot picked by the
+ *  install, rollback, repair or rescue path is read through, so boot time
+ *  does not grow with the number of stored versions.
+ * 
+ * @param slot Install slot with metadata read
+ * @return slot contains a valid firmware
+ */
+static bool SlotValid(InstallSlot_t* slot)
+{
+    if (!slot->metadataOk)
+    {
+        return false;
+    }
+
+    if (!slot->checked)
+    {
+        const uint32_t verifyStart = HAL_GetTick();
+
+        slot->checked = true;
+        (void)VerifySlotContent(slot);
+
+        printf("Install slot %u content is %s (%lu ms)\r\n",
+            (unsigned)(slot - f_slots),
+            slot->valid ? "valid" : "NOT valid",
+            HAL_GetTick() - verifyStart);
+    }
+
+    return slot->valid;
+}
+
 static inline bool InRange(uint32_t val, uint32_t low, uint32_t high)
 {
     return (val >= low) && (val <= high);
 }
 
-static bool EraseRequiredSectors(uint32_t startAddress, uint32_t endAddress)
+static bool EraseSector(const Stm32FlashSector_t* sec)
 {
-    bool eraseActive = false;
+    printf("Erasing sector %lu\r\n", sec->handle);
 
-    for (size_t i = 0; i < FLASH_SECTOR_TOTAL; i++)
-    {
-        const Stm32FlashSector_t* sec = &f_FLASH_SECTORS[i];
+    FLASH_EraseInitTypeDef eraseInitStruct;
+    uint32_t error = 0;
 
-        const uint32_t secStart = sec->startAddress;
-        const uint32_t secEnd = sec->startAddress + sec->size - 1U;
+    eraseInitStruct.TypeErase    = FLASH_TYPEERASE_SECTORS;
+    eraseInitStruct.VoltageRange = FLASH_VOLTAGE_RANGE_3; // 2.7V to 3.6V
+#ifdef ENABLE_DUAL_BANK
+    eraseInitStruct.Sector       = BANK_PhysicalSector(sec->handle);
+#else
+    eraseInitStruct.Sector       = sec->handle;
+#endif
+    eraseInitStruct.NbSectors    = 1;
 
-        if (InRange(startAddress, secStart, secEnd))
-        {
-            eraseActive = true;
-        }
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&eraseInitStruct, &error);
+    HAL_FLASH_Lock();
 
-        if (eraseActive)
-        {
-            printf("Erasing sector %lu\r\n", sec->handle);
+    if (status != HAL_OK)
+    {
+        printf("Sector erase failed error code %lu\r\n", error);
+        return false;
+    }
 
-            
-            FLASH_EraseInitTypeDef eraseInitStruct;
-            uint32_t error = 0;
-            
-            eraseInitStruct.TypeErase    = FLASH_TYPEERASE_SECTORS;
-            eraseInitStruct.VoltageRange = FLASH_VOLTAGE_RANGE_3; // 2.7V to 3.6V
-            eraseInitStruct.Sector       = sec->handle;
-            eraseInitStruct.NbSectors    = 1;
-            
-            HAL_FLASH_Unlock();
-            HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&eraseInitStruct, &error);
-            HAL_FLASH_Lock();
+    return true;
+}
 
-            if (status != HAL_OK)
-            {
-                printf("Sector erase failed error code %lu\r\n", error);
-                return false;
-            }
-        }
+static size_t FindSectorIndex(uint32_t address)
+{
+    for (size_t i = 0; i < FLASH_SECTOR_TOTAL; i++)
+    {
+        const Stm32FlashSector_t* sec = &f_FLASH_SECTORS[i];
 
-        if (InRange(endAddress, secStart, secEnd))
+        if (InRange(address, sec->startAddress, sec->startAddress + sec->size - 1U))
         {
-            eraseActive = false;
-            break;
+            return i;
         }
     }
 
-    return true;
+    return FLASH_SECTOR_TOTAL;
+}
+
+static uint32_t SectorCrc(const Stm32FlashSector_t* sec)
+{
+    return CRC32_Calculate((const uint8_t*)sec->startAddress, sec->size);
 }
 
 static inline bool FlashAligned(uint32_t val)
@@ -382,8 +518,8 @@ static bool ProgramFlash(uint32_t address, const uint8_t* data, size_t size)
     uint32_t startAddress = address;
     uint32_t endAddress = address + size;
 
-    if (!InRange(startAddress, APP_METADATA_ADDRESS, LAST_FLASH_ADDRESS) ||
-        !InRange(endAddress, APP_METADATA_ADDRESS, LAST_FLASH_ADDRESS))
+    if (!InRange(startAddress, APP_METADATA_ADDRESS + INSTALL_OFFSET, LAST_FLASH_ADDRESS + INSTALL_OFFSET) ||
+        !InRange(endAddress, APP_METADATA_ADDRESS + INSTALL_OFFSET, LAST_FLASH_ADDRESS + INSTALL_OFFSET))
     {
         printf("Write request exceeds flash boundaries!\r\n");
         return false;
@@ -439,6 +575,293 @@ static bool ProgramFlash(uint32_t address, const uint8_t* data, size_t size)
     return true;
 }
 
+/** Erase and program one internal flash sector from the slot
+ * 
+ * @param slot Install source slot
+ * @param sec Sector to install
+ * @param metadataAddress Install address of the metadata
+ * @param offset Install address offset from the linked fragment addresses
+ * @param fragIdx In: first fragment overlapping the sector,
+ *                Out: first fragment not completely programmed
+ * @return sector installed
+ */
+static bool InstallSector(
+    InstallSlot_t* slot,
+    const Stm32FlashSector_t* sec,
+    uint32_t metadataAddress,
+    uint32_t offset,
+    size_t* fragIdx)
+{
+    const Metadata_t* meta = &slot->metadata;
+    Fragment_t* frag = &slot->fragMem;
+
+    const uint32_t secStart = sec->startAddress;
+    const uint32_t secEnd = sec->startAddress + sec->size;
+
+    if (!EraseSector(sec))
+    {
+        return false;
+    }
+
+    if (InRange(metadataAddress, secStart, secEnd - 1U))
+    {
+        if (!ProgramFlash(metadataAddress, (const uint8_t*)meta, sizeof(Metadata_t)))
+        {
+            return false;
+        }
+    }
+
+    while (*fragIdx <= slot->lastFragIdx)
+    {
+        FA_ReturnCode_t res = ReadFragment(slot, *fragIdx, frag);
+
+        if (res != FA_ERR_OK)
+        {
+            printf("FA_ReadFragment failed!\r\n");
+            return false;
+        }
+
+        const uint32_t fragStart = frag->startAddress + offset;
+        const uint32_t fragEnd = fragStart + frag->size;
+
+        if (fragStart >= secEnd)
+        {
+            break;
+        }
+
+        /* Fragments may straddle sectors. Program only the part in this sector */
+        const uint32_t progStart = (fragStart > secStart) ? fragStart : secStart;
+        const uint32_t progEnd = MIN(fragEnd, secEnd);
+
+        if (progEnd > progStart)
+        {
+            if (!ProgramFlash(progStart, &frag->content[progStart - fragStart], progEnd - progStart))
+            {
+                return false;
+            }
+        }
+
+        if (fragEnd > secEnd)
+        {
+            /* Remainder is programmed with the next sector */
+            break;
+        }
+
+        (*fragIdx)++;
+    }
+
+    return true;
+}
+
+/** Find the fragment containing an address. The fragment index headers are
+ *  searched first, so only the found fragment is read and verified. Without
+ *  an index, fragments are contiguous from FIRST_FLASH_ADDRESS, so the index
+ *  is estimated from the full fragment size and corrected by reading
+ *  neighbours. The fragment is left in slot->fragMem.
+ * 
+ * @param slot Verified slot
+ * @param address Linked address
+ * @param out Fragment index output
+ * @return fragment found
+ */
+static bool FindFragment(InstallSlot_t* slot, uint32_t address, size_t* out)
+{
+    Fragment_t* frag = &slot->fragMem;
+    const size_t fragSize = sizeof(frag->content);
+    uint32_t number = 0U;
+
+    if (FRAGMENT_INDEX_FindAddress(
+            W25Qxx_INTERFACE_ReadFlash,
+            (uint32_t)(slot - f_slots),
+            slot->metadata.firmwareId,
+            (uint32_t)slot->lastFragIdx,
+            address,
+            &number) &&
+        (ReadFragment(slot, number, frag) == FA_ERR_OK) &&
+        (address >= frag->startAddress) &&
+        (address < (frag->startAddress + frag->size)))
+    {
+        *out = number;
+        return true;
+    }
+
+    size_t idx = (address > FIRST_FLASH_ADDRESS)
+        ? ((address - FIRST_FLASH_ADDRESS) / fragSize)
+        : 0U;
+    idx = MIN(idx, slot->lastFragIdx);
+
+    for (size_t tries = 0U; tries <= slot->lastFragIdx; tries++)
+    {
+        if (ReadFragment(slot, idx, frag) != FA_ERR_OK)
+        {
+            return false;
+        }
+
+        if (address < frag->startAddress)
+        {
+            if (idx == 0U)
+            {
+                return false;
+            }
+            idx--;
+        }
+        else if (address >= (frag->startAddress + frag->size))
+        {
+            if (idx == slot->lastFragIdx)
+            {
+                return false;
+            }
+            idx++;
+        }
+        else
+        {
+            *out = idx;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** Read image bytes from the fragments of a slot
+ * 
+ * @param slot Verified slot
+ * @param address Linked address
+ * @param out Output buffer
+ * @param size Bytes to read
+ * @return all bytes read
+ */
+static bool ReadSlotRange(InstallSlot_t* slot, uint32_t address, uint8_t* out, size_t size)
+{
+    const Fragment_t* frag = &slot->fragMem;
+
+    while (size > 0U)
+    {
+        size_t idx;
+
+        if (!FindFragment(slot, address, &idx))
+        {
+            return false;
+        }
+
+        const size_t len = MIN(frag->startAddress + frag->size - address, size);
+        memcpy(out, &frag->content[address - frag->startAddress], len);
+
+        out += len;
+        address += len;
+        size -= len;
+    }
+
+    return true;
+}
+
+/** Reinstall only the sectors of the active image whose segment digests do
+ *  not match. The slot content has been verified against the firmware
+ *  signature, so the digest table read from it is trusted. The repaired
+ *  image is accepted by hashing the rewritten segments again, without a
+ *  signature check over the whole image.
+ * 
+ * @param slot Verified slot containing the active image
+ * @return active image valid after repair
+ */
+static bool RepairDamagedSectors(InstallSlot_t* slot)
+{
+    static DigestTable_t table CCM_SCRATCH;
+    const Metadata_t* meta = &slot->metadata;
+
+    if (!slot->valid || (meta->firmwareSize < sizeof(DigestTable_t)))
+    {
+        return false;
+    }
+
+    const uint32_t tableAddress = DIGEST_TableAddress(meta->startAddress, meta->firmwareSize);
+
+    if (!ReadSlotRange(slot, tableAddress, (uint8_t*)&table, sizeof(table)))
+    {
+        printf("Digest table read failed!\r\n");
+        return false;
+    }
+
+    uint32_t damaged = 0U;
+    uint32_t repaired = 0U;
+
+    if (!APP_STATUS_CheckSegments(APP_IMAGE_ACTIVE, &table, &damaged))
+    {
+        return false;
+    }
+
+    printf("Damaged segment mask %08lX\r\n", damaged);
+
+    const size_t firstSector = FindSectorIndex(APP_METADATA_ADDRESS);
+    const size_t lastSector = FindSectorIndex(slot->highestAddr - 1U);
+
+    if ((firstSector >= FLASH_SECTOR_TOTAL) || (lastSector >= FLASH_SECTOR_TOTAL))
+    {
+        return false;
+    }
+
+    for (size_t i = firstSector; i <= lastSector; i++)
+    {
+        const Stm32FlashSector_t* sec = &f_FLASH_SECTORS[i];
+        const uint32_t firstSeg = (sec->startAddress - table.baseAddress) / table.segmentSize;
+        const uint32_t lastSeg = (sec->startAddress + sec->size - 1U - table.baseAddress) / table.segmentSize;
+
+        /* A sector smaller than a segment is rewritten if the segment differs */
+        uint32_t sectorSegments = 0U;
+        for (uint32_t s = firstSeg; (s <= lastSeg) && (s < DIGEST_TABLE_MAX_SEGMENTS); s++)
+        {
+            sectorSegments |= (1UL << s);
+        }
+
+        if ((damaged & sectorSegments) == 0U)
+        {
+            continue;
+        }
+
+        const uint32_t firstData = (sec->startAddress > FIRST_FLASH_ADDRESS)
+            ? sec->startAddress
+            : FIRST_FLASH_ADDRESS;
+        size_t fragIdx = 0U;
+
+        if (!FindFragment(slot, firstData, &fragIdx))
+        {
+            printf("No fragment for sector %lu\r\n", sec->handle);
+            return false;
+        }
+
+        printf("Repairing sector %lu\r\n", sec->handle);
+
+        if (!InstallSector(slot, sec, APP_METADATA_ADDRESS, 0U, &fragIdx))
+        {
+            return false;
+        }
+
+        repaired |= sectorSegments;
+    }
+
+    /* Every other segment already matched the table, hash only the rewritten ones */
+    return (repaired != 0U) && APP_STATUS_VerifySegments(APP_IMAGE_ACTIVE, &table, repaired);
+}
+
+/** Verify the inactive bank on first use. Boots that don't install, roll
+ *  back or repair never pay for the signature check of the other bank.
+ * 
+ * @return inactive bank holds a valid image
+ */
+static bool InactiveBankValid(void)
+{
+#ifdef ENABLE_DUAL_BANK
+    if (!f_inactiveVerified)
+    {
+        (void)APP_STATUS_VerifyImage(APP_IMAGE_INACTIVE, &f_keys);
+        f_inactiveVerified = true;
+    }
+    return APP_STATUS_ImageVerifyResult(APP_IMAGE_INACTIVE);
+#else
+    return false;
+#endif
+}
+
 static bool InstallFrom(InstallSlot_t* slot)
 {
     if (!slot->valid)
@@ -447,11 +870,15 @@ static bool InstallFrom(InstallSlot_t* slot)
     }
 
     Metadata_t* meta = &slot->metadata;
-    Fragment_t* frag = &slot->fragMem;
+    const uint32_t installStart = HAL_GetTick();
+
+    const uint32_t offset = (meta->type == DEFAULT_APP_TYPE_RESCUE)
+        ? 0U
+        : INSTALL_OFFSET;
 
     const uint32_t metadataAddress = (meta->type == DEFAULT_APP_TYPE_RESCUE)
         ? RESCUE_METADATA_ADDRESS
-        : APP_METADATA_ADDRESS;
+        : (APP_METADATA_ADDRESS + offset);
 
     if (!ValidateMetadata(meta))
     {
@@ -459,35 +886,99 @@ static bool InstallFrom(InstallSlot_t* slot)
         return false;
     }
 
-    if (!EraseRequiredSectors(metadataAddress, slot->highestAddr))
+    if (meta->type == DEFAULT_APP_TYPE_RESCUE)
     {
-        return false;
+        RESCUE_STATUS_Invalidate();
+    }
+    else
+    {
+        f_inactiveVerified = false;
     }
 
-    if (!ProgramFlash(metadataAddress, (const uint8_t*)meta, sizeof(Metadata_t)))
+    const size_t firstSector = FindSectorIndex(metadataAddress);
+    const size_t lastSector = FindSectorIndex(slot->highestAddr + offset - 1U);
+
+    if ((firstSector >= FLASH_SECTOR_TOTAL) || (lastSector >= FLASH_SECTOR_TOTAL))
     {
+        printf("Install range exceeds flash boundaries!\r\n");
         return false;
     }
 
-    for (size_t i = 0; i <= slot->lastFragIdx; i++)
+    /* Without a journal the install still works, it just cannot be resumed */
+    const bool journaled = JOURNAL_Begin(&f_journal, meta);
+    if (!journaled)
     {
-        FA_ReturnCode_t res = FA_ReadFragment(&slot->fa, i, frag);
+        printf("Install journal unavailable\r\n");
+    }
 
-        if (res != FA_ERR_OK)
+    size_t fragIdx = 0U;
+
+    for (size_t i = firstSector; i <= lastSector; i++)
+    {
+        const Stm32FlashSector_t* sec = &f_FLASH_SECTORS[i];
+        JournalRecord_t rec;
+
+        /* Sectors completed before a reset are kept if their content is intact */
+        if (journaled &&
+            JOURNAL_FindSector(&f_journal, i, &rec) &&
+            (rec.contentCrc == SectorCrc(sec)))
         {
-            printf("FA_ReadFragment failed!\r\n");
-            return false;
+            printf("Sector %lu already installed\r\n", sec->handle);
+            fragIdx = rec.nextFragment;
+            continue;
         }
 
-        if (!ProgramFlash(frag->startAddress, frag->content, frag->size))
+        if (!InstallSector(slot, sec, metadataAddress, offset, &fragIdx))
         {
             return false;
         }
+
+        if (journaled && !JOURNAL_MarkSector(&f_journal, i, fragIdx, SectorCrc(sec)))
+        {
+            printf("Journal write failed for sector %lu\r\n", sec->handle);
+        }
+    }
+
+    if (journaled)
+    {
+        (void)JOURNAL_Clear(&f_journal);
     }
 
+#ifdef ENABLE_DUAL_BANK
+    /* The staged image must be bootable on its own before it can be activated */
+    if (!InactiveBankValid())
+    {
+        printf("Staged image verification failed!\r\n");
+        return false;
+    }
+
+    if (!BANK_SyncBootloader())
+    {
+        printf("Bootloader copy to inactive bank failed!\r\n");
+        return false;
+    }
+#endif
+
+    printf("Install took %lu ms\r\n", HAL_GetTick() - installStart);
     return true;
 }
 
+/** Check if the target is already staged and verified in the inactive bank
+ * 
+ * @param target Target image metadata
+ * @return target can be activated without installing
+ */
+static bool StagedInInactiveBank(const Metadata_t* target)
+{
+#ifdef ENABLE_DUAL_BANK
+    return MetadataEqual(target, APP_STATUS_GetImageMetadata(APP_IMAGE_INACTIVE)) &&
+           InactiveBankValid();
+#else
+    (void)target;
+    return false;
+#endif
+}
+
 static bool EmptyMetadata(const Metadata_t* m)
 {
     const uint8_t* buf = (const uint8_t*)m;
@@ -508,7 +999,7 @@ static bool InstallAllowed(const Metadata_t* target, bool automaticRollback)
         : APP_STATUS_GetMetadata();
 
     const bool appValid = (target->type == DEFAULT_APP_TYPE_RESCUE)
-        ? RESCUE_STATUS_LastVerifyResult()
+        ? RESCUE_STATUS_Verify(&f_keys)
         : APP_STATUS_LastVerifyResult();
 
     if (!appValid)
@@ -552,8 +1043,9 @@ static bool ExecuteInstallCommand(const Metadata_t* metaArg)
     
     for (size_t i = 0; i < ARRAY_SIZE(f_slots); i++)
     {
-        if (f_slots[i].valid && 
-            (0 == memcmp(metaArg, &f_slots[i].metadata, sizeof(Metadata_t))))
+        if (f_slots[i].metadataOk && 
+            (0 == memcmp(metaArg, &f_slots[i].metadata, sizeof(Metadata_t))) &&
+            SlotValid(&f_slots[i]))
         {
             slot = &f_slots[i];
             printf("Found target firmware from slot %u\r\n", i);
@@ -561,7 +1053,11 @@ static bool ExecuteInstallCommand(const Metadata_t* metaArg)
         }
     }
     
-    if (slot == NULL)
+    if ((slot == NULL) && StagedInInactiveBank(metaArg))
+    {
+        printf("Found target firmware from inactive bank\r\n");
+    }
+    else if (slot == NULL)
     {
         printf("Target firmware not found! Install failed!\r\n");
         REQUIRE_B(CA_SetStatus(&f_ca, COMMAND_STATE_FAILED));
@@ -589,7 +1085,7 @@ static bool ExecuteInstallCommand(const Metadata_t* metaArg)
 
     if (status == COMMAND_STATE_HISTORY_WRITTEN)
     {
-        if (InstallFrom(slot))
+        if (StagedInInactiveBank(metaArg) || InstallFrom(slot))
         {
             REQUIRE_B(CA_SetStatus(&f_ca, COMMAND_STATE_FIRMWARE_WRITTEN));
             status = COMMAND_STATE_FIRMWARE_WRITTEN;
@@ -641,8 +1137,9 @@ static bool ExecuteRollbackCommand(Metadata_t* metaArg, bool automaticRollback)
 
     for (size_t i = 0; i < ARRAY_SIZE(f_slots); i++)
     {
-        if (f_slots[i].valid && 
-            (0 == memcmp(metaArg, &f_slots[i].metadata, sizeof(Metadata_t))))
+        if (f_slots[i].metadataOk && 
+            (0 == memcmp(metaArg, &f_slots[i].metadata, sizeof(Metadata_t))) &&
+            SlotValid(&f_slots[i]))
         {
             slot = &f_slots[i];
             printf("Found target rollback firmware from slot %u\r\n", i);
@@ -650,7 +1147,11 @@ static bool ExecuteRollbackCommand(Metadata_t* metaArg, bool automaticRollback)
         }
     }
 
-    if (slot == NULL)
+    if ((slot == NULL) && StagedInInactiveBank(metaArg))
+    {
+        printf("Found target rollback firmware from inactive bank\r\n");
+    }
+    else if (slot == NULL)
     {
         printf("Target rollback firmware not found! Install failed!\r\n");
         REQUIRE_B(CA_SetStatus(&f_ca, COMMAND_STATE_FAILED));
@@ -675,7 +1176,7 @@ static bool ExecuteRollbackCommand(Metadata_t* metaArg, bool automaticRollback)
 
     if (status == COMMAND_STATE_HISTORY_WRITTEN)
     {
-        if (InstallFrom(slot))
+        if (StagedInInactiveBank(metaArg) || InstallFrom(slot))
         {
             REQUIRE_B(CA_SetStatus(&f_ca, COMMAND_STATE_FIRMWARE_WRITTEN));
             status = COMMAND_STATE_FIRMWARE_WRITTEN;
@@ -710,9 +1211,9 @@ void INSTALLER_InitAreas(w25qxx_handle_t* w25q128, const KeyContainer_t* keys)
 
     static const MemoryConfig_t memConfs[] = {
         {
-            .baseAddress = SLOT_0_ADDRESS,
+            .baseAddress = PARTITION_COMMAND_AREA_ADDRESS,
             .sectorSize = W25Qxx_SECTOR_SIZE,
-            .memorySize = UPDATE_SLOT_SIZE,
+            .memorySize = PARTITION_COMMAND_AREA_SIZE,
             .eraseValue = 0xFF,
 
             .Reader = W25Qxx_INTERFACE_ReadFlash,
@@ -720,48 +1221,57 @@ void INSTALLER_InitAreas(w25qxx_handle_t* w25q128, const KeyContainer_t* keys)
             .Eraser = W25Qxx_INTERFACE_EraseFlash,
         },
         {
-            .baseAddress = SLOT_1_ADDRESS,
+            .baseAddress = PARTITION_JOURNAL_AREA_ADDRESS,
             .sectorSize = W25Qxx_SECTOR_SIZE,
-            .memorySize = UPDATE_SLOT_SIZE,
+            .memorySize = PARTITION_JOURNAL_AREA_SIZE,
             .eraseValue = 0xFF,
 
             .Reader = W25Qxx_INTERFACE_ReadFlash,
             .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
             .Eraser = W25Qxx_INTERFACE_EraseFlash,
-        },
-        {
-            .baseAddress = SLOT_2_ADDRESS,
-            .sectorSize = W25Qxx_SECTOR_SIZE,
-            .memorySize = UPDATE_SLOT_SIZE,
-            .eraseValue = 0xFF,
+        }
+    };
 
-            .Reader = W25Qxx_INTERFACE_ReadFlash,
-            .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
-            .Eraser = W25Qxx_INTERFACE_EraseFlash,
-        },
+    REQUIRE_V(CA_InitStruct(&f_ca, &memConfs[0], &CRC32_Calculate));
+
+    if (!JOURNAL_InitStruct(&f_journal, &memConfs[1]))
+    {
+        printf("JOURNAL_InitStruct failed!\r\n");
+    }
+
+    static PartitionTable_t table;
+
+    if (!PARTITION_Read(W25Qxx_INTERFACE_ReadFlash, &table))
+    {
+        printf("No partition table, using the default slots\r\n");
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(f_slots); i++)
+    {
+        if (table.slots[i].size == PARTITION_UNUSED)
         {
-            .baseAddress = COMMAND_AREA_ADDRESS,
+            continue;
+        }
+
+        f_slotConfs[i] = (MemoryConfig_t) {
+            .baseAddress = table.slots[i].address,
             .sectorSize = W25Qxx_SECTOR_SIZE,
-            .memorySize = 3U * W25Qxx_SECTOR_SIZE,
+            .memorySize = table.slots[i].size,
             .eraseValue = 0xFF,
 
             .Reader = W25Qxx_INTERFACE_ReadFlash,
             .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
             .Eraser = W25Qxx_INTERFACE_EraseFlash,
-        }
-    };
-
-    _Static_assert((ARRAY_SIZE(f_slots) + 1U) <= ARRAY_SIZE(memConfs), "Not enough memconfs");
+        };
 
-    REQUIRE_V(CA_InitStruct(&f_ca, &memConfs[3], &CRC32_Calculate));
+        REQUIRE_V(FA_ERR_OK == FA_InitStruct(&f_slots[i].fa, &f_slotConfs[i], ValidateFragment, ValidateMetadata));
 
-    for (size_t i = 0; i < ARRAY_SIZE(f_slots); i++)
-    {
-        REQUIRE_V(FA_ERR_OK == FA_InitStruct(&f_slots[i].fa, &memConfs[i], ValidateFragment, ValidateMetadata));
-        if (VerifySlotContent(&f_slots[i]))
+        /* Content is verified when a slot is picked, see SlotValid */
+        f_slots[i].metadataOk = (FA_ERR_OK == FA_ReadMetadata(&f_slots[i].fa, &f_slots[i].metadata));
+        if (f_slots[i].metadataOk)
         {
             printf(
-                "Install slot %i contains a valid %s\r\n",
+                "Install slot %i holds %s metadata\r\n",
                 i,
                 (f_slots[i].metadata.type == DEFAULT_APP_TYPE_RESCUE)
                     ? "rescue app"
@@ -770,7 +1280,7 @@ void INSTALLER_InitAreas(w25qxx_handle_t* w25q128, const KeyContainer_t* keys)
         }
         else
         {
-            printf("Install slot %i does not contain a valid binary\r\n", i);
+            printf("Install slot %i does not contain valid metadata\r\n", i);
         }
     }
 
@@ -832,17 +1342,70 @@ bool INSTALLER_TryRepair(void)
     {
         /* Try repairing the current application if the metadata was ok */
         /* but content was not */
-        return ExecuteInstallCommand(APP_STATUS_GetMetadata());
+#ifndef ENABLE_DUAL_BANK
+        for (size_t i = 0; i < ARRAY_SIZE(f_slots); i++)
+        {
+            if (f_slots[i].metadataOk &&
+                MetadataEqual(APP_STATUS_GetMetadata(), &f_slots[i].metadata) &&
+                SlotValid(&f_slots[i]))
+            {
+                printf("Repairing damaged sectors from slot %u\r\n", i);
+                if (RepairDamagedSectors(&f_slots[i]))
+                {
+                    return true;
+                }
+                break;
+            }
+        }
+#endif
+
+        if (ExecuteInstallCommand(APP_STATUS_GetMetadata()))
+        {
+            return true;
+        }
+    }
+
+#ifdef ENABLE_DUAL_BANK
+    /* Fall back to the image in the other bank */
+    if (!APP_STATUS_LastVerifyResult() &&
+        InactiveBankValid() &&
+        InstallAllowed(APP_STATUS_GetImageMetadata(APP_IMAGE_INACTIVE), false))
+    {
+        printf("Repairing by activating the inactive bank\r\n");
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+bool INSTALLER_ActivateInactiveBank(void)
+{
+#ifdef ENABLE_DUAL_BANK
+    if (!InactiveBankValid())
+    {
+        printf("Inactive bank does not contain a valid image!\r\n");
+        return false;
+    }
+
+    if (!BANK_SyncBootloader())
+    {
+        return false;
     }
 
+    return BANK_ActivateInactive();
+#else
     return false;
+#endif
 }
 
 bool INSTALLER_TryInstallRescueApp(const Metadata_t** out)
 {
     for (size_t i = 0; i < ARRAY_SIZE(f_slots); i++)
     {
-        if (f_slots[i].valid && f_slots[i].metadata.type == DEFAULT_APP_TYPE_RESCUE)
+        if (f_slots[i].metadataOk &&
+            (f_slots[i].metadata.type == DEFAULT_APP_TYPE_RESCUE) &&
+            SlotValid(&f_slots[i]))
         {
             *out = &f_slots[i].metadata;
             return InstallFrom(&f_slots[i]);
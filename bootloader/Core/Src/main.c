@@ -34,6 +34,10 @@
 #include "w25qxx/flash_interface.h"
 #include "delay.h"
 #include "niram/no_init_ram.h"
+#include "ramcode.h"
+#ifdef BOOTLOADER_CRYPTO_BENCH
+#include "crypto_bench.h"
+#endif
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -60,6 +64,9 @@ UART_HandleTypeDef huart3;
 
 /* USER CODE BEGIN PV */
 
+DMA_HandleTypeDef hdma_spi3_rx;
+DMA_HandleTypeDef hdma_spi3_tx;
+
 static uint8_t f_w25qxx_verify_buf[512];
 
 /* USER CODE END PV */
@@ -93,6 +100,31 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
   printf("No init ram cleared\r\n");
 }
 
+#ifdef BOOTLOADER_CRYPTO_BENCH
+static uint32_t DwtCycles(void)
+{
+  return DWT->CYCCNT;
+}
+
+/* Messages are read from internal flash, the same way the firmware is verified */
+static void RunCryptoBench(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0U;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  const CryptoBenchConfig_t config = {
+    .counter = DwtCycles,
+    .unit = "cycles",
+    .counterHz = SystemCoreClock,
+    .data = (const uint8_t*)FLASH_BASE,
+    .publicKey = generated_public_key,
+  };
+
+  CRYPTO_BENCH_Run(&config);
+}
+#endif
+
 static void JumpTo(uint32_t address)
 {
   uint32_t app_stack = *(__IO uint32_t*)address;
@@ -126,6 +158,7 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
+  RAMCODE_Init();
   NO_INIT_RAM_Init();
   /* USER CODE END 1 */
 
@@ -153,6 +186,10 @@ int main(void)
   /* USER CODE BEGIN 2 */
   printf("Bootloader initialized\r\n");
 
+#ifdef BOOTLOADER_CRYPTO_BENCH
+  RunCryptoBench();
+#endif
+
   NO_INIT_RAM_SetMember(&NO_INIT_RAM_content.resetCount, NO_INIT_RAM_content.resetCount + 1U);
 
   printf("No init memory reset count: %lu\r\n", NO_INIT_RAM_content.resetCount);
@@ -181,13 +218,9 @@ int main(void)
     .fragmentPubKey = generated_public_key,
   };
 
+  const uint32_t verifyStart = HAL_GetTick();
   bool appBinaryOk = APP_STATUS_Verify(&keys);
-  printf("APPLICATION BINARY IS %s\r\n", appBinaryOk ? "OK" : "NOT OK");
-
-#ifdef ENABLE_RESCUE_PARTITION
-  bool rescueBinaryOk = RESCUE_STATUS_Verify(&keys);
-  printf("RESCUE BINARY IS %s\r\n", rescueBinaryOk ? "OK" : "NOT OK");
-#endif
+  printf("APPLICATION BINARY IS %s (%lu ms)\r\n", appBinaryOk ? "OK" : "NOT OK", HAL_GetTick() - verifyStart);
 
   if (appBinaryOk && (NO_INIT_RAM_content.resetCount >= 10U))
   {
@@ -206,6 +239,12 @@ int main(void)
     #else
     NO_INIT_RAM_SetMember(&NO_INIT_RAM_content.installTag, 0U);
     #endif
+    #ifdef ENABLE_DUAL_BANK
+    if (!INSTALLER_ActivateInactiveBank())
+    {
+      printf("Bank activation failed!\r\n");
+    }
+    #endif
     appBinaryOk = APP_STATUS_Verify(&keys);
   }
   else
@@ -231,13 +270,24 @@ int main(void)
     {
       printf("Firmware repaired!\r\n");
       NO_INIT_RAM_SetMember(&NO_INIT_RAM_content.appTag, APP_TAG_GOOD);
+#ifdef ENABLE_DUAL_BANK
+      if (!INSTALLER_ActivateInactiveBank())
+      {
+        printf("Bank activation failed!\r\n");
+      }
+#else
       const Metadata_t* metadata = APP_STATUS_GetMetadata();
       APP_STATUS_PrintMetadata(metadata);
       JumpTo(metadata->startAddress);
+#endif
     }
   }
 
 #ifdef ENABLE_RESCUE_PARTITION
+  /* Rescue image is verified only when it is needed */
+  bool rescueBinaryOk = RESCUE_STATUS_Verify(&keys);
+  printf("RESCUE BINARY IS %s\r\n", rescueBinaryOk ? "OK" : "NOT OK");
+
   if (rescueBinaryOk)
   {
     NO_INIT_RAM_SetMember(&NO_INIT_RAM_content.appTag, APP_TAG_GOOD);
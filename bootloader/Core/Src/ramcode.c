@@ -0,0 +1,63 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * ramcode.c
+ *
+ * @brief Copy of the crypto code to SRAM. The startup code only copies .data,
+ *        the .ramcrypto section of the linker script is copied here.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "ramcode.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+#ifdef BOOTLOADER_CRYPTO_IN_RAM
+/* Defined in ld/crypto_ram/crypto_sections.ld */
+extern uint8_t _siramcrypto[];
+extern uint8_t _sramcrypto[];
+extern uint8_t _eramcrypto[];
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+void RAMCODE_Init(void)
+{
+#ifdef BOOTLOADER_CRYPTO_IN_RAM
+    memcpy(_sramcrypto, _siramcrypto, (size_t)(_eramcrypto - _sramcrypto));
+    __asm volatile ("dsb\n isb" ::: "memory");
+#endif
+}
+
+/* EoF ramcode.c */
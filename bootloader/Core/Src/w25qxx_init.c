@@ -37,6 +37,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdarg.h>
 
@@ -52,6 +53,15 @@ typedef struct
     uint16_t csPin;
 } ImplHandle_t;
 
+typedef struct
+{
+    bool enabled;
+    volatile bool busy;     /* DMA transfer ongoing, CS asserted */
+    volatile bool valid;    /* buf holds len bytes from address */
+    uint32_t address;
+    uint32_t len;
+} ReadAhead_t;
+
 /*----------------------------------------------------------------------------*/
 /* MACRO DEFINITIONS                                                          */
 /*----------------------------------------------------------------------------*/
@@ -70,16 +80,150 @@ if (NULL == ptr)\
     return NULL;\
 }
 
+#define SPI_TIMEOUT_MS      (1000U)
+
+#define CMD_READ_DATA       (0x03U)
+#define CMD_FAST_READ       (0x0BU)
+#define READ_CMD_LEN        (4U)
+#define FAST_READ_CMD_LEN   (5U)
+
+/* Largest read that is followed by a read-ahead */
+#define READ_AHEAD_SIZE     (4096U)
+
 /*----------------------------------------------------------------------------*/
 /* VARIABLE DEFINITIONS                                                       */
 /*----------------------------------------------------------------------------*/
 
 static ImplHandle_t f_impl;
+static ReadAhead_t f_readAhead;
+
+/* DMA target, must not be in CCM RAM */
+static uint8_t f_readAheadBuf[READ_AHEAD_SIZE];
 
 /*----------------------------------------------------------------------------*/
 /* PRIVATE FUNCTION DEFINITIONS                                               */
 /*----------------------------------------------------------------------------*/
 
+static void CsHigh(void)
+{
+    HAL_GPIO_WritePin(f_impl.csPort, f_impl.csPin, GPIO_PIN_SET);
+}
+
+static void CsLow(void)
+{
+    HAL_GPIO_WritePin(f_impl.csPort, f_impl.csPin, GPIO_PIN_RESET);
+}
+
+/** Get the address of a read command
+ * 
+ * @return true if the command is a read
+ */
+static bool ParseRead(const uint8_t* in_buf, uint32_t in_len, uint32_t* address)
+{
+    const bool read = ((in_len == READ_CMD_LEN) && (in_buf[0] == CMD_READ_DATA)) ||
+                      ((in_len == FAST_READ_CMD_LEN) && (in_buf[0] == CMD_FAST_READ));
+
+    if (read)
+    {
+        *address = ((uint32_t)in_buf[1] << 16) | ((uint32_t)in_buf[2] << 8) | in_buf[3];
+    }
+
+    return read;
+}
+
+static void CancelReadAhead(void)
+{
+    if (f_readAhead.busy)
+    {
+        (void)HAL_SPI_Abort(f_impl.hspi);
+        CsHigh();
+        f_readAhead.busy = false;
+    }
+
+    f_readAhead.valid = false;
+}
+
+static bool WaitReadAhead(void)
+{
+    const uint32_t start = HAL_GetTick();
+
+    while (f_readAhead.busy)
+    {
+        if ((HAL_GetTick() - start) > SPI_TIMEOUT_MS)
+        {
+            CancelReadAhead();
+            return false;
+        }
+    }
+
+    return f_readAhead.valid;
+}
+
+static void StartReadAhead(uint32_t address, uint32_t len)
+{
+    uint8_t cmd[FAST_READ_CMD_LEN] = {
+        CMD_FAST_READ,
+        (uint8_t)(address >> 16),
+        (uint8_t)(address >> 8),
+        (uint8_t)address,
+        0x00U, /* Dummy byte */
+    };
+
+    f_readAhead.address = address;
+    f_readAhead.len = len;
+    f_readAhead.valid = false;
+
+    CsLow();
+
+    if (HAL_SPI_Transmit(f_impl.hspi, cmd, sizeof(cmd), SPI_TIMEOUT_MS) != HAL_OK)
+    {
+        CsHigh();
+        return;
+    }
+
+    f_readAhead.busy = true;
+
+    if (HAL_SPI_Receive_DMA(f_impl.hspi, f_readAheadBuf, (uint16_t)len) != HAL_OK)
+    {
+        f_readAhead.busy = false;
+        CsHigh();
+    }
+}
+
+static bool ReadAheadHit(uint32_t address, uint32_t len)
+{
+    return (f_readAhead.busy || f_readAhead.valid) &&
+           (address >= f_readAhead.address) &&
+           ((address + len) <= (f_readAhead.address + f_readAhead.len));
+}
+
+static void ReadAheadDone(SPI_HandleTypeDef* hspi, bool ok)
+{
+    if ((hspi != f_impl.hspi) || !f_readAhead.busy)
+    {
+        return;
+    }
+
+    CsHigh();
+    f_readAhead.valid = ok;
+    f_readAhead.busy = false;
+}
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    ReadAheadDone(hspi, true);
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    ReadAheadDone(hspi, true);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi)
+{
+    ReadAheadDone(hspi, false);
+}
+
 uint8_t W25QXX_INT_SpiInit(void)
 {
     /* SPI initialization occurs outside of this module! */
@@ -113,14 +257,45 @@ uint8_t W25QXX_INT_SpiWriteRead(uint8_t instruction, uint8_t instruction_line,
         return 1;
     }
 
-    HAL_GPIO_WritePin(f_impl.csPort, f_impl.csPin, GPIO_PIN_RESET);
+    uint32_t readAddress = 0U;
+    const bool read = (out_len > 0U) && ParseRead(in_buf, in_len, &readAddress);
+
+    if (read && ReadAheadHit(readAddress, out_len) && WaitReadAhead())
+    {
+        memcpy(out_buf, &f_readAheadBuf[readAddress - f_readAhead.address], out_len);
+
+        if (f_readAhead.enabled && (out_len <= READ_AHEAD_SIZE))
+        {
+            StartReadAhead(readAddress + out_len, out_len);
+        }
+        return 0U;
+    }
+
+    /* Any other access ends the read-ahead, writes also make it stale */
+    CancelReadAhead();
+
+    /* Fast read allows the full SPI clock for bulk reads */
+    uint8_t fastRead[FAST_READ_CMD_LEN];
+
+    if (read && (in_buf[0] == CMD_READ_DATA))
+    {
+        fastRead[0] = CMD_FAST_READ;
+        fastRead[1] = in_buf[1];
+        fastRead[2] = in_buf[2];
+        fastRead[3] = in_buf[3];
+        fastRead[4] = 0x00U; /* Dummy byte */
+        in_buf = fastRead;
+        in_len = FAST_READ_CMD_LEN;
+    }
+
+    CsLow();
 
     uint8_t res = 0;
     HAL_StatusTypeDef hal = HAL_OK;
 
     if (in_len > 0U)
     {
-        hal = HAL_SPI_Transmit(f_impl.hspi, in_buf, in_len, 1000);
+        hal = HAL_SPI_Transmit(f_impl.hspi, in_buf, in_len, SPI_TIMEOUT_MS);
 
         if (hal != HAL_OK)
         {
@@ -130,7 +305,7 @@ uint8_t W25QXX_INT_SpiWriteRead(uint8_t instruction, uint8_t instruction_line,
 
     if ((res == 0U) && (out_len > 0U))
     {
-        hal = HAL_SPI_Receive(f_impl.hspi, out_buf, out_len, 1000);
+        hal = HAL_SPI_Receive(f_impl.hspi, out_buf, out_len, SPI_TIMEOUT_MS);
 
         if (hal != HAL_OK)
         {
@@ -138,7 +313,13 @@ uint8_t W25QXX_INT_SpiWriteRead(uint8_t instruction, uint8_t instruction_line,
         }
     }
 
-    HAL_GPIO_WritePin(f_impl.csPort, f_impl.csPin, GPIO_PIN_SET);
+    CsHigh();
+
+    /* Fetch the following data while the caller processes this */
+    if ((res == 0U) && read && f_readAhead.enabled && (out_len <= READ_AHEAD_SIZE))
+    {
+        StartReadAhead(readAddress + out_len, out_len);
+    }
 
     return res;
 }
@@ -189,6 +370,7 @@ void W25QXX_INT_DebugPrint(const char* const fmt, ...)
 w25qxx_handle_t* W25Q128_Init(SPI_HandleTypeDef* hspi, GPIO_TypeDef* csPort, uint16_t csPin)
 {
     memset(&f_impl, 0, sizeof(f_impl));
+    memset(&f_readAhead, 0, sizeof(f_readAhead));
 
     ASSERT_NOT_NULL(hspi);
     ASSERT_NOT_NULL(csPort);
@@ -213,4 +395,14 @@ w25qxx_handle_t* W25Q128_Init(SPI_HandleTypeDef* hspi, GPIO_TypeDef* csPort, uin
     return &f_impl.w25q128;
 }
 
+void W25Q128_SetReadAhead(bool enable)
+{
+    if (!enable)
+    {
+        CancelReadAhead();
+    }
+
+    f_readAhead.enabled = enable;
+}
+
 /* EoF w25qxx_init.c */
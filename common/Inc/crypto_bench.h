@@ -0,0 +1,191 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * crypto_bench.h
+ *
+ * @brief Micro-benchmarks of the primitives that dominate update and boot
+ *        times: ed25519_verify, the multipart verify, sha512_update and
+ *        CRC32_Calculate. Shared by the host benchmark and the optional
+ *        bootloader build, which counts DWT cycles. Results are printed as
+ *        one JSON object per line, the best iteration of each measurement,
+ *        so runs of two releases can be diffed directly.
+*/
+
+#ifndef CRYPTO_BENCH_H_
+#define CRYPTO_BENCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "crc/crc32.h"
+#include "ed25519.h"
+#include "ed25519_extra.h"
+#include "sha512.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+/* Message sizes run from the minimum up to the maximum in steps of x4 */
+#define CRYPTO_BENCH_MIN_SIZE       (64U)
+#define CRYPTO_BENCH_MAX_SIZE       (0x10000U)
+#define CRYPTO_BENCH_ITERATIONS     (8U)
+
+/* Multipart input is fed in fragment sized pieces like in the installer */
+#define CRYPTO_BENCH_CHUNK_SIZE     (1024U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+/** Free running counter, may wrap at 2^32 */
+typedef uint32_t (*CryptoBenchCounter_t)(void);
+
+typedef struct
+{
+    CryptoBenchCounter_t counter;
+    const char* unit;               /* "cycles" or "ns" */
+    uint32_t counterHz;             /* Counter frequency for reference */
+    const uint8_t* data;            /* At least CRYPTO_BENCH_MAX_SIZE bytes */
+    const uint8_t* publicKey;       /* Valid ed25519 point */
+} CryptoBenchConfig_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+static inline void CRYPTO_BENCH_Print(const CryptoBenchConfig_t* config, const char* name, uint32_t size, uint32_t best)
+{
+    printf("{\"bench\":\"%s\",\"size\":%lu,\"iterations\":%lu,\"best\":%lu,\"unit\":\"%s\"}\r\n",
+        name,
+        (unsigned long)size,
+        (unsigned long)CRYPTO_BENCH_ITERATIONS,
+        (unsigned long)best,
+        config->unit);
+}
+
+/** Run all measurements and print the results
+ * 
+ * @param config Counter and inputs
+ */
+static inline void CRYPTO_BENCH_Run(const CryptoBenchConfig_t* config)
+{
+    static ed25519_multipart_t ctx;
+    static sha512_context sha;
+    uint8_t signature[64];
+    uint8_t hash[64];
+    volatile uint32_t sink = 0U;
+
+    /* The verify rejects signatures with any of the top three bits set
+       before doing any work. Keep them clear so the full check runs. */
+    memcpy(signature, config->data, sizeof(signature));
+    signature[63] &= 0x1FU;
+
+    printf("{\"suite\":\"crypto_bench\",\"unit\":\"%s\",\"counter_hz\":%lu}\r\n",
+        config->unit, (unsigned long)config->counterHz);
+
+    for (uint32_t size = CRYPTO_BENCH_MIN_SIZE; size <= CRYPTO_BENCH_MAX_SIZE; size *= 4U)
+    {
+        uint32_t best = UINT32_MAX;
+        for (uint32_t i = 0U; i < CRYPTO_BENCH_ITERATIONS; i++)
+        {
+            const uint32_t start = config->counter();
+            sink += CRC32_Calculate(config->data, size);
+            const uint32_t elapsed = config->counter() - start;
+            best = (elapsed < best) ? elapsed : best;
+        }
+        CRYPTO_BENCH_Print(config, "crc32", size, best);
+
+        best = UINT32_MAX;
+        for (uint32_t i = 0U; i < CRYPTO_BENCH_ITERATIONS; i++)
+        {
+            (void)sha512_init(&sha);
+            const uint32_t start = config->counter();
+            (void)sha512_update(&sha, config->data, size);
+            const uint32_t elapsed = config->counter() - start;
+            (void)sha512_final(&sha, hash);
+            best = (elapsed < best) ? elapsed : best;
+        }
+        CRYPTO_BENCH_Print(config, "sha512_update", size, best);
+
+        best = UINT32_MAX;
+        for (uint32_t i = 0U; i < CRYPTO_BENCH_ITERATIONS; i++)
+        {
+            const uint32_t start = config->counter();
+            sink += (uint32_t)ed25519_verify(signature, config->data, size, config->publicKey);
+            const uint32_t elapsed = config->counter() - start;
+            best = (elapsed < best) ? elapsed : best;
+        }
+        CRYPTO_BENCH_Print(config, "ed25519_verify", size, best);
+
+        uint32_t bestInit = UINT32_MAX;
+        uint32_t bestEnd = UINT32_MAX;
+        best = UINT32_MAX;
+        for (uint32_t i = 0U; i < CRYPTO_BENCH_ITERATIONS; i++)
+        {
+            uint32_t start = config->counter();
+            sink += (uint32_t)ed25519_multipart_init(&ctx, signature, config->publicKey);
+            uint32_t elapsed = config->counter() - start;
+            bestInit = (elapsed < bestInit) ? elapsed : bestInit;
+
+            start = config->counter();
+            for (uint32_t offset = 0U; offset < size; offset += CRYPTO_BENCH_CHUNK_SIZE)
+            {
+                const uint32_t left = size - offset;
+                const uint32_t len = (left < CRYPTO_BENCH_CHUNK_SIZE) ? left : CRYPTO_BENCH_CHUNK_SIZE;
+                sink += (uint32_t)ed25519_multipart_continue(&ctx, &config->data[offset], len);
+            }
+            elapsed = config->counter() - start;
+            best = (elapsed < best) ? elapsed : best;
+
+            start = config->counter();
+            sink += (uint32_t)ed25519_multipart_end(&ctx);
+            elapsed = config->counter() - start;
+            bestEnd = (elapsed < bestEnd) ? elapsed : bestEnd;
+        }
+        CRYPTO_BENCH_Print(config, "ed25519_multipart_init", size, bestInit);
+        CRYPTO_BENCH_Print(config, "ed25519_multipart_continue", size, best);
+        CRYPTO_BENCH_Print(config, "ed25519_multipart_end", size, bestEnd);
+    }
+
+    (void)sink;
+}
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF crypto_bench.h */
+
+#endif /* CRYPTO_BENCH_H_ */
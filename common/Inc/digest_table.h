@@ -0,0 +1,101 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * digest_table.h
+ *
+ * @brief Per-segment digest table of a firmware image. The table is the last
+ *        part of the image, so it is located by the metadata start address
+ *        and firmware size and covered by the firmware signature. Digests
+ *        are filled after linking by the digestgen host tool, before signing.
+*/
+
+#ifndef DIGEST_TABLE_H_
+#define DIGEST_TABLE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define DIGEST_TABLE_MAGIC          (0x54474944U) /* "DIGT" */
+
+/* Segments are aligned to baseAddress. A sector smaller than a segment, like
+   the 16 KB sectors 12-15, is repaired when any overlapping segment differs */
+#define DIGEST_SEGMENT_SIZE         (0x10000U)
+#define DIGEST_TABLE_MAX_SEGMENTS   (32U)
+
+/* Leading bytes of the SHA-512 of the segment */
+#define DIGEST_SIZE                 (32U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+/** Segment i digests the image bytes in
+ *  [baseAddress + i * segmentSize, baseAddress + (i + 1) * segmentSize)
+ *  clipped to [imageStart, address of the table).
+ */
+typedef struct
+{
+    uint32_t magic;             /* DIGEST_TABLE_MAGIC */
+    uint32_t baseAddress;       /* Linked address of segment 0, sector aligned */
+    uint32_t imageStart;        /* First digested address, metadata startAddress */
+    uint32_t segmentSize;       /* DIGEST_SEGMENT_SIZE */
+    uint32_t segmentCount;      /* Digests in use */
+    uint32_t reserved[3];
+    uint8_t  digest[DIGEST_TABLE_MAX_SEGMENTS][DIGEST_SIZE];
+} DigestTable_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+/** Get the linked address of the digest table of an image
+ * 
+ * @param startAddress Metadata startAddress
+ * @param firmwareSize Metadata firmwareSize
+ * 
+ * @return Table address
+ */
+static inline uint32_t DIGEST_TableAddress(uint32_t startAddress, uint32_t firmwareSize)
+{
+    return startAddress + firmwareSize - (uint32_t)sizeof(DigestTable_t);
+}
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF digest_table.h */
+
+#endif /* DIGEST_TABLE_H_ */
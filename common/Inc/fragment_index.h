@@ -0,0 +1,370 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * fragment_index.h
+ *
+ * @brief Per-slot fragment index in the external flash. Entry n describes
+ *        fragment n of the slot, so presence, digest and last fragment
+ *        lookups read index entries instead of whole fragments. Header only
+ *        reads project the address fields out of an entry. The index is
+ *        written by the update server next to each fragment and erased with
+ *        the slot. For stored fragments it is only a hint: a missing or
+ *        stale index falls back to scanning the fragment area.
+ *
+ *        A reference entry records a fragment whose content is already
+ *        stored in another slot. The fragment itself is not written, its
+ *        place in the fragment area stays erased and readers take the
+ *        content from fragment refNumber of slot refSlot. References are
+ *        only made to stored fragments, never to other references, and
+ *        only for verifyMethod 0 fragments, whose chain value is the
+ *        digest in the entry. The slots a slot refers to are recorded in
+ *        its partition table entry, see partition_table.h.
+*/
+
+#ifndef FRAGMENT_INDEX_H_
+#define FRAGMENT_INDEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc/crc32.h"
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+/* Index areas are in the reserved part of the partition table layout, one
+   128 KB area per slot number */
+#define FRAGMENT_INDEX_BASE         (0x00700000U)
+#define FRAGMENT_INDEX_SLOT_SIZE    (0x00020000U)
+
+#define FRAGMENT_INDEX_MAX_ENTRIES  (FRAGMENT_INDEX_SLOT_SIZE / sizeof(FragmentIndexEntry_t))
+
+/* refSlot of an entry for a fragment stored in its own slot */
+#define FRAGMENT_INDEX_NO_REF       (0xFFFFFFFFU)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t firmwareId;        /* Firmware the fragment belongs to */
+    uint32_t number;            /* Fragment number, equals the entry index */
+    uint32_t startAddress;      /* Fragment startAddress */
+    uint32_t size;              /* Fragment size */
+    uint8_t  sha512[64];        /* Fragment sha512 field */
+    uint32_t refSlot;           /* Slot holding the content, FRAGMENT_INDEX_NO_REF if stored here */
+    uint32_t refNumber;         /* Fragment number of the content in refSlot */
+    uint32_t crc;               /* CRC32 of the fields above, erased if unused */
+} FragmentIndexEntry_t;
+
+/* Leading fields of an entry, read without the digest */
+typedef struct
+{
+    uint32_t firmwareId;
+    uint32_t number;
+    uint32_t startAddress;
+    uint32_t size;
+} FragmentIndexHeader_t;
+
+typedef bool (*FragmentIndexReader_t)(uint32_t address, uint8_t* data, size_t size);
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+/** Get the external flash address of the index area of a slot
+ * 
+ * @param slot Fragment slot index
+ * 
+ * @return Area address
+ */
+static inline uint32_t FRAGMENT_INDEX_AreaAddress(uint32_t slot)
+{
+    return FRAGMENT_INDEX_BASE + (slot * FRAGMENT_INDEX_SLOT_SIZE);
+}
+
+/** Get the external flash address of one index entry
+ * 
+ * @param slot Fragment slot index
+ * @param number Fragment number
+ * 
+ * @return Entry address
+ */
+static inline uint32_t FRAGMENT_INDEX_EntryAddress(uint32_t slot, uint32_t number)
+{
+    return FRAGMENT_INDEX_AreaAddress(slot) + (number * (uint32_t)sizeof(FragmentIndexEntry_t));
+}
+
+/** Fill an index entry and its CRC
+ * 
+ * @param entry Entry to fill
+ * @param firmwareId Fragment firmwareId
+ * @param number Fragment number
+ * @param startAddress Fragment startAddress
+ * @param size Fragment size
+ * @param sha512 Fragment sha512 field
+ */
+static inline void FRAGMENT_INDEX_MakeEntry(
+    FragmentIndexEntry_t* entry,
+    uint32_t firmwareId,
+    uint32_t number,
+    uint32_t startAddress,
+    uint32_t size,
+    const uint8_t* sha512)
+{
+    entry->firmwareId = firmwareId;
+    entry->number = number;
+    entry->startAddress = startAddress;
+    entry->size = size;
+    memcpy(entry->sha512, sha512, sizeof(entry->sha512));
+    entry->refSlot = FRAGMENT_INDEX_NO_REF;
+    entry->refNumber = FRAGMENT_INDEX_NO_REF;
+    entry->crc = CRC32_Calculate((const uint8_t*)entry, offsetof(FragmentIndexEntry_t, crc));
+}
+
+/** Fill a reference entry and its CRC
+ * 
+ * @param entry Entry to fill
+ * @param firmwareId Fragment firmwareId
+ * @param number Fragment number
+ * @param startAddress Fragment startAddress
+ * @param size Fragment size
+ * @param sha512 Fragment sha512 field
+ * @param refSlot Slot holding the content
+ * @param refNumber Fragment number of the content in refSlot
+ */
+static inline void FRAGMENT_INDEX_MakeReference(
+    FragmentIndexEntry_t* entry,
+    uint32_t firmwareId,
+    uint32_t number,
+    uint32_t startAddress,
+    uint32_t size,
+    const uint8_t* sha512,
+    uint32_t refSlot,
+    uint32_t refNumber)
+{
+    FRAGMENT_INDEX_MakeEntry(entry, firmwareId, number, startAddress, size, sha512);
+    entry->refSlot = refSlot;
+    entry->refNumber = refNumber;
+    entry->crc = CRC32_Calculate((const uint8_t*)entry, offsetof(FragmentIndexEntry_t, crc));
+}
+
+/** Check if an entry is a reference to another slot
+ * 
+ * @param entry Entry read with FRAGMENT_INDEX_Lookup
+ * 
+ * @return Fragment content is in entry->refSlot
+ */
+static inline bool FRAGMENT_INDEX_IsReference(const FragmentIndexEntry_t* entry)
+{
+    return entry->refSlot != FRAGMENT_INDEX_NO_REF;
+}
+
+/** Read one index entry
+ * 
+ * @param reader External flash reader
+ * @param slot Fragment slot index
+ * @param firmwareId Firmware in the slot
+ * @param number Fragment number
+ * @param entry Output entry
+ * 
+ * @return Entry is present and belongs to the firmware
+ */
+static inline bool FRAGMENT_INDEX_Lookup(
+    FragmentIndexReader_t reader,
+    uint32_t slot,
+    uint32_t firmwareId,
+    uint32_t number,
+    FragmentIndexEntry_t* entry)
+{
+    if (number >= FRAGMENT_INDEX_MAX_ENTRIES)
+    {
+        return false;
+    }
+
+    if (!reader(FRAGMENT_INDEX_EntryAddress(slot, number), (uint8_t*)entry, sizeof(*entry)))
+    {
+        return false;
+    }
+
+    return (entry->firmwareId == firmwareId) &&
+           (entry->number == number) &&
+           (entry->crc == CRC32_Calculate((const uint8_t*)entry, offsetof(FragmentIndexEntry_t, crc)));
+}
+
+/** Read only the header fields of an index entry. The entry CRC covers the
+ *  digest too, so the header is not integrity checked: it is a hint to be
+ *  confirmed by reading the fragment itself.
+ * 
+ * @param reader External flash reader
+ * @param slot Fragment slot index
+ * @param firmwareId Firmware in the slot
+ * @param number Fragment number
+ * @param header Output header
+ * 
+ * @return Header read and matches the firmware and number
+ */
+static inline bool FRAGMENT_INDEX_ReadHeader(
+    FragmentIndexReader_t reader,
+    uint32_t slot,
+    uint32_t firmwareId,
+    uint32_t number,
+    FragmentIndexHeader_t* header)
+{
+    _Static_assert(offsetof(FragmentIndexEntry_t, sha512) == sizeof(FragmentIndexHeader_t), "Header layout");
+
+    if (number >= FRAGMENT_INDEX_MAX_ENTRIES)
+    {
+        return false;
+    }
+
+    if (!reader(FRAGMENT_INDEX_EntryAddress(slot, number), (uint8_t*)header, sizeof(*header)))
+    {
+        return false;
+    }
+
+    return (header->firmwareId == firmwareId) && (header->number == number);
+}
+
+/** Find the fragment containing an address by a binary search over the entry
+ *  headers. Fragment addresses grow with the fragment number. The result is
+ *  not integrity checked, see FRAGMENT_INDEX_ReadHeader.
+ * 
+ * @param reader External flash reader
+ * @param slot Fragment slot index
+ * @param firmwareId Firmware in the slot
+ * @param lastNumber Number of the last fragment of the slot
+ * @param address Address to find
+ * @param number Output fragment number
+ * 
+ * @return Fragment found
+ */
+static inline bool FRAGMENT_INDEX_FindAddress(
+    FragmentIndexReader_t reader,
+    uint32_t slot,
+    uint32_t firmwareId,
+    uint32_t lastNumber,
+    uint32_t address,
+    uint32_t* number)
+{
+    FragmentIndexHeader_t header;
+    uint32_t low = 0U;
+    uint32_t high = lastNumber;
+
+    while (low <= high)
+    {
+        const uint32_t mid = low + ((high - low) / 2U);
+
+        if (!FRAGMENT_INDEX_ReadHeader(reader, slot, firmwareId, mid, &header))
+        {
+            return false;
+        }
+
+        if (address < header.startAddress)
+        {
+            if (mid == 0U)
+            {
+                return false;
+            }
+            high = mid - 1U;
+        }
+        else if (address >= (header.startAddress + header.size))
+        {
+            low = mid + 1U;
+        }
+        else
+        {
+            *number = mid;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** Find the last fragment of a slot. Fragments are written in order, so the
+ *  present entries form a prefix of the index and a binary search finds its
+ *  end.
+ * 
+ * @param reader External flash reader
+ * @param slot Fragment slot index
+ * @param firmwareId Firmware in the slot
+ * @param lastNumber Output number of the last fragment
+ * 
+ * @return Fragment 0 is indexed
+ */
+static inline bool FRAGMENT_INDEX_FindLast(
+    FragmentIndexReader_t reader,
+    uint32_t slot,
+    uint32_t firmwareId,
+    uint32_t* lastNumber)
+{
+    FragmentIndexEntry_t entry;
+
+    if (!FRAGMENT_INDEX_Lookup(reader, slot, firmwareId, 0U, &entry))
+    {
+        return false;
+    }
+
+    /* Entry low is present, entry high is not */
+    uint32_t low = 0U;
+    uint32_t high = FRAGMENT_INDEX_MAX_ENTRIES;
+
+    while ((high - low) > 1U)
+    {
+        const uint32_t mid = low + ((high - low) / 2U);
+
+        if (FRAGMENT_INDEX_Lookup(reader, slot, firmwareId, mid, &entry))
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    *lastNumber = low;
+    return true;
+}
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF fragment_index.h */
+
+#endif /* FRAGMENT_INDEX_H_ */
@@ -0,0 +1,307 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * partition_table.h
+ *
+ * @brief External flash layout shared by the application and the bootloader.
+ *        Firmware slots are extents described by a partition table kept in
+ *        two copies in the external flash. The copy with the highest valid
+ *        sequence number is current. The application allocates and writes
+ *        the table, the bootloader only reads it. Without a stored table the
+ *        original three 2 MB slots are used. A slot that another slot refers
+ *        to in its fragment index is never released or evicted.
+*/
+
+#ifndef PARTITION_TABLE_H_
+#define PARTITION_TABLE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc/crc32.h"
+#include "fragmentstore/fragmentstore.h"
+#include "fragment_index.h"
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define PARTITION_FLASH_SIZE            (0x01000000U)
+#define PARTITION_SECTOR_SIZE           (0x1000U)
+
+/* Slot extents are aligned to 64 KB block erases */
+#define PARTITION_ALIGN                 (0x10000U)
+#define PARTITION_MAX_SLOTS             (8U)
+
+/* Fixed areas */
+#define PARTITION_COMMAND_AREA_ADDRESS  (0x00600000U)
+#define PARTITION_COMMAND_AREA_SIZE     (3U * PARTITION_SECTOR_SIZE)
+#define PARTITION_JOURNAL_AREA_ADDRESS  (PARTITION_COMMAND_AREA_ADDRESS + PARTITION_COMMAND_AREA_SIZE)
+#define PARTITION_JOURNAL_AREA_SIZE     (PARTITION_SECTOR_SIZE)
+#define PARTITION_TABLE_ADDRESS         (PARTITION_JOURNAL_AREA_ADDRESS + PARTITION_JOURNAL_AREA_SIZE)
+#define PARTITION_TABLE_COPIES          (2U)
+
+/* Fixed areas and fragment indexes, never part of a slot */
+#define PARTITION_RESERVED_BEGIN        (0x00600000U)
+#define PARTITION_RESERVED_END          (0x00800000U)
+
+#define PARTITION_MAGIC                 (0x54524150U) /* "PART" */
+#define PARTITION_UNUSED                (0U)
+
+/* Size of the original fixed slots */
+#define PARTITION_LEGACY_SLOT_SIZE      (0x00200000U)
+#define PARTITION_LEGACY_SLOTS          (3U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t address;           /* Extent start, PARTITION_ALIGN aligned */
+    uint32_t size;              /* Extent size, PARTITION_UNUSED if free */
+    uint32_t lastUsed;          /* Table sequence of the last allocation */
+    uint32_t refMask;           /* Bit i set if the fragment index refers to slot i */
+} PartitionSlot_t;
+
+/** The array index of a slot is its slot number. Slot numbers also select
+ *  the fragment index area, see fragment_index.h.
+ */
+typedef struct
+{
+    uint32_t        magic;      /* PARTITION_MAGIC */
+    uint32_t        sequence;   /* Incremented on every write */
+    PartitionSlot_t slots[PARTITION_MAX_SLOTS];
+    uint32_t        crc;        /* CRC32 of the fields above */
+} PartitionTable_t;
+
+typedef bool (*PartitionReader_t)(uint32_t address, uint8_t* data, size_t size);
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+/** Check that an extent lies in the slot space of the external flash
+ * 
+ * @param address Extent start
+ * @param size Extent size
+ * 
+ * @return Extent usable for a slot
+ */
+static inline bool PARTITION_InSlotSpace(uint32_t address, uint32_t size)
+{
+    if ((size == 0U) ||
+        ((address % PARTITION_ALIGN) != 0U) ||
+        ((size % PARTITION_ALIGN) != 0U) ||
+        (size > PARTITION_FLASH_SIZE) ||
+        (address > (PARTITION_FLASH_SIZE - size)))
+    {
+        return false;
+    }
+
+    return ((address + size) <= PARTITION_RESERVED_BEGIN) || (address >= PARTITION_RESERVED_END);
+}
+
+/** Get the extent size needed for a firmware. Room is left for the metadata
+ *  sector and the fragment headers, rounded up to whole erase blocks.
+ * 
+ * @param firmwareSize Metadata firmwareSize
+ * 
+ * @return Extent size, 0 if the firmware can never fit
+ */
+static inline uint32_t PARTITION_SlotSizeFor(uint32_t firmwareSize)
+{
+    const uint32_t content = (uint32_t)sizeof(((Fragment_t*)0)->content);
+
+    if (firmwareSize > (PARTITION_FLASH_SIZE / 2U))
+    {
+        return 0U;
+    }
+
+    const uint32_t fragments = (firmwareSize + content - 1U) / content;
+    const uint32_t bytes = (2U * PARTITION_SECTOR_SIZE) + (fragments * (uint32_t)sizeof(Fragment_t));
+
+    return ((bytes + PARTITION_ALIGN - 1U) / PARTITION_ALIGN) * PARTITION_ALIGN;
+}
+
+/** Calculate the CRC of a table
+ * 
+ * @param table Partition table
+ * 
+ * @return CRC32 of all fields before crc
+ */
+static inline uint32_t PARTITION_Crc(const PartitionTable_t* table)
+{
+    return CRC32_Calculate((const uint8_t*)table, offsetof(PartitionTable_t, crc));
+}
+
+/** Check a table read from the flash. Every used slot must be in the slot
+ *  space and slots may not overlap.
+ * 
+ * @param table Partition table
+ * 
+ * @return Table valid
+ */
+static inline bool PARTITION_IsValid(const PartitionTable_t* table)
+{
+    if ((table->magic != PARTITION_MAGIC) || (table->crc != PARTITION_Crc(table)))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0U; i < PARTITION_MAX_SLOTS; i++)
+    {
+        const PartitionSlot_t* a = &table->slots[i];
+
+        if (a->size == PARTITION_UNUSED)
+        {
+            continue;
+        }
+
+        if (!PARTITION_InSlotSpace(a->address, a->size))
+        {
+            return false;
+        }
+
+        for (uint32_t j = i + 1U; j < PARTITION_MAX_SLOTS; j++)
+        {
+            const PartitionSlot_t* b = &table->slots[j];
+
+            if ((b->size != PARTITION_UNUSED) &&
+                (a->address < (b->address + b->size)) &&
+                (b->address < (a->address + a->size)))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/** Get the slots that the fragment indexes of the used slots refer to
+ * 
+ * @param table Partition table
+ * 
+ * @return Bit i set if slot i holds content of another slot
+ */
+static inline uint32_t PARTITION_ReferencedSlots(const PartitionTable_t* table)
+{
+    uint32_t mask = 0U;
+
+    for (uint32_t i = 0U; i < PARTITION_MAX_SLOTS; i++)
+    {
+        if (table->slots[i].size != PARTITION_UNUSED)
+        {
+            mask |= table->slots[i].refMask;
+        }
+    }
+
+    return mask;
+}
+
+/** Fill the layout used before the partition table existed
+ * 
+ * @param table Output table, sequence 0
+ */
+static inline void PARTITION_Default(PartitionTable_t* table)
+{
+    memset(table, 0, sizeof(*table));
+    table->magic = PARTITION_MAGIC;
+
+    for (uint32_t i = 0U; i < PARTITION_LEGACY_SLOTS; i++)
+    {
+        table->slots[i].address = i * PARTITION_LEGACY_SLOT_SIZE;
+        table->slots[i].size = PARTITION_LEGACY_SLOT_SIZE;
+    }
+
+    table->crc = PARTITION_Crc(table);
+}
+
+/** Get the flash address of one table copy
+ * 
+ * @param copy Copy index
+ * 
+ * @return Copy address
+ */
+static inline uint32_t PARTITION_CopyAddress(uint32_t copy)
+{
+    return PARTITION_TABLE_ADDRESS + ((copy % PARTITION_TABLE_COPIES) * PARTITION_SECTOR_SIZE);
+}
+
+/** Read the current partition table
+ * 
+ * @param reader External flash reader
+ * @param table Output table, the default layout if none is stored
+ * 
+ * @return A stored table was found
+ */
+static inline bool PARTITION_Read(PartitionReader_t reader, PartitionTable_t* table)
+{
+    PartitionTable_t copy;
+    bool found = false;
+
+    for (uint32_t i = 0U; i < PARTITION_TABLE_COPIES; i++)
+    {
+        if (reader(PARTITION_CopyAddress(i), (uint8_t*)&copy, sizeof(copy)) &&
+            PARTITION_IsValid(&copy) &&
+            (!found || (copy.sequence > table->sequence)))
+        {
+            memcpy(table, &copy, sizeof(copy));
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        PARTITION_Default(table);
+    }
+
+    return found;
+}
+
+_Static_assert(sizeof(PartitionTable_t) <= PARTITION_SECTOR_SIZE, "Table must fit a sector");
+_Static_assert((PARTITION_TABLE_ADDRESS + (PARTITION_TABLE_COPIES * PARTITION_SECTOR_SIZE)) <= PARTITION_RESERVED_END,
+    "Fixed areas must be reserved");
+_Static_assert((FRAGMENT_INDEX_BASE >= (PARTITION_TABLE_ADDRESS + (PARTITION_TABLE_COPIES * PARTITION_SECTOR_SIZE))) &&
+    ((FRAGMENT_INDEX_BASE + (PARTITION_MAX_SLOTS * FRAGMENT_INDEX_SLOT_SIZE)) <= PARTITION_RESERVED_END),
+    "Fragment indexes must be reserved");
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF partition_table.h */
+
+#endif /* PARTITION_TABLE_H_ */
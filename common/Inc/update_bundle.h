@@ -0,0 +1,144 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * update_bundle.h
+ *
+ * @brief Signed update bundle. One file holds the signed metadata and every
+ *        signed fragment of a firmware image in the exact layout of the
+ *        update protocol PDUs, so a client maps the file and sends fragments
+ *        straight from the mapping without parsing or signing anything. The
+ *        fragment array is page aligned for that. Produced by the bundlegen
+ *        host tool from the output of hexsign.
+*/
+
+#ifndef UPDATE_BUNDLE_H_
+#define UPDATE_BUNDLE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crc/crc32.h"
+#include "fragmentstore/fragmentstore.h"
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define UPDATE_BUNDLE_MAGIC         (0x4C444E42U) /* "BNDL" */
+#define UPDATE_BUNDLE_VERSION       (1U)
+
+/* Alignment of the fragment array in the file */
+#define UPDATE_BUNDLE_PAGE_SIZE     (4096U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+/** File header. Offsets are from the start of the file, fragment i is at
+ *  fragmentOffset + i * fragmentSize.
+ */
+typedef struct
+{
+    uint32_t magic;             /* UPDATE_BUNDLE_MAGIC */
+    uint32_t version;           /* UPDATE_BUNDLE_VERSION */
+    uint32_t headerSize;        /* sizeof(UpdateBundleHeader_t) */
+    uint32_t metadataOffset;
+    uint32_t metadataSize;      /* sizeof(Metadata_t) */
+    uint32_t fragmentOffset;    /* Multiple of UPDATE_BUNDLE_PAGE_SIZE */
+    uint32_t fragmentSize;      /* sizeof(Fragment_t) */
+    uint32_t fragmentCount;
+    uint32_t firmwareId;        /* Metadata firmwareId */
+    uint32_t fileSize;
+    uint32_t reserved[5];
+    uint32_t headerCrc;         /* CRC32 of the header before this field */
+} UpdateBundleHeader_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+/** Check the header of a mapped bundle against the build of the caller
+ * 
+ * @param file Start of the file
+ * @param size File size in bytes
+ * 
+ * @return Header, NULL if the file is not a compatible bundle
+ */
+static inline const UpdateBundleHeader_t* UPDATE_BUNDLE_Check(const uint8_t* file, size_t size)
+{
+    const UpdateBundleHeader_t* hdr = (const UpdateBundleHeader_t*)file;
+
+    if ((size < sizeof(UpdateBundleHeader_t)) ||
+        (hdr->magic != UPDATE_BUNDLE_MAGIC) ||
+        (hdr->version != UPDATE_BUNDLE_VERSION) ||
+        (hdr->headerSize != sizeof(UpdateBundleHeader_t)) ||
+        (hdr->headerCrc != CRC32_Calculate(file, offsetof(UpdateBundleHeader_t, headerCrc))) ||
+        (hdr->metadataSize != sizeof(Metadata_t)) ||
+        (hdr->fragmentSize != sizeof(Fragment_t)) ||
+        (hdr->fileSize != size) ||
+        ((hdr->metadataOffset + (uint64_t)hdr->metadataSize) > size) ||
+        ((hdr->fragmentOffset + ((uint64_t)hdr->fragmentCount * hdr->fragmentSize)) > size))
+    {
+        return NULL;
+    }
+
+    return hdr;
+}
+
+/** Get the signed metadata of a checked bundle */
+static inline const Metadata_t* UPDATE_BUNDLE_Metadata(const uint8_t* file)
+{
+    const UpdateBundleHeader_t* hdr = (const UpdateBundleHeader_t*)file;
+    return (const Metadata_t*)&file[hdr->metadataOffset];
+}
+
+/** Get a signed fragment of a checked bundle
+ * 
+ * @param file Start of the file
+ * @param index Fragment number, below fragmentCount
+ * 
+ * @return Fragment, sent as is in a fragment PDU
+ */
+static inline const Fragment_t* UPDATE_BUNDLE_Fragment(const uint8_t* file, uint32_t index)
+{
+    const UpdateBundleHeader_t* hdr = (const UpdateBundleHeader_t*)file;
+    return (const Fragment_t*)&file[hdr->fragmentOffset + ((size_t)index * hdr->fragmentSize)];
+}
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF update_bundle.h */
+
+#endif /* UPDATE_BUNDLE_H_ */
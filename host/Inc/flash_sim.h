@@ -0,0 +1,118 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * flash_sim.h
+ *
+ * @brief Simulated STM32F439 dual bank internal flash. Both physical banks
+ *        are shared memory objects mapped at 0x08000000 and 0x08100000, so
+ *        target code can read flash through plain pointers.
+*/
+
+#ifndef FLASH_SIM_H_
+#define FLASH_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <setjmp.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t sectorErases;      /* Sectors erased */
+    uint32_t bytesProgrammed;   /* Bytes programmed */
+    uint32_t resets;            /* Simulated resets */
+    uint32_t powerCuts;         /* Simulated power losses */
+    uint64_t eraseUs;           /* Modeled sector erase time */
+    uint64_t programUs;         /* Modeled program time */
+} SimFlashStats_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define SIM_FLASH_BASE      (0x08000000U)
+#define SIM_FLASH_BANK_SIZE (0x00100000U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Create both banks erased and map them with bank 1 active
+ * 
+ * @return true if mapped at the flash addresses
+ */
+extern bool SIM_FLASH_Init(void);
+
+/** Register the point execution continues from after NVIC_SystemReset()
+ * 
+ * @param env Jump buffer initialized by setjmp()
+ */
+extern void SIM_FLASH_SetResetPoint(jmp_buf* env);
+
+/** Cut the power after a number of erase and program operations. The power
+ *  loss continues from the reset point like NVIC_SystemReset() but the
+ *  interrupted operation is not done.
+ * 
+ * @param operations Operations before the cut, 0 disables
+ */
+extern void SIM_FLASH_SetPowerCut(uint32_t operations);
+
+/** Get a pointer to a physical bank regardless of the current mapping
+ * 
+ * @param bank BANK_1 or BANK_2
+ * 
+ * @return Pointer to the start of the bank
+ */
+extern uint8_t* SIM_FLASH_PhysicalBank(uint32_t bank);
+
+/** Get the committed BFB2 option bit
+ * 
+ * @return true if BFB2 is set
+ */
+extern bool SIM_FLASH_GetBfb2(void);
+
+/** Get operation counters
+ * 
+ * @return Counters since SIM_FLASH_Init()
+ */
+extern SimFlashStats_t SIM_FLASH_GetStats(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF flash_sim.h */
+
+#endif /* FLASH_SIM_H_ */
@@ -0,0 +1,68 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * sockets.h
+ *
+ * @brief Replay replacement of the LwIP socket API. The server socket calls
+ *        are served from a captured session log by replay_sim.c.
+*/
+
+#ifndef LWIP_SOCKETS_H_
+#define LWIP_SOCKETS_H_
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define socket(domain, type, protocol)  REPLAY_Socket(domain, type, protocol)
+#define bind(s, addr, len)              REPLAY_Bind(s, addr, len)
+#define recvfrom(s, buf, len, flags, from, fromlen) \
+                                        REPLAY_RecvFrom(s, buf, len, flags, from, fromlen)
+#define sendto(s, buf, len, flags, to, tolen) \
+                                        REPLAY_SendTo(s, buf, len, flags, to, tolen)
+#define close(s)                        REPLAY_Close(s)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+extern int REPLAY_Socket(int domain, int type, int protocol);
+extern int REPLAY_Bind(int s, const struct sockaddr* addr, socklen_t len);
+extern ssize_t REPLAY_RecvFrom(int s, void* buf, size_t len, int flags, struct sockaddr* from, socklen_t* fromlen);
+extern ssize_t REPLAY_SendTo(int s, const void* buf, size_t len, int flags, const struct sockaddr* to, socklen_t tolen);
+extern int REPLAY_Close(int s);
+
+/* EoF sockets.h */
+
+#endif /* LWIP_SOCKETS_H_ */
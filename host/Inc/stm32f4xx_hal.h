@@ -0,0 +1,157 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * stm32f4xx_hal.h
+ *
+ * @brief Host replacement of the STM32F4 HAL subset used by the bootloader
+ *        flash and install code. Implemented by flash_sim.c on top of a
+ *        simulated dual bank internal flash mapped at the real flash
+ *        addresses.
+*/
+
+#ifndef STM32F4XX_HAL_H_
+#define STM32F4XX_HAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+typedef enum
+{
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+typedef struct
+{
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Sector;
+    uint32_t NbSectors;
+    uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+typedef struct
+{
+    uint32_t OptionType;
+    uint32_t PCROPState;
+    uint32_t Banks;
+    uint16_t SectorsBank1;
+    uint16_t SectorsBank2;
+    uint8_t  BootConfig;
+} FLASH_AdvOBProgramInitTypeDef;
+
+typedef struct
+{
+    volatile uint32_t MEMRMP;
+} SYSCFG_TypeDef;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define FLASH_TYPEERASE_SECTORS     (0x00000000U)
+#define FLASH_TYPEERASE_MASSERASE   (0x00000001U)
+
+#define FLASH_VOLTAGE_RANGE_3       (0x00000002U)
+
+#define FLASH_TYPEPROGRAM_BYTE      (0x00000000U)
+#define FLASH_TYPEPROGRAM_HALFWORD  (0x00000001U)
+#define FLASH_TYPEPROGRAM_WORD      (0x00000002U)
+
+#define OPTIONBYTE_BOOTCONFIG       (0x00000002U)
+#define OB_DUAL_BOOT_ENABLE         ((uint8_t)0x10)
+#define OB_DUAL_BOOT_DISABLE        ((uint8_t)0x00)
+
+#define SYSCFG_MEMRMP_UFB_MODE      (0x00000100U)
+
+#define FLASH_SECTOR_0              (0U)
+#define FLASH_SECTOR_1              (1U)
+#define FLASH_SECTOR_2              (2U)
+#define FLASH_SECTOR_3              (3U)
+#define FLASH_SECTOR_4              (4U)
+#define FLASH_SECTOR_5              (5U)
+#define FLASH_SECTOR_6              (6U)
+#define FLASH_SECTOR_7              (7U)
+#define FLASH_SECTOR_8              (8U)
+#define FLASH_SECTOR_9              (9U)
+#define FLASH_SECTOR_10             (10U)
+#define FLASH_SECTOR_11             (11U)
+#define FLASH_SECTOR_12             (12U)
+#define FLASH_SECTOR_13             (13U)
+#define FLASH_SECTOR_14             (14U)
+#define FLASH_SECTOR_15             (15U)
+#define FLASH_SECTOR_16             (16U)
+#define FLASH_SECTOR_17             (17U)
+#define FLASH_SECTOR_18             (18U)
+#define FLASH_SECTOR_19             (19U)
+#define FLASH_SECTOR_20             (20U)
+#define FLASH_SECTOR_21             (21U)
+#define FLASH_SECTOR_22             (22U)
+#define FLASH_SECTOR_23             (23U)
+#define FLASH_SECTOR_TOTAL          (24U)
+
+extern SYSCFG_TypeDef SIM_SYSCFG;
+#define SYSCFG (&SIM_SYSCFG)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Millisecond tick, provided by the simulation using this header */
+extern uint32_t HAL_GetTick(void);
+
+extern HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+extern HAL_StatusTypeDef HAL_FLASH_Lock(void);
+extern HAL_StatusTypeDef HAL_FLASH_OB_Unlock(void);
+extern HAL_StatusTypeDef HAL_FLASH_OB_Lock(void);
+extern HAL_StatusTypeDef HAL_FLASH_OB_Launch(void);
+extern HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+extern HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError);
+extern HAL_StatusTypeDef HAL_FLASHEx_AdvOBProgram(FLASH_AdvOBProgramInitTypeDef* pAdvOBInit);
+
+/** Simulated reset. Remaps the banks according to BFB2 and jumps back to the
+ *  reset point registered with SIM_FLASH_SetResetPoint().
+ */
+extern void NVIC_SystemReset(void) __attribute__((noreturn));
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF stm32f4xx_hal.h */
+
+#endif /* STM32F4XX_HAL_H_ */
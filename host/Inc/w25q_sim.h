@@ -0,0 +1,151 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * w25q_sim.h
+ *
+ * @brief Simulated W25Q128 backed by a memory mapped 16 MB image file. Models
+ *        page program wrap-around, programs that only clear bits and 4/32/64
+ *        KB erases. An optional timing model sleeps for the typical busy
+ *        times of the datasheet, the simulated busy time is always counted.
+*/
+
+#ifndef W25Q_SIM_H_
+#define W25Q_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint64_t bytesRead;         /* Bytes read */
+    uint64_t bytesProgrammed;   /* Bytes programmed */
+    uint32_t pagePrograms;      /* Page program commands */
+    uint32_t erases4k;          /* Sector erases */
+    uint32_t erases32k;         /* 32 KB block erases */
+    uint32_t erases64k;         /* 64 KB block erases */
+    uint32_t programConflicts;  /* Programs that tried to set a cleared bit */
+    uint64_t readUs;            /* Simulated SPI read time */
+    uint64_t busyUs;            /* Simulated SPI and busy time, reads included */
+} W25qSimStats_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC MACRO DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+#define W25Q_SIM_SIZE       (0x01000000U)
+#define W25Q_SIM_PAGE_SIZE  (256U)
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Map an image file, created erased if it does not exist
+ * 
+ * @param path Image file, NULL for an anonymous image
+ * 
+ * @return true on success
+ */
+extern bool W25Q_SIM_Open(const char* path);
+
+/** Flush and unmap the image */
+extern void W25Q_SIM_Close(void);
+
+/** Sleep for the simulated busy times
+ * 
+ * @param enabled Timing model enabled
+ */
+extern void W25Q_SIM_SetTiming(bool enabled);
+
+/** Read data, as with the fast read command
+ * 
+ * @param address Start address
+ * @param data Output buffer
+ * @param size Bytes to read
+ * 
+ * @return false if out of range
+ */
+extern bool W25Q_SIM_Read(uint32_t address, uint8_t* data, size_t size);
+
+/** One page program command. Data past the end of the page wraps to the
+ *  start of the page like on the device.
+ * 
+ * @param address Start address
+ * @param data Data to program
+ * @param size Bytes, at most W25Q_SIM_PAGE_SIZE
+ * 
+ * @return false if out of range
+ */
+extern bool W25Q_SIM_PageProgram(uint32_t address, const uint8_t* data, size_t size);
+
+/** Program a range with page program commands split at page boundaries
+ * 
+ * @param address Start address
+ * @param data Data to program
+ * @param size Bytes to program
+ * 
+ * @return false if out of range
+ */
+extern bool W25Q_SIM_Program(uint32_t address, const uint8_t* data, size_t size);
+
+/** One erase command
+ * 
+ * @param address Block aligned address
+ * @param blockSize 4, 32 or 64 KB
+ * 
+ * @return false if misaligned or out of range
+ */
+extern bool W25Q_SIM_EraseBlock(uint32_t address, uint32_t blockSize);
+
+/** Get the mapped image for direct inspection
+ * 
+ * @return Pointer to W25Q_SIM_SIZE bytes
+ */
+extern uint8_t* W25Q_SIM_Memory(void);
+
+/** Get operation counters
+ * 
+ * @return Counters since W25Q_SIM_Open()
+ */
+extern W25qSimStats_t W25Q_SIM_GetStats(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF w25q_sim.h */
+
+#endif /* W25Q_SIM_H_ */
@@ -0,0 +1,88 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * w25q_spi_sim.h
+ *
+ * @brief SPI command level W25Q128 on top of w25q_sim. The LibDriver w25qxx
+ *        driver is linked to it like to the STM32 SPI port, so the driver and
+ *        the flash interface library run unmodified. Every SPI transaction is
+ *        counted by command class with the bytes moved on the bus.
+*/
+
+#ifndef W25Q_SPI_SIM_H_
+#define W25Q_SPI_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "driver_w25qxx.h"
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC TYPE DEFINITIONS                                                    */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t transactions;      /* Chip select cycles */
+    uint32_t reads;             /* Read and fast read commands */
+    uint32_t pagePrograms;      /* Page program commands */
+    uint32_t erases;            /* Sector, block and chip erase commands */
+    uint32_t statusReads;       /* Status register reads, busy polling */
+    uint32_t writeEnables;      /* Write enable and disable */
+    uint32_t other;             /* Identification, reset and configuration */
+    uint64_t bytesOut;          /* Command, address and data bytes sent */
+    uint64_t bytesIn;           /* Data bytes received */
+    uint64_t transferUs;        /* Modeled bus time of all bytes */
+} W25qSpiSimStats_t;
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DECLARATIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/** Link and initialize a driver handle. W25Q_SIM_Open() must be called first.
+ * 
+ * @return Handle, NULL if the driver initialization failed
+ */
+extern w25qxx_handle_t* W25Q_SPI_SIM_Init(void);
+
+/** Get bus counters
+ * 
+ * @return Counters since W25Q_SPI_SIM_Init()
+ */
+extern W25qSpiSimStats_t W25Q_SPI_SIM_GetStats(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+/* EoF w25q_spi_sim.h */
+
+#endif /* W25Q_SPI_SIM_H_ */
@@ -0,0 +1,208 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * bank_sim.c
+ *
+ * @brief Dual bank A/B simulation. Runs the bootloader bank.c against the
+ *        simulated flash: stage an image into the inactive bank, copy the
+ *        bootloader, activate with BFB2, reset, and roll back.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "flash_sim.h"
+#include "bank.h"
+#include "stm32f4xx_hal.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define BOOTLOADER_BEGIN    (0x08000000U)
+#define BOOTLOADER_SIZE     (0x00010000U)
+#define IMAGE_BEGIN         (0x08010000U)
+#define IMAGE_SIZE          (0x00040000U)
+#define INACTIVE_OFFSET     (SIM_FLASH_BANK_SIZE)
+
+/* Application area is sectors 4-11 of a bank */
+#define IMAGE_FIRST_SECTOR  (FLASH_SECTOR_4)
+#define IMAGE_SECTOR_COUNT  (8U)
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\r\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static jmp_buf f_resetPoint;
+static volatile uint32_t f_step = 0U;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static uint32_t ImageWord(uint32_t version, uint32_t offset)
+{
+    return (version << 24) ^ offset;
+}
+
+static uint32_t ImageVersionAt(uint32_t address)
+{
+    return (*(const uint32_t*)(uintptr_t)address) >> 24;
+}
+
+static void ProgramImage(uint32_t address, uint32_t version)
+{
+    HAL_FLASH_Unlock();
+    for (uint32_t offset = 0U; offset < IMAGE_SIZE; offset += 4U)
+    {
+        CHECK(HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + offset, ImageWord(version, offset)) == HAL_OK);
+    }
+    HAL_FLASH_Lock();
+}
+
+static void ProgramBootloader(void)
+{
+    HAL_FLASH_Unlock();
+    for (uint32_t offset = 0U; offset < BOOTLOADER_SIZE; offset += 4U)
+    {
+        CHECK(HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, BOOTLOADER_BEGIN + offset, 0xB0070000U | offset) == HAL_OK);
+    }
+    HAL_FLASH_Lock();
+}
+
+/** Stage an image the way the installer does: erase the inactive application
+ *  sectors through the physical sector translation and program by address.
+ */
+static void StageInactive(uint32_t version)
+{
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_SECTORS,
+        .Sector = BANK_PhysicalSector(FLASH_SECTOR_12 + IMAGE_FIRST_SECTOR),
+        .NbSectors = IMAGE_SECTOR_COUNT,
+        .VoltageRange = FLASH_VOLTAGE_RANGE_3,
+    };
+    uint32_t error = 0U;
+
+    HAL_FLASH_Unlock();
+    CHECK(HAL_FLASHEx_Erase(&erase, &error) == HAL_OK);
+    HAL_FLASH_Lock();
+
+    ProgramImage(IMAGE_BEGIN + INACTIVE_OFFSET, version);
+}
+
+static void PrintState(const char* label)
+{
+    printf("%-28s active bank %u, BFB2 %u, running v%u, inactive v%u\r\n",
+        label,
+        (unsigned)BANK_GetActiveBank(),
+        (unsigned)SIM_FLASH_GetBfb2(),
+        (unsigned)ImageVersionAt(IMAGE_BEGIN),
+        (unsigned)ImageVersionAt(IMAGE_BEGIN + INACTIVE_OFFSET));
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+int main(void)
+{
+    CHECK(SIM_FLASH_Init());
+    SIM_FLASH_SetResetPoint(&f_resetPoint);
+
+    if (setjmp(f_resetPoint) != 0)
+    {
+        PrintState("Reset:");
+    }
+
+    switch (f_step)
+    {
+    case 0U:
+        ProgramBootloader();
+        ProgramImage(IMAGE_BEGIN, 1U);
+        PrintState("Factory state:");
+
+        StageInactive(2U);
+        CHECK(ImageVersionAt(IMAGE_BEGIN + INACTIVE_OFFSET) == 2U);
+        CHECK(BANK_SyncBootloader());
+        CHECK(0 == memcmp(SIM_FLASH_PhysicalBank(BANK_1), SIM_FLASH_PhysicalBank(BANK_2), BOOTLOADER_SIZE));
+        PrintState("Staged v2:");
+
+        f_step = 1U;
+        (void)BANK_ActivateInactive();
+        CHECK(false);
+        break;
+
+    case 1U:
+        CHECK(BANK_GetActiveBank() == BANK_2);
+        CHECK(ImageVersionAt(IMAGE_BEGIN) == 2U);
+        CHECK(ImageVersionAt(IMAGE_BEGIN + INACTIVE_OFFSET) == 1U);
+
+        /* Damage the bootloader copy in bank 1, now mapped as inactive. The
+           repair must erase physical bank 1 sectors, not the running ones. */
+        HAL_FLASH_Unlock();
+        CHECK(HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, BOOTLOADER_BEGIN + INACTIVE_OFFSET, 0U) == HAL_OK);
+        HAL_FLASH_Lock();
+        CHECK(BANK_SyncBootloader());
+        CHECK(0 == memcmp(SIM_FLASH_PhysicalBank(BANK_1), SIM_FLASH_PhysicalBank(BANK_2), BOOTLOADER_SIZE));
+        CHECK(ImageVersionAt(IMAGE_BEGIN) == 2U);
+
+        f_step = 2U;
+        (void)BANK_ActivateInactive();
+        CHECK(false);
+        break;
+
+    case 2U:
+        CHECK(BANK_GetActiveBank() == BANK_1);
+        CHECK(ImageVersionAt(IMAGE_BEGIN) == 1U);
+        CHECK(ImageVersionAt(IMAGE_BEGIN + INACTIVE_OFFSET) == 2U);
+        break;
+
+    default:
+        CHECK(false);
+        break;
+    }
+
+    const SimFlashStats_t stats = SIM_FLASH_GetStats();
+    printf("Rolled back. %u sector erases, %u bytes programmed, %u resets\r\n",
+        (unsigned)stats.sectorErases,
+        (unsigned)stats.bytesProgrammed,
+        (unsigned)stats.resets);
+    printf("PASS\r\n");
+    return 0;
+}
+
+/* EoF bank_sim.c */
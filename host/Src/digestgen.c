@@ -0,0 +1,435 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * digestgen.c
+ *
+ * @brief Post-build tool filling the segment digest table of an application
+ *        HEX file. Run before hexsign so the firmware signature covers the
+ *        table. Only data bytes of the table records change.
+ * 
+ *        digestgen -i app.hex -o app_digests.hex
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "digest_table.h"
+#include "sha512.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define FLASH_BASE          (0x08000000UL)
+#define FLASH_SIZE          (0x00200000UL)
+#define MAX_LINE            (600U)
+
+#define HEX_TYPE_DATA       (0x00U)
+#define HEX_TYPE_EOF        (0x01U)
+#define HEX_TYPE_EXT_SEG    (0x02U)
+#define HEX_TYPE_EXT_LIN    (0x04U)
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint8_t  len;
+    uint16_t offset;
+    uint8_t  type;
+    uint8_t  data[255];
+} HexRecord_t;
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static uint8_t f_image[FLASH_SIZE];
+static uint32_t f_lowest = FLASH_BASE + FLASH_SIZE;
+static uint32_t f_highest = FLASH_BASE;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static int HexNibble(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return c - '0';
+    }
+    if ((c >= 'A') && (c <= 'F'))
+    {
+        return c - 'A' + 10;
+    }
+    if ((c >= 'a') && (c <= 'f'))
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static bool HexByte(const char* s, uint8_t* out)
+{
+    const int hi = HexNibble(s[0]);
+    const int lo = HexNibble(s[1]);
+
+    if ((hi < 0) || (lo < 0))
+    {
+        return false;
+    }
+
+    *out = (uint8_t)((hi << 4) | lo);
+    return true;
+}
+
+static bool ParseRecord(const char* line, HexRecord_t* rec)
+{
+    uint8_t hdr[4];
+    uint8_t sum = 0U;
+
+    if (line[0] != ':')
+    {
+        return false;
+    }
+
+    for (size_t i = 0U; i < 4U; i++)
+    {
+        if (!HexByte(&line[1U + (2U * i)], &hdr[i]))
+        {
+            return false;
+        }
+        sum += hdr[i];
+    }
+
+    rec->len = hdr[0];
+    rec->offset = (uint16_t)((hdr[1] << 8) | hdr[2]);
+    rec->type = hdr[3];
+
+    if (strlen(line) < (11U + (2U * rec->len)))
+    {
+        return false;
+    }
+
+    for (size_t i = 0U; i < rec->len; i++)
+    {
+        if (!HexByte(&line[9U + (2U * i)], &rec->data[i]))
+        {
+            return false;
+        }
+        sum += rec->data[i];
+    }
+
+    uint8_t check;
+    if (!HexByte(&line[9U + (2U * rec->len)], &check))
+    {
+        return false;
+    }
+
+    return (uint8_t)(sum + check) == 0U;
+}
+
+static void WriteRecord(FILE* out, const HexRecord_t* rec)
+{
+    uint8_t sum = rec->len + (uint8_t)(rec->offset >> 8) + (uint8_t)rec->offset + rec->type;
+
+    fprintf(out, ":%02X%04X%02X", rec->len, rec->offset, rec->type);
+    for (size_t i = 0U; i < rec->len; i++)
+    {
+        fprintf(out, "%02X", rec->data[i]);
+        sum += rec->data[i];
+    }
+    fprintf(out, "%02X\n", (uint8_t)(0x100U - sum));
+}
+
+static uint32_t BaseAddress(const HexRecord_t* rec, uint32_t current)
+{
+    if (rec->type == HEX_TYPE_EXT_LIN)
+    {
+        return ((uint32_t)rec->data[0] << 24) | ((uint32_t)rec->data[1] << 16);
+    }
+
+    if (rec->type == HEX_TYPE_EXT_SEG)
+    {
+        return (((uint32_t)rec->data[0] << 8) | rec->data[1]) << 4;
+    }
+
+    return current;
+}
+
+static bool InFlash(uint32_t address, size_t len)
+{
+    return (address >= FLASH_BASE) && ((address + len) <= (FLASH_BASE + FLASH_SIZE));
+}
+
+static bool LoadHex(FILE* in)
+{
+    char line[MAX_LINE];
+    uint32_t base = 0U;
+    HexRecord_t rec;
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '\0')
+        {
+            continue;
+        }
+
+        if (!ParseRecord(line, &rec))
+        {
+            fprintf(stderr, "Invalid record: %s\n", line);
+            return false;
+        }
+
+        base = BaseAddress(&rec, base);
+
+        if (rec.type == HEX_TYPE_DATA)
+        {
+            const uint32_t address = base + rec.offset;
+
+            if (!InFlash(address, rec.len))
+            {
+                fprintf(stderr, "Data outside flash at %08X\n", (unsigned)address);
+                return false;
+            }
+
+            memcpy(&f_image[address - FLASH_BASE], rec.data, rec.len);
+
+            if (address < f_lowest)
+            {
+                f_lowest = address;
+            }
+            if ((address + rec.len) > f_highest)
+            {
+                f_highest = address + rec.len;
+            }
+        }
+    }
+
+    return f_highest > f_lowest;
+}
+
+static bool WriteHex(FILE* in, FILE* out)
+{
+    char line[MAX_LINE];
+    uint32_t base = 0U;
+    HexRecord_t rec;
+
+    rewind(in);
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '\0')
+        {
+            continue;
+        }
+
+        if (!ParseRecord(line, &rec))
+        {
+            return false;
+        }
+
+        base = BaseAddress(&rec, base);
+
+        if (rec.type == HEX_TYPE_DATA)
+        {
+            const uint32_t address = base + rec.offset;
+            memcpy(rec.data, &f_image[address - FLASH_BASE], rec.len);
+        }
+
+        WriteRecord(out, &rec);
+    }
+
+    return true;
+}
+
+static uint8_t* ImageAt(uint32_t address)
+{
+    return &f_image[address - FLASH_BASE];
+}
+
+static DigestTable_t* FindTable(void)
+{
+    /* The bootloader finds the table at the end of the image */
+    const uint32_t address = f_highest - (uint32_t)sizeof(DigestTable_t);
+
+    if ((address < f_lowest) || ((address % 4U) != 0U))
+    {
+        return NULL;
+    }
+
+    DigestTable_t* table = (DigestTable_t*)ImageAt(address);
+
+    if ((table->magic != DIGEST_TABLE_MAGIC) ||
+        (table->segmentSize != DIGEST_SEGMENT_SIZE) ||
+        (table->imageStart < table->baseAddress) ||
+        (table->imageStart > address) ||
+        !InFlash(table->baseAddress, 0U))
+    {
+        return NULL;
+    }
+
+    return table;
+}
+
+static bool FillTable(DigestTable_t* table, uint32_t tableAddress)
+{
+    const uint32_t span = tableAddress - table->baseAddress;
+    const uint32_t count = (span + table->segmentSize - 1U) / table->segmentSize;
+
+    if (count > DIGEST_TABLE_MAX_SEGMENTS)
+    {
+        fprintf(stderr, "Image needs %u segments, table holds %u\n",
+            (unsigned)count, (unsigned)DIGEST_TABLE_MAX_SEGMENTS);
+        return false;
+    }
+
+    table->segmentCount = count;
+    memset(table->digest, 0, sizeof(table->digest));
+
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        uint32_t start = table->baseAddress + (i * table->segmentSize);
+        uint32_t end = start + table->segmentSize;
+        uint8_t hash[64];
+
+        start = (start < table->imageStart) ? table->imageStart : start;
+        end = (end > tableAddress) ? tableAddress : end;
+
+        if (end <= start)
+        {
+            continue;
+        }
+
+        (void)sha512(ImageAt(start), end - start, hash);
+        memcpy(table->digest[i], hash, DIGEST_SIZE);
+    }
+
+    return true;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "Usage: digestgen -i <input.hex> -o <output.hex>\n");
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv)
+{
+    const char* inPath = NULL;
+    const char* outPath = NULL;
+
+    for (int i = 1; i < (argc - 1); i++)
+    {
+        if (0 == strcmp(argv[i], "-i"))
+        {
+            inPath = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "-o"))
+        {
+            outPath = argv[++i];
+        }
+    }
+
+    if ((inPath == NULL) || (outPath == NULL))
+    {
+        Usage();
+        return 1;
+    }
+
+    FILE* in = fopen(inPath, "r");
+    if (in == NULL)
+    {
+        perror(inPath);
+        return 1;
+    }
+
+    memset(f_image, 0xFF, sizeof(f_image));
+
+    if (!LoadHex(in))
+    {
+        fprintf(stderr, "No image data in %s\n", inPath);
+        fclose(in);
+        return 1;
+    }
+
+    DigestTable_t* table = FindTable();
+    if (table == NULL)
+    {
+        fprintf(stderr, "Digest table is not the last data of the image\n");
+        fclose(in);
+        return 1;
+    }
+
+    const uint32_t tableAddress = f_highest - (uint32_t)sizeof(DigestTable_t);
+
+    if (!FillTable(table, tableAddress))
+    {
+        fclose(in);
+        return 1;
+    }
+
+    FILE* out = fopen(outPath, "w");
+    if (out == NULL)
+    {
+        perror(outPath);
+        fclose(in);
+        return 1;
+    }
+
+    const bool ok = WriteHex(in, out);
+    fclose(in);
+    fclose(out);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Writing %s failed\n", outPath);
+        return 1;
+    }
+
+    printf("Digest table at %08X: %u segments of %u bytes from %08X\n",
+        (unsigned)tableAddress,
+        (unsigned)table->segmentCount,
+        (unsigned)table->segmentSize,
+        (unsigned)table->imageStart);
+
+    return 0;
+}
+
+/* EoF digestgen.c */
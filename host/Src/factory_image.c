@@ -0,0 +1,457 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * factory_image.c
+ *
+ * @brief Offline builder of a complete W25Q128 image for factory
+ *        provisioning. Signed update bundles are stored through the same
+ *        slot allocation, fragment store, fragment index and command area
+ *        code the update server runs, on an in-memory W25Q128, and the
+ *        16 MB result is written for a gang programmer. Optionally one
+ *        bundle gets an install command, so a board with only the
+ *        bootloader programmed installs the application at first boot.
+ * 
+ *        factory_image -o w25q128.bin -b app.bundle [-b rescue.bundle] [-I 0]
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "flash_scheduler.h"
+#include "fragment_index.h"
+#include "generated_public_key.h"
+#include "partition_table.h"
+#include "slot_alloc.h"
+#include "update_bundle.h"
+#include "w25q_sim.h"
+
+#include "crc/crc32.h"
+#include "ed25519.h"
+#include "fragmentstore/command.h"
+#include "fragmentstore/default_app_types.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    const char* path;
+    const uint8_t* file;
+    size_t size;
+    const UpdateBundleHeader_t* hdr;
+    const Metadata_t* metadata;
+    uint32_t slot;
+} Bundle_t;
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static Bundle_t f_bundle[PARTITION_MAX_SLOTS];
+static uint32_t f_bundleCount = 0U;
+static PartitionTable_t f_table;
+static FragmentArea_t f_fa[PARTITION_MAX_SLOTS];
+static MemoryConfig_t f_slotConf[PARTITION_MAX_SLOTS];
+static Fragment_t f_readBack;
+static Metadata_t f_metaBack;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/* Same checks as the update server, bundles hold verifyMethod 0 fragments */
+static bool ValidateFragment(const Fragment_t* frag)
+{
+    return (0U == frag->verifyMethod) &&
+           (1 == ed25519_verify(
+               frag->signature,
+               (const uint8_t*)frag,
+               sizeof(Fragment_t) - sizeof(frag->signature),
+               generated_public_key));
+}
+
+static bool ValidateMetadata(const Metadata_t* metadata)
+{
+    return 1 == ed25519_verify(
+        metadata->metadataSignature,
+        (const uint8_t*)metadata,
+        sizeof(Metadata_t) - sizeof(metadata->metadataSignature),
+        generated_public_key);
+}
+
+static bool MapBundle(Bundle_t* b)
+{
+    struct stat st;
+    const int fd = open(b->path, O_RDONLY);
+
+    if ((fd < 0) || (fstat(fd, &st) != 0))
+    {
+        perror(b->path);
+        return false;
+    }
+
+    b->size = (size_t)st.st_size;
+    b->file = mmap(NULL, b->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (b->file == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+
+    b->hdr = UPDATE_BUNDLE_Check(b->file, b->size);
+    if (b->hdr == NULL)
+    {
+        fprintf(stderr, "%s is not a version %u bundle of this build\n", b->path, (unsigned)UPDATE_BUNDLE_VERSION);
+        return false;
+    }
+
+    b->metadata = UPDATE_BUNDLE_Metadata(b->file);
+    if (!ValidateMetadata(b->metadata))
+    {
+        fprintf(stderr, "%s: metadata signature does not verify\n", b->path);
+        return false;
+    }
+
+    return true;
+}
+
+/** Bind the fragment area of a slot, as ConfigureSlot of the server */
+static bool ConfigureSlot(uint32_t slot)
+{
+    f_slotConf[slot] = (MemoryConfig_t) {
+        .baseAddress = f_table.slots[slot].address,
+        .sectorSize = PARTITION_SECTOR_SIZE,
+        .memorySize = f_table.slots[slot].size,
+        .eraseValue = 0xFF,
+
+        .Reader = FLASH_SCHED_Read,
+        .Writer = FLASH_SCHED_Write,
+        .Eraser = FLASH_SCHED_Erase,
+    };
+
+    return FA_ERR_OK == FA_InitStruct(&f_fa[slot], &f_slotConf[slot], ValidateFragment, ValidateMetadata);
+}
+
+/** Allocate a slot for every bundle. Earlier slots are protected, so a
+ *  later bundle never evicts one.
+ */
+static bool AllocateSlots(void)
+{
+    uint32_t protectMask = 0U;
+
+    memset(&f_table, 0, sizeof(f_table));
+    f_table.magic = PARTITION_MAGIC;
+
+    for (uint32_t i = 0U; i < f_bundleCount; i++)
+    {
+        Bundle_t* b = &f_bundle[i];
+        uint32_t evictedMask = 0U;
+
+        if (!SLOT_ALLOC_Allocate(&f_table, PARTITION_SlotSizeFor(b->metadata->firmwareSize),
+                                 protectMask, &b->slot, &evictedMask) ||
+            (evictedMask != 0U))
+        {
+            fprintf(stderr, "No room for %s\n", b->path);
+            return false;
+        }
+
+        protectMask |= (1UL << b->slot);
+    }
+
+    /* Both copies hold the final layout */
+    for (uint32_t i = 0U; i < PARTITION_TABLE_COPIES; i++)
+    {
+        if (!SLOT_ALLOC_Store(&f_table))
+        {
+            fprintf(stderr, "Writing the partition table failed\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Store one bundle the way PutMetadata and PutFragment of the server do */
+static bool StoreBundle(const Bundle_t* b)
+{
+    const uint32_t slot = b->slot;
+
+    if (!ConfigureSlot(slot) ||
+        !FLASH_SCHED_Erase(FRAGMENT_INDEX_AreaAddress(slot), FRAGMENT_INDEX_SLOT_SIZE) ||
+        (FA_ERR_OK != FA_EraseArea(&f_fa[slot])) ||
+        (FA_ERR_OK != FA_WriteMetadata(&f_fa[slot], b->metadata)))
+    {
+        fprintf(stderr, "%s: writing metadata to slot %u failed\n", b->path, (unsigned)slot);
+        return false;
+    }
+
+    for (uint32_t n = 0U; n < b->hdr->fragmentCount; n++)
+    {
+        /* Fragments go from the mapped bundle straight to the store */
+        const Fragment_t* frag = UPDATE_BUNDLE_Fragment(b->file, n);
+        FragmentIndexEntry_t entry;
+
+        if ((frag->firmwareId != b->metadata->firmwareId) || (frag->number != n) ||
+            (FA_ERR_OK != FA_WriteFragment(&f_fa[slot], n, frag)))
+        {
+            fprintf(stderr, "%s: fragment %u rejected\n", b->path, (unsigned)n);
+            return false;
+        }
+
+        if (n < FRAGMENT_INDEX_MAX_ENTRIES)
+        {
+            FRAGMENT_INDEX_MakeEntry(&entry, frag->firmwareId, frag->number, frag->startAddress, frag->size, frag->sha512);
+
+            if (!FLASH_SCHED_Write(FRAGMENT_INDEX_EntryAddress(slot, n), (const uint8_t*)&entry, sizeof(entry)))
+            {
+                fprintf(stderr, "%s: indexing fragment %u failed\n", b->path, (unsigned)n);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/** Read everything back through the fragment store, signatures included */
+static bool VerifyImage(void)
+{
+    PartitionTable_t table;
+
+    if (!PARTITION_Read(FLASH_SCHED_Read, &table) || (0 != memcmp(&table.slots, &f_table.slots, sizeof(table.slots))))
+    {
+        fprintf(stderr, "Partition table does not read back\n");
+        return false;
+    }
+
+    for (uint32_t i = 0U; i < f_bundleCount; i++)
+    {
+        const Bundle_t* b = &f_bundle[i];
+        FragmentArea_t* fa = &f_fa[b->slot];
+
+        if ((FA_ERR_OK != FA_ReadMetadata(fa, &f_metaBack)) ||
+            (0 != memcmp(&f_metaBack, b->metadata, sizeof(Metadata_t))))
+        {
+            fprintf(stderr, "%s: metadata does not read back\n", b->path);
+            return false;
+        }
+
+        for (uint32_t n = 0U; n < b->hdr->fragmentCount; n++)
+        {
+            FragmentIndexEntry_t entry;
+
+            if ((FA_ERR_OK != FA_ReadFragment(fa, n, &f_readBack)) ||
+                (0 != memcmp(&f_readBack, UPDATE_BUNDLE_Fragment(b->file, n), sizeof(Fragment_t))) ||
+                ((n < FRAGMENT_INDEX_MAX_ENTRIES) &&
+                 !FRAGMENT_INDEX_Lookup(FLASH_SCHED_Read, b->slot, b->metadata->firmwareId, n, &entry)))
+            {
+                fprintf(stderr, "%s: fragment %u does not read back\n", b->path, (unsigned)n);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool WriteInstallCommand(const Bundle_t* b)
+{
+    static const MemoryConfig_t caConf = {
+        .baseAddress = PARTITION_COMMAND_AREA_ADDRESS,
+        .sectorSize = PARTITION_SECTOR_SIZE,
+        .memorySize = PARTITION_COMMAND_AREA_SIZE,
+        .eraseValue = 0xFF,
+
+        .Reader = FLASH_SCHED_Read,
+        .Writer = FLASH_SCHED_WriteAndVerify,
+        .Eraser = FLASH_SCHED_Erase,
+    };
+    static CommandArea_t ca;
+
+    return CA_InitStruct(&ca, &caConf, &CRC32_Calculate) &&
+           CA_WriteInstallCommand(&ca, COMMAND_TYPE_INSTALL_FIRMWARE, b->metadata);
+}
+
+static bool WriteImage(const char* path)
+{
+    FILE* f = fopen(path, "wb");
+
+    if ((f == NULL) || (fwrite(W25Q_SIM_Memory(), 1U, W25Q_SIM_SIZE, f) != W25Q_SIM_SIZE))
+    {
+        perror(path);
+        if (f != NULL)
+        {
+            fclose(f);
+        }
+        return false;
+    }
+
+    return fclose(f) == 0;
+}
+
+/** Count the pages a programmer has to write, blank pages are skipped */
+static uint32_t UsedPages(void)
+{
+    const uint8_t* mem = W25Q_SIM_Memory();
+    uint32_t pages = 0U;
+
+    for (uint32_t page = 0U; page < W25Q_SIM_SIZE; page += W25Q_SIM_PAGE_SIZE)
+    {
+        for (uint32_t i = 0U; i < W25Q_SIM_PAGE_SIZE; i++)
+        {
+            if (mem[page + i] != 0xFFU)
+            {
+                pages++;
+                break;
+            }
+        }
+    }
+
+    return pages;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "Usage: factory_image -o <w25q128.bin> -b <bundle> [-b <bundle> ...] [-I <n>]\n");
+    fprintf(stderr, "  -o  Output image, %u bytes\n", (unsigned)W25Q_SIM_SIZE);
+    fprintf(stderr, "  -b  Signed update bundle, one slot each in the given order\n");
+    fprintf(stderr, "  -I  Install command for bundle n, counted from 0\n");
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv)
+{
+    const char* outPath = NULL;
+    long install = -1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((0 == strcmp(argv[i], "-o")) && ((i + 1) < argc))
+        {
+            outPath = argv[++i];
+        }
+        else if ((0 == strcmp(argv[i], "-b")) && ((i + 1) < argc) && (f_bundleCount < PARTITION_MAX_SLOTS))
+        {
+            f_bundle[f_bundleCount++].path = argv[++i];
+        }
+        else if ((0 == strcmp(argv[i], "-I")) && ((i + 1) < argc))
+        {
+            install = strtol(argv[++i], NULL, 10);
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if ((outPath == NULL) || (f_bundleCount == 0U) || (install >= (long)f_bundleCount))
+    {
+        Usage();
+        return 1;
+    }
+
+    for (uint32_t i = 0U; i < f_bundleCount; i++)
+    {
+        if (!MapBundle(&f_bundle[i]))
+        {
+            return 1;
+        }
+
+        /* The server finds a slot by the firmware id */
+        for (uint32_t j = 0U; j < i; j++)
+        {
+            if (f_bundle[j].metadata->firmwareId == f_bundle[i].metadata->firmwareId)
+            {
+                fprintf(stderr, "%s and %s hold the same firmware\n", f_bundle[j].path, f_bundle[i].path);
+                return 1;
+            }
+        }
+    }
+
+    if (!W25Q_SIM_Open(NULL))
+    {
+        return 1;
+    }
+
+    (void)FLASH_SCHED_Init();
+
+    bool ok = AllocateSlots();
+
+    for (uint32_t i = 0U; ok && (i < f_bundleCount); i++)
+    {
+        ok = StoreBundle(&f_bundle[i]);
+    }
+
+    if (ok && (install >= 0) && !WriteInstallCommand(&f_bundle[install]))
+    {
+        fprintf(stderr, "Writing the install command failed\n");
+        ok = false;
+    }
+
+    ok = ok && VerifyImage() && WriteImage(outPath);
+
+    if (ok)
+    {
+        for (uint32_t i = 0U; i < f_bundleCount; i++)
+        {
+            const Bundle_t* b = &f_bundle[i];
+            printf("Slot %u at %08X, %u KB: %s %08X v%u, %u fragments%s\n",
+                (unsigned)b->slot,
+                (unsigned)f_table.slots[b->slot].address,
+                (unsigned)(f_table.slots[b->slot].size / 1024U),
+                (b->metadata->type == DEFAULT_APP_TYPE_RESCUE) ? "rescue" : "firmware",
+                (unsigned)b->metadata->firmwareId,
+                (unsigned)b->metadata->version,
+                (unsigned)b->hdr->fragmentCount,
+                ((long)i == install) ? ", install at first boot" : "");
+        }
+
+        printf("Image %s: CRC32 %08X, %u of %u pages programmed\n",
+            outPath,
+            (unsigned)CRC32_Calculate(W25Q_SIM_Memory(), W25Q_SIM_SIZE),
+            (unsigned)UsedPages(),
+            (unsigned)(W25Q_SIM_SIZE / W25Q_SIM_PAGE_SIZE));
+    }
+
+    W25Q_SIM_Close();
+    return ok ? 0 : 1;
+}
+
+/* EoF factory_image.c */
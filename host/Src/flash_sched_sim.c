@@ -0,0 +1,204 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * flash_sched_sim.c
+ *
+ * @brief Host replacement of the application W25Q128 I/O scheduler. Requests
+ *        are executed directly on the simulated W25Q128. Erases skip blank
+ *        sectors and use 64 KB block erases like the target glue.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "flash_scheduler.h"
+#include "w25q_sim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define SECTOR_SIZE     (0x1000U)
+#define BLOCK_SIZE      (0x10000U)
+
+/* Dirty sectors of a block that make a block erase cheaper */
+#define BLOCK_ERASE_MIN (4U)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static FlashClassStats_t f_stats[FLASH_CLASS_COUNT];
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static bool SectorBlank(uint32_t address)
+{
+    const uint8_t* mem = W25Q_SIM_Memory();
+
+    for (uint32_t i = 0U; i < SECTOR_SIZE; i++)
+    {
+        if (mem[address + i] != 0xFFU)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+bool FLASH_SCHED_Init(void)
+{
+    memset(f_stats, 0, sizeof(f_stats));
+    return W25Q_SIM_Memory() != NULL;
+}
+
+bool FLASH_SCHED_Read(uint32_t address, uint8_t* data, size_t size)
+{
+    f_stats[FLASH_CLASS_CRITICAL].requests++;
+    return W25Q_SIM_Read(address, data, size);
+}
+
+bool FLASH_SCHED_Write(uint32_t address, const uint8_t* data, size_t size)
+{
+    f_stats[FLASH_CLASS_NORMAL].requests++;
+    return W25Q_SIM_Program(address, data, size);
+}
+
+bool FLASH_SCHED_WriteAndVerify(uint32_t address, const uint8_t* data, size_t size)
+{
+    f_stats[FLASH_CLASS_NORMAL].requests++;
+
+    if (!W25Q_SIM_Program(address, data, size))
+    {
+        return false;
+    }
+
+    /* Read back through the simulated SPI so verify time is counted */
+    uint8_t buf[256];
+    size_t done = 0U;
+
+    while (done < size)
+    {
+        const size_t len = ((size - done) < sizeof(buf)) ? (size - done) : sizeof(buf);
+
+        if (!W25Q_SIM_Read(address + (uint32_t)done, buf, len) ||
+            (0 != memcmp(buf, &data[done], len)))
+        {
+            return false;
+        }
+
+        done += len;
+    }
+
+    return true;
+}
+
+bool FLASH_SCHED_Erase(uint32_t address, size_t size)
+{
+    f_stats[FLASH_CLASS_BACKGROUND].requests++;
+
+    if (((address % SECTOR_SIZE) != 0U) || ((size % SECTOR_SIZE) != 0U) ||
+        (size > W25Q_SIM_SIZE) || (address > (W25Q_SIM_SIZE - size)))
+    {
+        return false;
+    }
+
+    const uint32_t end = address + (uint32_t)size;
+
+    while (address < end)
+    {
+        const uint32_t blockEnd = (address & ~(BLOCK_SIZE - 1U)) + BLOCK_SIZE;
+        const uint32_t spanEnd = (blockEnd < end) ? blockEnd : end;
+        uint32_t dirty = 0U;
+
+        for (uint32_t s = address; s < spanEnd; s += SECTOR_SIZE)
+        {
+            dirty += SectorBlank(s) ? 0U : 1U;
+        }
+
+        if (((address % BLOCK_SIZE) == 0U) && (spanEnd == blockEnd) && (dirty >= BLOCK_ERASE_MIN))
+        {
+            if (!W25Q_SIM_EraseBlock(address, BLOCK_SIZE))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            for (uint32_t s = address; s < spanEnd; s += SECTOR_SIZE)
+            {
+                if (!SectorBlank(s) && !W25Q_SIM_EraseBlock(s, SECTOR_SIZE))
+                {
+                    return false;
+                }
+            }
+        }
+
+        address = spanEnd;
+    }
+
+    return true;
+}
+
+bool FLASH_SCHED_GetStats(FlashClass_t cls, FlashClassStats_t* out)
+{
+    if (cls >= FLASH_CLASS_COUNT)
+    {
+        return false;
+    }
+
+    *out = f_stats[cls];
+    return true;
+}
+
+void FLASH_SCHED_PrintStats(void)
+{
+    const W25qSimStats_t s = W25Q_SIM_GetStats();
+
+    printf("Flash %u reads, %u programs, %u erases, %llu bytes read, %llu bytes programmed\r\n",
+        (unsigned)f_stats[FLASH_CLASS_CRITICAL].requests,
+        (unsigned)f_stats[FLASH_CLASS_NORMAL].requests,
+        (unsigned)f_stats[FLASH_CLASS_BACKGROUND].requests,
+        (unsigned long long)s.bytesRead,
+        (unsigned long long)s.bytesProgrammed);
+    printf("W25Q %u page programs, %u/%u/%u 4K/32K/64K erases, %llu ms busy\r\n",
+        (unsigned)s.pagePrograms,
+        (unsigned)s.erases4k,
+        (unsigned)s.erases32k,
+        (unsigned)s.erases64k,
+        (unsigned long long)(s.busyUs / 1000U));
+}
+
+/* EoF flash_sched_sim.c */
@@ -0,0 +1,324 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * flash_sim.c
+ *
+ * @brief Simulated STM32F439 dual bank internal flash. Each physical bank is a
+ *        memfd. The bank selected by BFB2 at reset is mapped at 0x08000000 and
+ *        the other one at 0x08100000, like the UFB_MODE remap of the device.
+ *        Erase and program times are modeled with the typical values of the
+ *        STM32F439 datasheet at x32 parallelism.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "flash_sim.h"
+#include "bank.h"
+#include "stm32f4xx_hal.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define ERASE_VALUE (0xFFU)
+
+#define ERASE_16K_US        (250000U)
+#define ERASE_64K_US        (550000U)
+#define ERASE_128K_US       (1000000U)
+#define PROGRAM_US          (16U)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+SYSCFG_TypeDef SIM_SYSCFG;
+
+/* Sector sizes of one bank, sector 0 first */
+static const uint32_t f_sectorSize[BANK_SECTORS_PER_BANK] = {
+    0x4000U, 0x4000U, 0x4000U, 0x4000U, 0x10000U,
+    0x20000U, 0x20000U, 0x20000U, 0x20000U, 0x20000U, 0x20000U, 0x20000U
+};
+
+static int f_bankFd[2] = {-1, -1};
+static uint8_t* f_bankPhys[2] = {NULL, NULL};
+static bool f_locked = true;
+static bool f_obLocked = true;
+static bool f_bfb2 = false;
+static uint8_t f_bfb2Pending = OB_DUAL_BOOT_DISABLE;
+static jmp_buf* f_resetPoint = NULL;
+static SimFlashStats_t f_stats;
+static uint32_t f_powerCutIn = 0U;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static bool MapBanks(void)
+{
+    const uint32_t active = f_bfb2 ? 1U : 0U;
+    void* lo = mmap((void*)(uintptr_t)SIM_FLASH_BASE, SIM_FLASH_BANK_SIZE,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, f_bankFd[active], 0);
+    void* hi = mmap((void*)(uintptr_t)(SIM_FLASH_BASE + SIM_FLASH_BANK_SIZE), SIM_FLASH_BANK_SIZE,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, f_bankFd[1U - active], 0);
+
+    if ((lo == MAP_FAILED) || (hi == MAP_FAILED))
+    {
+        perror("mmap");
+        return false;
+    }
+
+    SIM_SYSCFG.MEMRMP = f_bfb2 ? SYSCFG_MEMRMP_UFB_MODE : 0U;
+    return true;
+}
+
+static uint32_t SectorOffset(uint32_t sector)
+{
+    uint32_t offset = 0U;
+    for (uint32_t i = 0U; i < sector; i++)
+    {
+        offset += f_sectorSize[i];
+    }
+    return offset;
+}
+
+static uint64_t EraseTimeUs(uint32_t sectorSize)
+{
+    if (sectorSize <= 0x4000U)
+    {
+        return ERASE_16K_US;
+    }
+    if (sectorSize <= 0x10000U)
+    {
+        return ERASE_64K_US;
+    }
+    return ERASE_128K_US;
+}
+
+/** Count one erase or program operation against the power cut */
+static void PowerCutCheck(void)
+{
+    if (f_powerCutIn == 0U)
+    {
+        return;
+    }
+
+    if (--f_powerCutIn == 0U)
+    {
+        f_stats.powerCuts++;
+        f_locked = true;
+
+        if (!MapBanks() || (f_resetPoint == NULL))
+        {
+            _exit(1);
+        }
+
+        longjmp(*f_resetPoint, 1);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+bool SIM_FLASH_Init(void)
+{
+    for (uint32_t i = 0U; i < 2U; i++)
+    {
+        f_bankFd[i] = memfd_create(i == 0U ? "flash_bank1" : "flash_bank2", 0);
+        if ((f_bankFd[i] < 0) || (ftruncate(f_bankFd[i], SIM_FLASH_BANK_SIZE) != 0))
+        {
+            perror("memfd");
+            return false;
+        }
+
+        f_bankPhys[i] = mmap(NULL, SIM_FLASH_BANK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, f_bankFd[i], 0);
+        if (f_bankPhys[i] == MAP_FAILED)
+        {
+            perror("mmap");
+            return false;
+        }
+
+        memset(f_bankPhys[i], ERASE_VALUE, SIM_FLASH_BANK_SIZE);
+    }
+
+    f_bfb2 = false;
+    memset(&f_stats, 0, sizeof(f_stats));
+    return MapBanks();
+}
+
+void SIM_FLASH_SetResetPoint(jmp_buf* env)
+{
+    f_resetPoint = env;
+}
+
+void SIM_FLASH_SetPowerCut(uint32_t operations)
+{
+    f_powerCutIn = operations;
+}
+
+uint8_t* SIM_FLASH_PhysicalBank(uint32_t bank)
+{
+    return f_bankPhys[(bank == BANK_2) ? 1U : 0U];
+}
+
+bool SIM_FLASH_GetBfb2(void)
+{
+    return f_bfb2;
+}
+
+SimFlashStats_t SIM_FLASH_GetStats(void)
+{
+    return f_stats;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    f_locked = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    f_locked = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Unlock(void)
+{
+    f_obLocked = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Lock(void)
+{
+    f_obLocked = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Launch(void)
+{
+    if (f_obLocked)
+    {
+        return HAL_ERROR;
+    }
+
+    f_bfb2 = (f_bfb2Pending == OB_DUAL_BOOT_ENABLE);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_AdvOBProgram(FLASH_AdvOBProgramInitTypeDef* pAdvOBInit)
+{
+    if (f_obLocked || (pAdvOBInit->OptionType != OPTIONBYTE_BOOTCONFIG))
+    {
+        return HAL_ERROR;
+    }
+
+    f_bfb2Pending = pAdvOBInit->BootConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError)
+{
+    *SectorError = 0xFFFFFFFFU;
+
+    if (f_locked || (pEraseInit->TypeErase != FLASH_TYPEERASE_SECTORS))
+    {
+        return HAL_ERROR;
+    }
+
+    for (uint32_t s = pEraseInit->Sector; s < (pEraseInit->Sector + pEraseInit->NbSectors); s++)
+    {
+        if (s >= FLASH_SECTOR_TOTAL)
+        {
+            *SectorError = s;
+            return HAL_ERROR;
+        }
+
+        PowerCutCheck();
+
+        /* Erase addresses physical sectors, independent of the mapping */
+        const uint32_t bank = s / BANK_SECTORS_PER_BANK;
+        const uint32_t sec = s % BANK_SECTORS_PER_BANK;
+        memset(f_bankPhys[bank] + SectorOffset(sec), ERASE_VALUE, f_sectorSize[sec]);
+        f_stats.sectorErases++;
+        f_stats.eraseUs += EraseTimeUs(f_sectorSize[sec]);
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+    const uint32_t size = (TypeProgram == FLASH_TYPEPROGRAM_WORD) ? 4U :
+                          (TypeProgram == FLASH_TYPEPROGRAM_HALFWORD) ? 2U : 1U;
+
+    if (f_locked ||
+        (Address < SIM_FLASH_BASE) ||
+        ((Address + size) > (SIM_FLASH_BASE + 2U * SIM_FLASH_BANK_SIZE)) ||
+        ((Address % size) != 0U))
+    {
+        return HAL_ERROR;
+    }
+
+    PowerCutCheck();
+
+    /* Programming can only clear bits */
+    uint8_t* dst = (uint8_t*)(uintptr_t)Address;
+    for (uint32_t i = 0U; i < size; i++)
+    {
+        const uint8_t b = (uint8_t)(Data >> (8U * i));
+        if ((dst[i] & b) != b)
+        {
+            return HAL_ERROR;
+        }
+        dst[i] = b;
+    }
+
+    f_stats.bytesProgrammed += size;
+    f_stats.programUs += PROGRAM_US;
+    return HAL_OK;
+}
+
+void NVIC_SystemReset(void)
+{
+    f_stats.resets++;
+
+    if (!MapBanks() || (f_resetPoint == NULL))
+    {
+        _exit(1);
+    }
+
+    longjmp(*f_resetPoint, 1);
+}
+
+/* EoF flash_sim.c */
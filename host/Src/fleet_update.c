@@ -0,0 +1,718 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * fleet_update.c
+ *
+ * @brief Fleet rollout driver. Uploads one signed image to every device of a
+ *        list by running many updateclient sessions concurrently from one
+ *        epoll loop. Session starts are paced, failed sessions are retried
+ *        with exponential backoff and jitter, hung sessions are killed at a
+ *        timeout. The image is read once into a sealed memfd that every
+ *        session uploads read-only, so the whole fleet gets identical bytes
+ *        even if the file is replaced during the rollout. Progress is
+ *        printed on stderr, a JSON summary with session latencies on stdout.
+ * 
+ *        fleet_update -i app_signed.hex -l devices.txt [-c updateclient] [-j 64] [-P ms] [-r 3] [-b ms] [-t s]
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define MAX_LINE            (256U)
+#define MAX_ADDRESS         (64U)
+#define MAX_EVENTS          (64U)
+#define PROGRESS_MS         (1000U)
+
+/* Exit status of a session that could not exec the client */
+#define EXEC_FAILED         (127)
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef enum
+{
+    DEVICE_PENDING,
+    DEVICE_RUNNING,
+    DEVICE_DONE,
+    DEVICE_FAILED,
+} DeviceState_t;
+
+typedef struct
+{
+    char address[MAX_ADDRESS];
+    char port[8];
+    DeviceState_t state;
+    uint32_t attempts;
+    pid_t pid;
+    int pidfd;
+    bool timedOut;
+    uint64_t dueMs;             /* Earliest start of the next attempt */
+    uint64_t startMs;           /* Start of the running attempt */
+    uint64_t firstStartMs;      /* Start of the first attempt */
+    uint64_t sessionMs;         /* Duration of the successful attempt */
+    int lastStatus;             /* Exit status, -signal if killed */
+} Device_t;
+
+typedef struct
+{
+    const char* client;
+    const char* image;
+    const char* devices;
+    const char* results;
+    const char* port;
+    uint32_t concurrency;
+    uint32_t paceMs;
+    uint32_t retries;
+    uint32_t backoffMs;
+    uint32_t timeoutS;
+    uint32_t seed;
+    bool verbose;
+} FleetConfig_t;
+
+typedef struct
+{
+    uint32_t attempts;
+    uint32_t retries;
+    uint32_t timeouts;
+    uint32_t running;
+    uint32_t done;
+    uint32_t failed;
+    uint32_t peakRunning;
+} FleetStats_t;
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static FleetConfig_t f_conf = {
+    .client = "updateclient",
+    .image = NULL,
+    .devices = NULL,
+    .results = NULL,
+    .port = "7",
+    .concurrency = 64U,
+    .paceMs = 0U,
+    .retries = 3U,
+    .backoffMs = 1000U,
+    .timeoutS = 300U,
+    .seed = 1U,
+    .verbose = false,
+};
+
+static Device_t* f_device = NULL;
+static uint32_t f_deviceCount = 0U;
+static FleetStats_t f_stats;
+static char f_imagePath[32];
+static uint32_t f_rng;
+static uint64_t f_lastStartMs = 0U;
+static volatile sig_atomic_t f_stop = 0;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static uint64_t NowMs(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000U) + ((uint64_t)ts.tv_nsec / 1000000U);
+}
+
+/* xorshift32, the same sequence for the same seed */
+static uint32_t Random(void)
+{
+    f_rng ^= f_rng << 13;
+    f_rng ^= f_rng >> 17;
+    f_rng ^= f_rng << 5;
+    return f_rng;
+}
+
+static void Stop(int sig)
+{
+    (void)sig;
+    f_stop = 1;
+}
+
+/** Read the device list: "address [port]" per line, # starts a comment */
+static bool LoadDevices(const char* path)
+{
+    char line[MAX_LINE];
+    uint32_t capacity = 0U;
+    FILE* f = fopen(path, "r");
+
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char address[MAX_ADDRESS];
+        char port[8];
+
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        const int fields = sscanf(line, "%63s %7s", address, port);
+        if (fields < 1)
+        {
+            continue;
+        }
+
+        if (f_deviceCount == capacity)
+        {
+            capacity = (capacity == 0U) ? 256U : (2U * capacity);
+            Device_t* grown = realloc(f_device, capacity * sizeof(Device_t));
+            if (grown == NULL)
+            {
+                fclose(f);
+                return false;
+            }
+            f_device = grown;
+        }
+
+        Device_t* dev = &f_device[f_deviceCount++];
+        memset(dev, 0, sizeof(*dev));
+        (void)snprintf(dev->address, sizeof(dev->address), "%s", address);
+        (void)snprintf(dev->port, sizeof(dev->port), "%s", (fields == 2) ? port : f_conf.port);
+        dev->state = DEVICE_PENDING;
+        dev->pidfd = -1;
+    }
+
+    fclose(f);
+    return f_deviceCount > 0U;
+}
+
+/** Load the image once into a sealed memfd inherited by every session
+ * 
+ * @return true on success, f_imagePath names the memfd
+ */
+static bool LoadImage(const char* path)
+{
+    uint8_t chunk[4096];
+    size_t n;
+    FILE* in = fopen(path, "rb");
+    const int fd = memfd_create("fleet_image", MFD_ALLOW_SEALING);
+
+    if ((in == NULL) || (fd < 0))
+    {
+        perror(path);
+        if (in != NULL)
+        {
+            fclose(in);
+        }
+        return false;
+    }
+
+    while ((n = fread(chunk, 1U, sizeof(chunk), in)) > 0U)
+    {
+        if (write(fd, chunk, n) != (ssize_t)n)
+        {
+            perror("memfd");
+            fclose(in);
+            return false;
+        }
+    }
+
+    fclose(in);
+
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+    {
+        perror("memfd seal");
+        return false;
+    }
+
+    (void)snprintf(f_imagePath, sizeof(f_imagePath), "/dev/fd/%d", fd);
+    return true;
+}
+
+static void Start(int epfd, uint32_t index, uint64_t now)
+{
+    Device_t* dev = &f_device[index];
+    const pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        /* Own process group, a timeout kills the helpers of the client too */
+        (void)setpgid(0, 0);
+
+        if (!f_conf.verbose)
+        {
+            const int null = open("/dev/null", O_WRONLY);
+            (void)dup2(null, STDOUT_FILENO);
+            (void)dup2(null, STDERR_FILENO);
+        }
+
+        execlp(f_conf.client, f_conf.client, "-a", dev->address, "-p", dev->port, "upload", f_imagePath, (char*)NULL);
+        _exit(EXEC_FAILED);
+    }
+
+    dev->attempts++;
+    dev->startMs = now;
+    dev->timedOut = false;
+    f_stats.attempts++;
+    f_lastStartMs = now;
+
+    if (dev->attempts == 1U)
+    {
+        dev->firstStartMs = now;
+    }
+    else
+    {
+        f_stats.retries++;
+    }
+
+    const int pidfd = (pid > 0) ? (int)syscall(SYS_pidfd_open, pid, 0) : -1;
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.u32 = index,
+    };
+
+    if ((pidfd < 0) || (epoll_ctl(epfd, EPOLL_CTL_ADD, pidfd, &ev) != 0))
+    {
+        /* Counted as a failed attempt of the device */
+        perror("session");
+        if (pid > 0)
+        {
+            (void)kill(pid, SIGKILL);
+            (void)waitpid(pid, NULL, 0);
+        }
+        if (pidfd >= 0)
+        {
+            close(pidfd);
+        }
+        dev->pid = 0;
+        dev->pidfd = -1;
+        dev->lastStatus = -1;
+        dev->state = DEVICE_PENDING;
+        dev->dueMs = now + f_conf.backoffMs;
+        return;
+    }
+
+    dev->pid = pid;
+    dev->pidfd = pidfd;
+    dev->state = DEVICE_RUNNING;
+    f_stats.running++;
+    f_stats.peakRunning = (f_stats.running > f_stats.peakRunning) ? f_stats.running : f_stats.peakRunning;
+}
+
+/** Start due sessions within the concurrency and pacing limits
+ * 
+ * @return Milliseconds until the next start is possible, -1 if none pending
+ */
+static int LaunchDue(int epfd, uint64_t now)
+{
+    uint64_t nextDue = UINT64_MAX;
+
+    for (uint32_t i = 0U; (i < f_deviceCount) && !f_stop; i++)
+    {
+        Device_t* dev = &f_device[i];
+
+        if (dev->state != DEVICE_PENDING)
+        {
+            continue;
+        }
+
+        if (dev->dueMs > now)
+        {
+            nextDue = (dev->dueMs < nextDue) ? dev->dueMs : nextDue;
+            continue;
+        }
+
+        if (f_stats.running >= f_conf.concurrency)
+        {
+            /* Woken by a session end */
+            return -1;
+        }
+
+        if ((f_stats.attempts > 0U) && ((f_lastStartMs + f_conf.paceMs) > now))
+        {
+            return (int)(f_lastStartMs + f_conf.paceMs - now);
+        }
+
+        Start(epfd, i, now);
+    }
+
+    if (nextDue == UINT64_MAX)
+    {
+        return -1;
+    }
+
+    return (nextDue > now) ? (int)(nextDue - now) : 0;
+}
+
+static void Reap(uint32_t index, uint64_t now)
+{
+    Device_t* dev = &f_device[index];
+    int status = 0;
+
+    if ((dev->state != DEVICE_RUNNING) || (waitpid(dev->pid, &status, WNOHANG) != dev->pid))
+    {
+        return;
+    }
+
+    close(dev->pidfd);
+    dev->pidfd = -1;
+    dev->pid = 0;
+    f_stats.running--;
+
+    dev->lastStatus = WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status);
+
+    if (dev->lastStatus == 0)
+    {
+        dev->state = DEVICE_DONE;
+        dev->sessionMs = now - dev->startMs;
+        f_stats.done++;
+    }
+    else if ((dev->attempts > f_conf.retries) || (dev->lastStatus == EXEC_FAILED) || f_stop)
+    {
+        dev->state = DEVICE_FAILED;
+        f_stats.failed++;
+    }
+    else
+    {
+        /* Exponential backoff with up to 50 % jitter, spreads a fleet that
+           failed together, e.g. behind one router */
+        const uint32_t shift = (dev->attempts < 16U) ? (dev->attempts - 1U) : 15U;
+        const uint64_t backoff = (uint64_t)f_conf.backoffMs << shift;
+        const uint64_t jitter = (backoff > 1U) ? (Random() % (backoff / 2U)) : 0U;
+
+        dev->state = DEVICE_PENDING;
+        dev->dueMs = now + backoff + jitter;
+    }
+}
+
+/** Kill sessions over the timeout
+ * 
+ * @return Milliseconds until the next timeout, -1 if nothing runs
+ */
+static int KillExpired(uint64_t now)
+{
+    const uint64_t limit = (uint64_t)f_conf.timeoutS * 1000U;
+    uint64_t next = UINT64_MAX;
+
+    for (uint32_t i = 0U; i < f_deviceCount; i++)
+    {
+        Device_t* dev = &f_device[i];
+
+        if ((dev->state != DEVICE_RUNNING) || dev->timedOut)
+        {
+            continue;
+        }
+
+        if ((now - dev->startMs) >= limit)
+        {
+            /* The pidfd becomes readable and the session is reaped */
+            (void)kill(-dev->pid, SIGKILL);
+            dev->timedOut = true;
+            f_stats.timeouts++;
+        }
+        else if ((dev->startMs + limit) < next)
+        {
+            next = dev->startMs + limit;
+        }
+    }
+
+    return (next == UINT64_MAX) ? -1 : (int)(next - now);
+}
+
+static void Progress(uint64_t elapsed)
+{
+    fprintf(stderr, "[%6.1f s] %u/%u done, %u failed, %u running, %u retries\n",
+        (double)elapsed / 1000.0,
+        (unsigned)f_stats.done,
+        (unsigned)f_deviceCount,
+        (unsigned)f_stats.failed,
+        (unsigned)f_stats.running,
+        (unsigned)f_stats.retries);
+}
+
+static int CompareMs(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t Percentile(const uint64_t* sorted, uint32_t count, uint32_t pct)
+{
+    return (count == 0U) ? 0U : sorted[((count - 1U) * pct) / 100U];
+}
+
+static void WriteResults(void)
+{
+    FILE* f = fopen(f_conf.results, "w");
+
+    if (f == NULL)
+    {
+        perror(f_conf.results);
+        return;
+    }
+
+    for (uint32_t i = 0U; i < f_deviceCount; i++)
+    {
+        const Device_t* dev = &f_device[i];
+        fprintf(f, "{\"address\":\"%s\",\"port\":\"%s\",\"result\":\"%s\",\"attempts\":%u,\"status\":%d,\"session_ms\":%llu}\n",
+            dev->address,
+            dev->port,
+            (dev->state == DEVICE_DONE) ? "done" : (dev->state == DEVICE_FAILED) ? "failed" : "not_started",
+            (unsigned)dev->attempts,
+            dev->lastStatus,
+            (unsigned long long)dev->sessionMs);
+    }
+
+    fclose(f);
+}
+
+static void PrintSummary(uint64_t elapsed)
+{
+    uint64_t* session = calloc((f_stats.done > 0U) ? f_stats.done : 1U, sizeof(uint64_t));
+    uint64_t* total = calloc((f_stats.done > 0U) ? f_stats.done : 1U, sizeof(uint64_t));
+    uint32_t n = 0U;
+
+    for (uint32_t i = 0U; (i < f_deviceCount) && (session != NULL) && (total != NULL); i++)
+    {
+        if (f_device[i].state == DEVICE_DONE)
+        {
+            session[n] = f_device[i].sessionMs;
+            total[n] = f_device[i].startMs + f_device[i].sessionMs - f_device[i].firstStartMs;
+            n++;
+        }
+    }
+
+    qsort(session, n, sizeof(uint64_t), CompareMs);
+    qsort(total, n, sizeof(uint64_t), CompareMs);
+
+    const double seconds = (double)elapsed / 1000.0;
+
+    printf("{\"devices\":%u,\"done\":%u,\"failed\":%u,\"not_started\":%u,\"attempts\":%u,"
+           "\"retries\":%u,\"timeouts\":%u,\"concurrency\":%u,\"peak_running\":%u,"
+           "\"elapsed_s\":%.3f,\"devices_per_min\":%.1f,"
+           "\"session_ms\":{\"min\":%llu,\"p50\":%llu,\"p95\":%llu,\"p99\":%llu,\"max\":%llu},"
+           "\"to_done_ms\":{\"p50\":%llu,\"p95\":%llu,\"max\":%llu}}\n",
+        (unsigned)f_deviceCount,
+        (unsigned)f_stats.done,
+        (unsigned)f_stats.failed,
+        (unsigned)(f_deviceCount - f_stats.done - f_stats.failed),
+        (unsigned)f_stats.attempts,
+        (unsigned)f_stats.retries,
+        (unsigned)f_stats.timeouts,
+        (unsigned)f_conf.concurrency,
+        (unsigned)f_stats.peakRunning,
+        seconds,
+        (seconds > 0.0) ? ((double)f_stats.done * 60.0) / seconds : 0.0,
+        (unsigned long long)((n > 0U) ? session[0] : 0U),
+        (unsigned long long)Percentile(session, n, 50U),
+        (unsigned long long)Percentile(session, n, 95U),
+        (unsigned long long)Percentile(session, n, 99U),
+        (unsigned long long)((n > 0U) ? session[n - 1U] : 0U),
+        (unsigned long long)Percentile(total, n, 50U),
+        (unsigned long long)Percentile(total, n, 95U),
+        (unsigned long long)((n > 0U) ? total[n - 1U] : 0U));
+    fflush(stdout);
+
+    free(session);
+    free(total);
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "Usage: fleet_update -i <signed.hex> -l <devices.txt> [options]\n");
+    fprintf(stderr, "  -i <file>       Signed image, uploaded to every device\n");
+    fprintf(stderr, "  -l <file>       Device list, \"address [port]\" per line\n");
+    fprintf(stderr, "  -c <path>       Update client, default updateclient\n");
+    fprintf(stderr, "  -p <port>       Default device port, default 7\n");
+    fprintf(stderr, "  -j <sessions>   Concurrent sessions, default 64\n");
+    fprintf(stderr, "  -P <ms>         Minimum interval between session starts\n");
+    fprintf(stderr, "  -r <retries>    Retries per device, default 3\n");
+    fprintf(stderr, "  -b <ms>         First retry backoff, doubled per retry, default 1000\n");
+    fprintf(stderr, "  -t <seconds>    Session timeout, default 300\n");
+    fprintf(stderr, "  -S <seed>       Backoff jitter seed, default 1\n");
+    fprintf(stderr, "  -o <file>       Per-device results as JSON lines\n");
+    fprintf(stderr, "  -v              Show the client output\n");
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* opt = argv[i];
+
+        if (0 == strcmp(opt, "-v"))
+        {
+            f_conf.verbose = true;
+            continue;
+        }
+
+        if (((i + 1) >= argc) || (opt[0] != '-') || (opt[1] == '\0') || (opt[2] != '\0'))
+        {
+            Usage();
+            return 1;
+        }
+
+        const char* arg = argv[++i];
+
+        switch (opt[1])
+        {
+        case 'i': f_conf.image = arg; break;
+        case 'l': f_conf.devices = arg; break;
+        case 'c': f_conf.client = arg; break;
+        case 'p': f_conf.port = arg; break;
+        case 'j': f_conf.concurrency = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'P': f_conf.paceMs = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'r': f_conf.retries = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'b': f_conf.backoffMs = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 't': f_conf.timeoutS = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'S': f_conf.seed = (uint32_t)strtoul(arg, NULL, 0); break;
+        case 'o': f_conf.results = arg; break;
+        default:
+            Usage();
+            return 1;
+        }
+    }
+
+    if ((f_conf.image == NULL) || (f_conf.devices == NULL) || (f_conf.concurrency == 0U))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (!LoadDevices(f_conf.devices) || !LoadImage(f_conf.image))
+    {
+        fprintf(stderr, "Nothing to update\n");
+        return 1;
+    }
+
+    f_rng = (f_conf.seed == 0U) ? 1U : f_conf.seed;
+
+    const int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0)
+    {
+        perror("epoll");
+        return 1;
+    }
+
+    (void)signal(SIGINT, Stop);
+    (void)signal(SIGTERM, Stop);
+
+    fprintf(stderr, "Updating %u devices with %s, %u concurrent sessions\n",
+        (unsigned)f_deviceCount, f_conf.image, (unsigned)f_conf.concurrency);
+
+    const uint64_t begin = NowMs();
+    uint64_t nextProgress = begin + PROGRESS_MS;
+    struct epoll_event events[MAX_EVENTS];
+
+    while ((f_stats.done + f_stats.failed) < f_deviceCount)
+    {
+        uint64_t now = NowMs();
+
+        if (f_stop)
+        {
+            /* Interrupted sessions end as failed, nothing new starts */
+            if (f_stats.running == 0U)
+            {
+                break;
+            }
+            for (uint32_t i = 0U; i < f_deviceCount; i++)
+            {
+                if ((f_device[i].state == DEVICE_RUNNING) && !f_device[i].timedOut)
+                {
+                    (void)kill(-f_device[i].pid, SIGTERM);
+                    f_device[i].timedOut = true;
+                }
+            }
+        }
+
+        int timeout = f_stop ? -1 : LaunchDue(epfd, now);
+        const int expire = KillExpired(now);
+        const int progress = (nextProgress > now) ? (int)(nextProgress - now) : 0;
+
+        timeout = ((expire >= 0) && ((timeout < 0) || (expire < timeout))) ? expire : timeout;
+        timeout = ((timeout < 0) || (progress < timeout)) ? progress : timeout;
+
+        const int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+
+        if ((n < 0) && (errno != EINTR))
+        {
+            perror("epoll_wait");
+            break;
+        }
+
+        now = NowMs();
+
+        for (int e = 0; e < n; e++)
+        {
+            Reap(events[e].data.u32, now);
+        }
+
+        if (now >= nextProgress)
+        {
+            Progress(now - begin);
+            nextProgress = now + PROGRESS_MS;
+        }
+    }
+
+    const uint64_t elapsed = NowMs() - begin;
+
+    Progress(elapsed);
+    PrintSummary(elapsed);
+
+    if (f_conf.results != NULL)
+    {
+        WriteResults();
+    }
+
+    close(epfd);
+    free(f_device);
+    return (f_stats.done == f_deviceCount) ? 0 : 2;
+}
+
+/* EoF fleet_update.c */
@@ -0,0 +1,263 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * install_sim.c
+ *
+ * @brief Host build of the bootloader install path. The unmodified
+ *        installer.c, app_status.c and install_journal.c run against the
+ *        simulated internal flash and a W25Q128 image written by
+ *        updateserver_sim. Each boot phase reports where the modeled time
+ *        goes: SPI reads, external flash writes, internal erases and
+ *        programs, and host CPU time for hashing and signatures. An optional
+ *        power cut during the install shows the journal resume.
+ * 
+ *        install_sim [-f w25q128.bin] [-c operations]
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "app_status.h"
+#include "flash_sim.h"
+#include "installer.h"
+#include "stm32f4xx_hal.h"
+#include "w25q_sim.h"
+#include "w25qxx_init.h"
+#include "w25qxx/flash_interface.h"
+
+#include "generated_public_key.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint64_t spiReadUs;
+    uint64_t spiWriteUs;
+    uint64_t eraseUs;
+    uint64_t programUs;
+    uint64_t cpuUs;
+} SimTime_t;
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define SECTOR_SIZE (0x1000U)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static w25qxx_handle_t f_handle;
+static jmp_buf f_resetPoint;
+static volatile uint32_t f_boots = 0U;
+static SimTime_t f_phaseStart;
+
+static const KeyContainer_t f_keys = {
+    .metadataPubKey = generated_public_key,
+    .firmwarePubKey = generated_public_key,
+    .fragmentPubKey = generated_public_key,
+};
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static SimTime_t Now(void)
+{
+    struct timespec ts;
+    const W25qSimStats_t spi = W25Q_SIM_GetStats();
+    const SimFlashStats_t flash = SIM_FLASH_GetStats();
+
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return (SimTime_t) {
+        .spiReadUs = spi.readUs,
+        .spiWriteUs = spi.busyUs - spi.readUs,
+        .eraseUs = flash.eraseUs,
+        .programUs = flash.programUs,
+        .cpuUs = ((uint64_t)ts.tv_sec * 1000000U) + ((uint64_t)ts.tv_nsec / 1000U),
+    };
+}
+
+static uint64_t TotalUs(const SimTime_t* t)
+{
+    return t->spiReadUs + t->spiWriteUs + t->eraseUs + t->programUs + t->cpuUs;
+}
+
+static void Phase(const char* name)
+{
+    const SimTime_t now = Now();
+    const SimTime_t d = {
+        .spiReadUs = now.spiReadUs - f_phaseStart.spiReadUs,
+        .spiWriteUs = now.spiWriteUs - f_phaseStart.spiWriteUs,
+        .eraseUs = now.eraseUs - f_phaseStart.eraseUs,
+        .programUs = now.programUs - f_phaseStart.programUs,
+        .cpuUs = now.cpuUs - f_phaseStart.cpuUs,
+    };
+
+    printf("[%-8s] %8.1f ms: SPI read %.1f, SPI write %.1f, erase %.1f, program %.1f, CPU %.1f\r\n",
+        name,
+        (double)TotalUs(&d) / 1000.0,
+        (double)d.spiReadUs / 1000.0,
+        (double)d.spiWriteUs / 1000.0,
+        (double)d.eraseUs / 1000.0,
+        (double)d.programUs / 1000.0,
+        (double)d.cpuUs / 1000.0);
+
+    f_phaseStart = now;
+}
+
+/** The start-up sequence of the bootloader main() without the jumps */
+static void Boot(void)
+{
+    f_phaseStart = Now();
+
+    INSTALLER_InitAreas(&f_handle, &f_keys);
+    Phase("init");
+
+    const bool installed = INSTALLER_CheckInstallRequest();
+    Phase("install");
+
+    bool appOk = APP_STATUS_Verify(&f_keys);
+    Phase("verify");
+
+    if (!appOk)
+    {
+        appOk = INSTALLER_TryRepair();
+        Phase("repair");
+    }
+
+    printf("Boot %u: %s, application %s\r\n",
+        (unsigned)f_boots,
+        installed ? "installed" : "nothing installed",
+        appOk ? "OK" : "NOT OK");
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "Usage: install_sim [-f <w25q128.bin>] [-c <operations>]\n");
+    fprintf(stderr, "  -f  External flash image written by updateserver_sim\n");
+    fprintf(stderr, "  -c  Cut the power after this many internal flash operations\n");
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+uint32_t HAL_GetTick(void)
+{
+    const SimTime_t now = Now();
+    return (uint32_t)(TotalUs(&now) / 1000U);
+}
+
+void W25Q128_SetReadAhead(bool enable)
+{
+    (void)enable;
+}
+
+bool W25Qxx_INTERFACE_ReadFlash(uint32_t address, uint8_t* data, size_t size)
+{
+    return W25Q_SIM_Read(address, data, size);
+}
+
+bool W25Qxx_INTERFACE_WriteAndVerifyFlash(uint32_t address, const uint8_t* data, size_t size)
+{
+    return W25Q_SIM_Program(address, data, size) &&
+           (0 == memcmp(&W25Q_SIM_Memory()[address], data, size));
+}
+
+bool W25Qxx_INTERFACE_EraseFlash(uint32_t address, size_t size)
+{
+    for (size_t offset = 0U; offset < size; offset += SECTOR_SIZE)
+    {
+        if (!W25Q_SIM_EraseBlock(address + (uint32_t)offset, SECTOR_SIZE))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = "w25q128.bin";
+    uint32_t powerCut = 0U;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((0 == strcmp(argv[i], "-f")) && ((i + 1) < argc))
+        {
+            path = argv[++i];
+        }
+        else if ((0 == strcmp(argv[i], "-c")) && ((i + 1) < argc))
+        {
+            powerCut = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (!SIM_FLASH_Init() || !W25Q_SIM_Open(path))
+    {
+        return 1;
+    }
+
+    SIM_FLASH_SetResetPoint(&f_resetPoint);
+    SIM_FLASH_SetPowerCut(powerCut);
+
+    if (setjmp(f_resetPoint) != 0)
+    {
+        const SimFlashStats_t stats = SIM_FLASH_GetStats();
+        printf("Reset after %u power cuts and %u resets\r\n",
+            (unsigned)stats.powerCuts, (unsigned)stats.resets);
+    }
+
+    f_boots++;
+    Boot();
+
+    const SimFlashStats_t flash = SIM_FLASH_GetStats();
+    const W25qSimStats_t spi = W25Q_SIM_GetStats();
+    printf("%u internal sector erases, %u bytes programmed, %llu external bytes read\r\n",
+        (unsigned)flash.sectorErases,
+        (unsigned)flash.bytesProgrammed,
+        (unsigned long long)spi.bytesRead);
+
+    W25Q_SIM_Close();
+    return 0;
+}
+
+/* EoF install_sim.c */
@@ -0,0 +1,627 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * replay_sim.c
+ *
+ * @brief Deterministic replay of a captured update session. The unmodified
+ *        updateserver.c runs on the simulated W25Q128 and its socket calls
+ *        are served from the session log: each recvfrom returns the next
+ *        captured PDU and each sendto is checked against the captured
+ *        response. PDUs are fed as fast as possible or at the captured
+ *        arrival times. The replay records its own session log, and both
+ *        are summarized as JSON lines for comparison.
+ * 
+ *        replay_sim -l session.bin [-f w25q128.bin] [-w] [-t] [-o replay.bin]
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "flash_scheduler.h"
+#include "metadata.h"
+#include "server.h"
+#include "session_log.h"
+#include "stm32f4xx_it.h"
+#include "system_reset.h"
+#include "w25q_sim.h"
+
+#include "crc/crc32.h"
+#include "lwip/sockets.h"
+#include "fragmentstore/default_app_types.h"
+#include "updateserver/transfer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t busy;
+    uint64_t us;
+} CallbackTotals_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t failed;
+    uint64_t bytes;
+    uint64_t us;
+} FlashTotals_t;
+
+/** Summary of one session log */
+typedef struct
+{
+    uint32_t pdus;
+    uint64_t pduBytes;
+    uint32_t responses;
+    uint64_t sessionUs;         /* First to last record */
+    uint64_t serveUs;           /* PDU received to response sent */
+    CallbackTotals_t cb[SESSION_CB_COUNT];
+    FlashTotals_t flash[SESSION_FLASH_COUNT];
+} LogTotals_t;
+
+typedef struct
+{
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} Buffer_t;
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define REPLAY_SOCKET       (3)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+/* Running firmware of the simulated device */
+const Metadata_t FIRMWARE_METADATA =
+{
+    .magic = "_M_E_T_A_D_A_T_A",
+    .type = DEFAULT_APP_TYPE_FIRMWARE,
+    .version = 1U,
+    .rollbackNumber = 1U,
+    .firmwareId = 0x51A1A7EDU,
+    .startAddress = 0x08020000U,
+    .firmwareSize = 0x00000000U,
+    .name = "host_simulation",
+};
+
+static w25qxx_handle_t f_handle;
+
+static Buffer_t f_captured;
+static Buffer_t f_replayed;
+static size_t f_cursor = 0U;
+static uint64_t f_capturedUs = 0U;      /* Captured time at the cursor */
+static uint64_t f_firstPduUs = UINT64_MAX;
+static uint64_t f_replayStartUs = 0U;
+static bool f_wallClock = false;
+static const char* f_outPath = NULL;
+
+/* Expected response of the PDU being served */
+static bool f_expectResponse = false;
+static SessionResponse_t f_expected;
+static uint32_t f_matched = 0U;
+static uint32_t f_differ = 0U;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static uint64_t NowUs(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000U) + ((uint64_t)ts.tv_nsec / 1000U);
+}
+
+static bool Append(Buffer_t* buf, const uint8_t* data, size_t size)
+{
+    if ((buf->size + size) > buf->capacity)
+    {
+        const size_t capacity = (buf->capacity == 0U) ? 0x10000U : (2U * buf->capacity);
+        uint8_t* grown = realloc(buf->data, (capacity > (buf->size + size)) ? capacity : (buf->size + size));
+
+        if (grown == NULL)
+        {
+            return false;
+        }
+
+        buf->data = grown;
+        buf->capacity = (capacity > (buf->size + size)) ? capacity : (buf->size + size);
+    }
+
+    memcpy(&buf->data[buf->size], data, size);
+    buf->size += size;
+    return true;
+}
+
+static bool LoadFile(const char* path, Buffer_t* buf)
+{
+    uint8_t chunk[4096];
+    size_t n;
+    FILE* f = fopen(path, "rb");
+
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    while ((n = fread(chunk, 1U, sizeof(chunk), f)) > 0U)
+    {
+        if (!Append(buf, chunk, n))
+        {
+            fclose(f);
+            return false;
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+/** Get the record at an offset
+ * 
+ * @return Record header, NULL at the end or if truncated
+ */
+static const SessionRecord_t* RecordAt(const Buffer_t* buf, size_t offset)
+{
+    if ((offset + sizeof(SessionRecord_t)) > buf->size)
+    {
+        return NULL;
+    }
+
+    const SessionRecord_t* rec = (const SessionRecord_t*)&buf->data[offset];
+
+    if ((offset + sizeof(SessionRecord_t) + rec->size) > buf->size)
+    {
+        return NULL;
+    }
+
+    return rec;
+}
+
+static bool ValidStart(const Buffer_t* buf)
+{
+    const SessionRecord_t* rec = RecordAt(buf, 0U);
+
+    if ((rec == NULL) || (rec->type != SESSION_REC_START) || (rec->size != sizeof(SessionStart_t)))
+    {
+        return false;
+    }
+
+    const SessionStart_t* start = (const SessionStart_t*)(rec + 1);
+    return (start->magic == SESSION_LOG_MAGIC) && (start->version == SESSION_LOG_VERSION);
+}
+
+static void Tally(const Buffer_t* buf, LogTotals_t* t)
+{
+    uint64_t now = 0U;
+    uint64_t pduAt = 0U;
+    bool serving = false;
+
+    memset(t, 0, sizeof(*t));
+
+    for (size_t offset = 0U; ; )
+    {
+        const SessionRecord_t* rec = RecordAt(buf, offset);
+
+        if (rec == NULL)
+        {
+            break;
+        }
+
+        const void* payload = rec + 1;
+        now += rec->deltaUs;
+        offset += sizeof(*rec) + rec->size;
+
+        switch (rec->type)
+        {
+        case SESSION_REC_PDU:
+            t->pdus++;
+            t->pduBytes += rec->size;
+            pduAt = now;
+            serving = true;
+            break;
+
+        case SESSION_REC_RESPONSE:
+            t->responses++;
+            if (serving)
+            {
+                t->serveUs += now - pduAt;
+                serving = false;
+            }
+            break;
+
+        case SESSION_REC_CALLBACK:
+            if ((rec->arg < SESSION_CB_COUNT) && (rec->size == sizeof(SessionCallback_t)))
+            {
+                const SessionCallback_t* cb = payload;
+                t->cb[rec->arg].count++;
+                t->cb[rec->arg].busy += (cb->result == PROTOCOL_NACK_BUSY_REPEAT_REQUEST) ? 1U : 0U;
+                t->cb[rec->arg].us += cb->durationUs;
+            }
+            break;
+
+        case SESSION_REC_FLASH:
+            if ((rec->arg < SESSION_FLASH_COUNT) && (rec->size == sizeof(SessionFlash_t)))
+            {
+                const SessionFlash_t* fl = payload;
+                t->flash[rec->arg].count++;
+                t->flash[rec->arg].failed += fl->ok ? 0U : 1U;
+                t->flash[rec->arg].bytes += fl->size;
+                t->flash[rec->arg].us += fl->durationUs;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    t->sessionUs = now;
+}
+
+static void PrintTotals(const char* source, const LogTotals_t* t)
+{
+    static const char* const cbNames[SESSION_CB_COUNT] = {
+        "read_data", "write_data", "put_metadata", "put_fragment"
+    };
+    static const char* const flashNames[SESSION_FLASH_COUNT] = {
+        "read", "write", "erase"
+    };
+
+    printf("{\"source\":\"%s\",\"pdus\":%u,\"pdu_bytes\":%llu,\"responses\":%u,"
+           "\"session_ms\":%.3f,\"serve_ms\":%.3f",
+        source,
+        (unsigned)t->pdus,
+        (unsigned long long)t->pduBytes,
+        (unsigned)t->responses,
+        (double)t->sessionUs / 1000.0,
+        (double)t->serveUs / 1000.0);
+
+    for (size_t i = 0U; i < SESSION_CB_COUNT; i++)
+    {
+        printf(",\"%s\":{\"count\":%u,\"busy\":%u,\"ms\":%.3f}",
+            cbNames[i],
+            (unsigned)t->cb[i].count,
+            (unsigned)t->cb[i].busy,
+            (double)t->cb[i].us / 1000.0);
+    }
+
+    for (size_t i = 0U; i < SESSION_FLASH_COUNT; i++)
+    {
+        printf(",\"flash_%s\":{\"count\":%u,\"failed\":%u,\"bytes\":%llu,\"ms\":%.3f}",
+            flashNames[i],
+            (unsigned)t->flash[i].count,
+            (unsigned)t->flash[i].failed,
+            (unsigned long long)t->flash[i].bytes,
+            (double)t->flash[i].us / 1000.0);
+    }
+
+    printf("}\n");
+}
+
+/** Summarize both logs and end the process */
+static void Finish(void)
+{
+    LogTotals_t captured;
+    LogTotals_t replayed;
+
+    SESSION_LOG_Stop();
+
+    Tally(&f_captured, &captured);
+    Tally(&f_replayed, &replayed);
+
+    PrintTotals("captured", &captured);
+    PrintTotals("replay", &replayed);
+    printf("{\"responses_matched\":%u,\"responses_differ\":%u,\"pacing\":\"%s\"}\n",
+        (unsigned)f_matched,
+        (unsigned)f_differ,
+        f_wallClock ? "wall_clock" : "fast");
+
+    if (f_outPath != NULL)
+    {
+        FILE* f = fopen(f_outPath, "wb");
+        if ((f == NULL) || (fwrite(f_replayed.data, 1U, f_replayed.size, f) != f_replayed.size))
+        {
+            perror(f_outPath);
+        }
+        if (f != NULL)
+        {
+            fclose(f);
+        }
+    }
+
+    W25Q_SIM_Close();
+    exit((f_differ == 0U) ? 0 : 2);
+}
+
+static void ReplayWrite(const uint8_t* data, size_t size)
+{
+    if (!Append(&f_replayed, data, size))
+    {
+        fprintf(stderr, "Out of memory for the replay log\n");
+        exit(1);
+    }
+}
+
+static bool LoadImage(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    const size_t n = fread(W25Q_SIM_Memory(), 1U, W25Q_SIM_SIZE, f);
+    fclose(f);
+
+    if (n != W25Q_SIM_SIZE)
+    {
+        fprintf(stderr, "%s is not a %u byte W25Q128 image\n", path, (unsigned)W25Q_SIM_SIZE);
+        return false;
+    }
+
+    return true;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "Usage: replay_sim -l <session.bin> [-f <w25q128.bin>] [-w] [-t] [-o <replay.bin>]\n");
+    fprintf(stderr, "  -l  Captured session log\n");
+    fprintf(stderr, "  -f  External flash contents at the start of the session, not modified\n");
+    fprintf(stderr, "  -w  Feed PDUs at the captured arrival times\n");
+    fprintf(stderr, "  -t  Sleep for the W25Q128 busy times\n");
+    fprintf(stderr, "  -o  Write the session log of the replay\n");
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+int REPLAY_Socket(int domain, int type, int protocol)
+{
+    (void)domain;
+    (void)type;
+    (void)protocol;
+    return REPLAY_SOCKET;
+}
+
+int REPLAY_Bind(int s, const struct sockaddr* addr, socklen_t len)
+{
+    (void)s;
+    (void)addr;
+    (void)len;
+    return 0;
+}
+
+ssize_t REPLAY_RecvFrom(int s, void* buf, size_t len, int flags, struct sockaddr* from, socklen_t* fromlen)
+{
+    (void)s;
+    (void)flags;
+
+    for (;;)
+    {
+        const SessionRecord_t* rec = RecordAt(&f_captured, f_cursor);
+
+        if (rec == NULL)
+        {
+            Finish();
+        }
+
+        f_cursor += sizeof(*rec) + rec->size;
+        f_capturedUs += rec->deltaUs;
+
+        if (rec->type != SESSION_REC_PDU)
+        {
+            continue;
+        }
+
+        /* The response is the next response record before another PDU */
+        f_expectResponse = false;
+        for (size_t offset = f_cursor; ; )
+        {
+            const SessionRecord_t* next = RecordAt(&f_captured, offset);
+
+            if ((next == NULL) || (next->type == SESSION_REC_PDU))
+            {
+                break;
+            }
+
+            if ((next->type == SESSION_REC_RESPONSE) && (next->size == sizeof(SessionResponse_t)))
+            {
+                memcpy(&f_expected, next + 1, sizeof(f_expected));
+                f_expectResponse = true;
+                break;
+            }
+
+            offset += sizeof(*next) + next->size;
+        }
+
+        if (f_firstPduUs == UINT64_MAX)
+        {
+            f_firstPduUs = f_capturedUs;
+            f_replayStartUs = NowUs();
+        }
+
+        if (f_wallClock)
+        {
+            const uint64_t due = f_replayStartUs + (f_capturedUs - f_firstPduUs);
+            const uint64_t now = NowUs();
+
+            if (due > now)
+            {
+                TIM6_Delay_us((uint32_t)(due - now));
+            }
+        }
+
+        const size_t size = (rec->size < len) ? rec->size : len;
+        memcpy(buf, rec + 1, size);
+
+        if ((from != NULL) && (fromlen != NULL) && (*fromlen >= sizeof(struct sockaddr_in)))
+        {
+            struct sockaddr_in* peer = (struct sockaddr_in*)from;
+            memset(peer, 0, sizeof(*peer));
+            peer->sin_family = AF_INET;
+            peer->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            *fromlen = sizeof(*peer);
+        }
+
+        return (ssize_t)size;
+    }
+}
+
+ssize_t REPLAY_SendTo(int s, const void* buf, size_t len, int flags, const struct sockaddr* to, socklen_t tolen)
+{
+    (void)s;
+    (void)flags;
+    (void)to;
+    (void)tolen;
+
+    if (f_expectResponse)
+    {
+        const bool same = (f_expected.size == len) &&
+                          (f_expected.crc == CRC32_Calculate((const uint8_t*)buf, len));
+        f_matched += same ? 1U : 0U;
+        f_differ += same ? 0U : 1U;
+        f_expectResponse = false;
+    }
+
+    return (ssize_t)len;
+}
+
+int REPLAY_Close(int s)
+{
+    (void)s;
+    return 0;
+}
+
+void SERVER_NotifyCallback(void)
+{
+}
+
+void TIM6_Delay_us(uint32_t us)
+{
+    const struct timespec ts = {
+        .tv_sec = (time_t)(us / 1000000U),
+        .tv_nsec = (long)((us % 1000000U) * 1000U),
+    };
+    (void)nanosleep(&ts, NULL);
+}
+
+uint32_t TIM6_GetTime_us(void)
+{
+    return (uint32_t)NowUs();
+}
+
+void system_reset_graceful(void)
+{
+    FLASH_SCHED_PrintStats();
+    Finish();
+}
+
+void system_reset_hard(void)
+{
+    system_reset_graceful();
+}
+
+int main(int argc, char** argv)
+{
+    const char* logPath = NULL;
+    const char* imagePath = NULL;
+    bool timing = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((0 == strcmp(argv[i], "-l")) && ((i + 1) < argc))
+        {
+            logPath = argv[++i];
+        }
+        else if ((0 == strcmp(argv[i], "-f")) && ((i + 1) < argc))
+        {
+            imagePath = argv[++i];
+        }
+        else if ((0 == strcmp(argv[i], "-o")) && ((i + 1) < argc))
+        {
+            f_outPath = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "-w"))
+        {
+            f_wallClock = true;
+        }
+        else if (0 == strcmp(argv[i], "-t"))
+        {
+            timing = true;
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if ((logPath == NULL) || !LoadFile(logPath, &f_captured))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (!ValidStart(&f_captured))
+    {
+        fprintf(stderr, "%s is not a version %u session log\n", logPath, (unsigned)SESSION_LOG_VERSION);
+        return 1;
+    }
+
+    if (!W25Q_SIM_Open(NULL) || ((imagePath != NULL) && !LoadImage(imagePath)))
+    {
+        return 1;
+    }
+
+    W25Q_SIM_SetTiming(timing);
+    (void)FLASH_SCHED_Init();
+
+    SESSION_LOG_Start(ReplayWrite);
+
+    /* Returns only if the server could not start */
+    SERVER_UdpUpdateServer(&f_handle);
+
+    W25Q_SIM_Close();
+    return 1;
+}
+
+/* EoF replay_sim.c */
@@ -0,0 +1,422 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * store_bench.c
+ *
+ * @brief Benchmark of the fragmentstore and w25qxx flash interface libraries
+ *        on the SPI level W25Q128 simulation. Each logical operation reports
+ *        the SPI transactions and bytes it caused, the bytes programmed and
+ *        erased in the device and the modeled time, so read and write
+ *        amplification of the store is visible. One JSON object per line.
+ * 
+ *        store_bench [-n fragments] > results.jsonl
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "partition_table.h"
+#include "w25q_sim.h"
+#include "w25q_spi_sim.h"
+#include "crc/crc32.h"
+#include "fragmentstore/command.h"
+#include "fragmentstore/default_app_types.h"
+#include "fragmentstore/fragmentstore.h"
+#include "w25qxx/flash_interface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef enum
+{
+    BENCH_FA_ERASE_AREA,
+    BENCH_FA_WRITE_METADATA,
+    BENCH_FA_READ_METADATA,
+    BENCH_FA_WRITE_FRAGMENT,
+    BENCH_FA_READ_FRAGMENT,
+    BENCH_FA_FIND_LAST_FRAGMENT,
+    BENCH_CA_WRITE_INSTALL_COMMAND,
+    BENCH_CA_READ_INSTALL_COMMAND,
+    BENCH_CA_GET_STATUS,
+    BENCH_CA_SET_STATUS,
+    BENCH_CA_WRITE_HISTORY,
+    BENCH_CA_READ_HISTORY,
+    BENCH_CA_ERASE_INSTALL_COMMAND,
+    BENCH_COUNT
+} BenchId_t;
+
+typedef struct
+{
+    const char* name;
+    uint32_t logicalBytes;      /* Payload of one operation */
+    uint32_t ops;
+    uint32_t failures;
+    W25qSpiSimStats_t spi;
+    W25qSimStats_t dev;
+    uint64_t hostNs;
+} Bench_t;
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define SLOT_ADDRESS        (0x00000000U)
+#define SLOT_SIZE           (0x00200000U)
+#define IMAGE_ADDRESS       (0x08020000U)
+#define FIRMWARE_ID         (0x00000001U)
+
+#define DEFAULT_FRAGMENTS   (256U)
+#define FIND_REPEATS        (16U)
+#define CA_CYCLES           (16U)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static Bench_t f_bench[BENCH_COUNT] = {
+    [BENCH_FA_ERASE_AREA]               = { "FA_EraseArea",             0U },
+    [BENCH_FA_WRITE_METADATA]           = { "FA_WriteMetadata",         sizeof(Metadata_t) },
+    [BENCH_FA_READ_METADATA]            = { "FA_ReadMetadata",          sizeof(Metadata_t) },
+    [BENCH_FA_WRITE_FRAGMENT]           = { "FA_WriteFragment",         sizeof(Fragment_t) },
+    [BENCH_FA_READ_FRAGMENT]            = { "FA_ReadFragment",          sizeof(Fragment_t) },
+    [BENCH_FA_FIND_LAST_FRAGMENT]       = { "FA_FindLastFragment",      sizeof(Fragment_t) },
+    [BENCH_CA_WRITE_INSTALL_COMMAND]    = { "CA_WriteInstallCommand",   sizeof(Metadata_t) },
+    [BENCH_CA_READ_INSTALL_COMMAND]     = { "CA_ReadInstallCommand",    sizeof(Metadata_t) },
+    [BENCH_CA_GET_STATUS]               = { "CA_GetStatus",             0U },
+    [BENCH_CA_SET_STATUS]               = { "CA_SetStatus",             0U },
+    [BENCH_CA_WRITE_HISTORY]            = { "CA_WriteHistory",          sizeof(Metadata_t) },
+    [BENCH_CA_READ_HISTORY]             = { "CA_ReadHistory",           sizeof(Metadata_t) },
+    [BENCH_CA_ERASE_INSTALL_COMMAND]    = { "CA_EraseInstallCommand",   0U },
+};
+
+static W25qSpiSimStats_t f_startSpi;
+static W25qSimStats_t f_startDev;
+static uint64_t f_startNs;
+
+static uint8_t f_verifyBuf[512];
+static Fragment_t f_fragment;
+static Metadata_t f_metadata;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+/* Signatures are not part of the storage cost */
+static bool AcceptFragment(const Fragment_t* frag)
+{
+    (void)frag;
+    return true;
+}
+
+static bool AcceptMetadata(const Metadata_t* metadata)
+{
+    (void)metadata;
+    return true;
+}
+
+static uint64_t HostNs(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec;
+}
+
+static void Start(void)
+{
+    f_startSpi = W25Q_SPI_SIM_GetStats();
+    f_startDev = W25Q_SIM_GetStats();
+    f_startNs = HostNs();
+}
+
+static void Stop(BenchId_t id, bool ok)
+{
+    const uint64_t ns = HostNs();
+    const W25qSpiSimStats_t spi = W25Q_SPI_SIM_GetStats();
+    const W25qSimStats_t dev = W25Q_SIM_GetStats();
+    Bench_t* b = &f_bench[id];
+
+    b->ops++;
+    b->failures += ok ? 0U : 1U;
+    b->hostNs += ns - f_startNs;
+
+    b->spi.transactions += spi.transactions - f_startSpi.transactions;
+    b->spi.reads += spi.reads - f_startSpi.reads;
+    b->spi.pagePrograms += spi.pagePrograms - f_startSpi.pagePrograms;
+    b->spi.erases += spi.erases - f_startSpi.erases;
+    b->spi.statusReads += spi.statusReads - f_startSpi.statusReads;
+    b->spi.writeEnables += spi.writeEnables - f_startSpi.writeEnables;
+    b->spi.other += spi.other - f_startSpi.other;
+    b->spi.bytesOut += spi.bytesOut - f_startSpi.bytesOut;
+    b->spi.bytesIn += spi.bytesIn - f_startSpi.bytesIn;
+    b->spi.transferUs += spi.transferUs - f_startSpi.transferUs;
+
+    b->dev.bytesProgrammed += dev.bytesProgrammed - f_startDev.bytesProgrammed;
+    b->dev.erases4k += dev.erases4k - f_startDev.erases4k;
+    b->dev.erases32k += dev.erases32k - f_startDev.erases32k;
+    b->dev.erases64k += dev.erases64k - f_startDev.erases64k;
+    b->dev.programConflicts += dev.programConflicts - f_startDev.programConflicts;
+    b->dev.readUs += dev.readUs - f_startDev.readUs;
+    b->dev.busyUs += dev.busyUs - f_startDev.busyUs;
+}
+
+static void Report(const Bench_t* b)
+{
+    if (b->ops == 0U)
+    {
+        return;
+    }
+
+    const double ops = (double)b->ops;
+    const double spiBytes = (double)(b->spi.bytesOut + b->spi.bytesIn);
+    const uint64_t erasedBytes = ((uint64_t)b->dev.erases4k * 0x1000U) +
+                                 ((uint64_t)b->dev.erases32k * 0x8000U) +
+                                 ((uint64_t)b->dev.erases64k * 0x10000U);
+
+    /* Bus time plus program and erase busy time, reads are bus time only */
+    const double modeledUs = (double)(b->spi.transferUs + (b->dev.busyUs - b->dev.readUs));
+
+    printf("{\"bench\":\"%s\",\"ops\":%u,\"failures\":%u,\"logical_bytes\":%u,"
+           "\"spi_bytes\":%.1f,\"amplification\":%.2f,\"transactions\":%.1f,"
+           "\"reads\":%.1f,\"page_programs\":%.1f,\"erases\":%.2f,\"status_reads\":%.1f,"
+           "\"programmed_bytes\":%.1f,\"erased_bytes\":%.1f,\"program_conflicts\":%u,"
+           "\"modeled_us\":%.1f,\"ops_per_s\":%.1f,\"host_ops_per_s\":%.1f}\n",
+        b->name,
+        (unsigned)b->ops,
+        (unsigned)b->failures,
+        (unsigned)b->logicalBytes,
+        spiBytes / ops,
+        (b->logicalBytes > 0U) ? (spiBytes / ops) / (double)b->logicalBytes : 0.0,
+        (double)b->spi.transactions / ops,
+        (double)b->spi.reads / ops,
+        (double)b->spi.pagePrograms / ops,
+        (double)b->spi.erases / ops,
+        (double)b->spi.statusReads / ops,
+        (double)b->dev.bytesProgrammed / ops,
+        (double)erasedBytes / ops,
+        (unsigned)b->dev.programConflicts,
+        modeledUs / ops,
+        (modeledUs > 0.0) ? (ops * 1e6) / modeledUs : 0.0,
+        (b->hostNs > 0U) ? (ops * 1e9) / (double)b->hostNs : 0.0);
+}
+
+static void MakeFragment(uint32_t number)
+{
+    memset(&f_fragment, 0, sizeof(f_fragment));
+    f_fragment.firmwareId = FIRMWARE_ID;
+    f_fragment.number = number;
+    f_fragment.startAddress = IMAGE_ADDRESS + (number * (uint32_t)sizeof(f_fragment.content));
+    f_fragment.size = sizeof(f_fragment.content);
+
+    for (size_t i = 0U; i < sizeof(f_fragment.content); i++)
+    {
+        f_fragment.content[i] = (uint8_t)((number * 7U) + i);
+    }
+}
+
+static void MakeMetadata(uint32_t fragments)
+{
+    memset(&f_metadata, 0, sizeof(f_metadata));
+    f_metadata.type = DEFAULT_APP_TYPE_FIRMWARE;
+    f_metadata.version = 1U;
+    f_metadata.firmwareId = FIRMWARE_ID;
+    f_metadata.startAddress = IMAGE_ADDRESS;
+    f_metadata.firmwareSize = fragments * (uint32_t)sizeof(f_fragment.content);
+    (void)snprintf(f_metadata.name, sizeof(f_metadata.name), "store_bench");
+}
+
+static void BenchFragmentArea(uint32_t fragments)
+{
+    static const MemoryConfig_t slotConf = {
+        .baseAddress = SLOT_ADDRESS,
+        .sectorSize = PARTITION_SECTOR_SIZE,
+        .memorySize = SLOT_SIZE,
+        .eraseValue = 0xFF,
+
+        .Reader = W25Qxx_INTERFACE_ReadFlash,
+        .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
+        .Eraser = W25Qxx_INTERFACE_EraseFlash,
+    };
+    static FragmentArea_t fa;
+    size_t lastIdx = 0U;
+
+    if (FA_ERR_OK != FA_InitStruct(&fa, &slotConf, AcceptFragment, AcceptMetadata))
+    {
+        fprintf(stderr, "FA_InitStruct failed\n");
+        exit(1);
+    }
+
+    MakeMetadata(fragments);
+
+    /* Erase a written slot so the erase cost includes the non-blank sectors */
+    for (uint32_t pass = 0U; pass < 2U; pass++)
+    {
+        Start();
+        Stop(BENCH_FA_ERASE_AREA, FA_ERR_OK == FA_EraseArea(&fa));
+
+        Start();
+        Stop(BENCH_FA_WRITE_METADATA, FA_ERR_OK == FA_WriteMetadata(&fa, &f_metadata));
+
+        for (uint32_t i = 0U; i < fragments; i++)
+        {
+            MakeFragment(i);
+            Start();
+            Stop(BENCH_FA_WRITE_FRAGMENT, FA_ERR_OK == FA_WriteFragment(&fa, i, &f_fragment));
+        }
+    }
+
+    for (uint32_t i = 0U; i < FIND_REPEATS; i++)
+    {
+        Start();
+        Stop(BENCH_FA_READ_METADATA, FA_ERR_OK == FA_ReadMetadata(&fa, &f_metadata));
+    }
+
+    for (uint32_t i = 0U; i < fragments; i++)
+    {
+        Start();
+        Stop(BENCH_FA_READ_FRAGMENT, FA_ERR_OK == FA_ReadFragment(&fa, i, &f_fragment));
+    }
+
+    for (uint32_t i = 0U; i < FIND_REPEATS; i++)
+    {
+        Start();
+        const bool found = (FA_ERR_OK == FA_FindLastFragment(&fa, &f_fragment, &lastIdx));
+        Stop(BENCH_FA_FIND_LAST_FRAGMENT, found && (lastIdx == (fragments - 1U)));
+    }
+}
+
+/** One install command life cycle as seen by the bootloader per pass */
+static void BenchCommandArea(void)
+{
+    static const MemoryConfig_t caConf = {
+        .baseAddress = PARTITION_COMMAND_AREA_ADDRESS,
+        .sectorSize = PARTITION_SECTOR_SIZE,
+        .memorySize = PARTITION_COMMAND_AREA_SIZE,
+        .eraseValue = 0xFF,
+
+        .Reader = W25Qxx_INTERFACE_ReadFlash,
+        .Writer = W25Qxx_INTERFACE_WriteAndVerifyFlash,
+        .Eraser = W25Qxx_INTERFACE_EraseFlash,
+    };
+    static CommandArea_t ca;
+    CommandType_t type;
+
+    if (!CA_InitStruct(&ca, &caConf, &CRC32_Calculate))
+    {
+        fprintf(stderr, "CA_InitStruct failed\n");
+        exit(1);
+    }
+
+    for (uint32_t i = 0U; i < CA_CYCLES; i++)
+    {
+        Start();
+        Stop(BENCH_CA_WRITE_INSTALL_COMMAND, CA_WriteInstallCommand(&ca, COMMAND_TYPE_INSTALL_FIRMWARE, &f_metadata));
+
+        Start();
+        Stop(BENCH_CA_READ_INSTALL_COMMAND, CA_ReadInstallCommand(&ca, &type, &f_metadata));
+
+        Start();
+        Stop(BENCH_CA_GET_STATUS, COMMAND_STATE_NONE == CA_GetStatus(&ca));
+
+        Start();
+        Stop(BENCH_CA_WRITE_HISTORY, CA_WriteHistory(&ca, &f_metadata));
+
+        Start();
+        Stop(BENCH_CA_SET_STATUS, CA_SetStatus(&ca, COMMAND_STATE_HISTORY_WRITTEN));
+
+        Start();
+        Stop(BENCH_CA_READ_HISTORY, CA_ReadHistory(&ca, &f_metadata));
+
+        Start();
+        Stop(BENCH_CA_SET_STATUS, CA_SetStatus(&ca, COMMAND_STATE_FIRMWARE_WRITTEN));
+
+        Start();
+        Stop(BENCH_CA_GET_STATUS, COMMAND_STATE_FIRMWARE_WRITTEN == CA_GetStatus(&ca));
+
+        Start();
+        Stop(BENCH_CA_ERASE_INSTALL_COMMAND, CA_EraseInstallCommand(&ca));
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv)
+{
+    uint32_t fragments = DEFAULT_FRAGMENTS;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((0 == strcmp(argv[i], "-n")) && ((i + 1) < argc))
+        {
+            fragments = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: store_bench [-n fragments]\n");
+            return 1;
+        }
+    }
+
+    if ((fragments == 0U) || ((fragments * sizeof(Fragment_t)) > (SLOT_SIZE / 2U)))
+    {
+        fprintf(stderr, "Fragment count must fit in half of the %u byte slot\n", (unsigned)SLOT_SIZE);
+        return 1;
+    }
+
+    if (!W25Q_SIM_Open(NULL))
+    {
+        return 1;
+    }
+
+    w25qxx_handle_t* handle = W25Q_SPI_SIM_Init();
+
+    if ((handle == NULL) || !W25Qxx_INTERFACE_Init(handle, f_verifyBuf, sizeof(f_verifyBuf)))
+    {
+        fprintf(stderr, "Flash interface initialization failed\n");
+        return 1;
+    }
+
+    BenchFragmentArea(fragments);
+    BenchCommandArea();
+
+    uint32_t failures = 0U;
+    for (size_t i = 0U; i < BENCH_COUNT; i++)
+    {
+        Report(&f_bench[i]);
+        failures += f_bench[i].failures;
+    }
+
+    W25Q_SIM_Close();
+    return (failures == 0U) ? 0 : 1;
+}
+
+/* EoF store_bench.c */
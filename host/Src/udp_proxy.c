@@ -0,0 +1,517 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * udp_proxy.c
+ *
+ * @brief User-space UDP impairment proxy between updateclient and the update
+ *        server. Datagrams in both directions get a configurable latency,
+ *        jitter, loss, reordering and duplication from a seeded generator,
+ *        so runs are repeatable. When the transfer has been idle for the
+ *        idle time, or on SIGINT, the proxy prints one JSON line with the
+ *        transfer time, goodput and the datagrams the client repeated.
+ * 
+ *        udp_proxy [-l 7000] [-s 127.0.0.1:7007] [-d ms] [-j ms] [-L %] [-r %] [-D %] [-S seed] [-i s]
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define MAX_DATAGRAM        (1472U)
+#define MAX_PENDING         (1024U)
+
+/* Open addressing set of client datagram hashes, power of two */
+#define SEEN_SLOTS          (0x40000U)
+
+/* A reordered datagram is held back this much longer than the others */
+#define REORDER_EXTRA_MS    (5U)
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE TYPE DEFINITIONS                                                   */
+/*----------------------------------------------------------------------------*/
+
+typedef enum
+{
+    DIR_TO_SERVER,
+    DIR_TO_CLIENT,
+} Direction_t;
+
+typedef struct
+{
+    uint32_t delayMs;
+    uint32_t jitterMs;
+    double lossPct;
+    double reorderPct;
+    double duplicatePct;
+    uint32_t seed;
+    uint32_t idleS;
+} Impairment_t;
+
+typedef struct
+{
+    bool used;
+    Direction_t dir;
+    uint64_t releaseUs;
+    size_t len;
+    uint8_t data[MAX_DATAGRAM];
+} Pending_t;
+
+typedef struct
+{
+    uint64_t firstUs;
+    uint64_t lastUs;
+    uint32_t clientDatagrams;
+    uint32_t serverDatagrams;
+    uint64_t clientBytes;
+    uint64_t serverBytes;
+    uint64_t uniqueBytes;
+    uint32_t repeated;
+    uint32_t dropped;
+    uint32_t duplicated;
+    uint32_t reordered;
+    uint32_t overflows;
+} ProxyStats_t;
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static Impairment_t f_imp = {
+    .delayMs = 0U,
+    .jitterMs = 0U,
+    .lossPct = 0.0,
+    .reorderPct = 0.0,
+    .duplicatePct = 0.0,
+    .seed = 1U,
+    .idleS = 3U,
+};
+
+static Pending_t f_pending[MAX_PENDING];
+static uint64_t f_seen[SEEN_SLOTS];
+static ProxyStats_t f_stats;
+static uint32_t f_rng;
+static volatile sig_atomic_t f_stop = 0;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static uint64_t NowUs(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000U) + ((uint64_t)ts.tv_nsec / 1000U);
+}
+
+/* xorshift32, the same sequence for the same seed */
+static uint32_t Random(void)
+{
+    f_rng ^= f_rng << 13;
+    f_rng ^= f_rng >> 17;
+    f_rng ^= f_rng << 5;
+    return f_rng;
+}
+
+static bool Chance(double pct)
+{
+    return (pct > 0.0) && (((double)Random() / 4294967296.0) * 100.0 < pct);
+}
+
+/* FNV-1a, zero marks an empty slot */
+static uint64_t Hash(const uint8_t* data, size_t len)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (size_t i = 0U; i < len; i++)
+    {
+        h = (h ^ data[i]) * 0x100000001B3ULL;
+    }
+    return (h == 0U) ? 1U : h;
+}
+
+/** Remember a client datagram
+ * 
+ * @return true if the same datagram was seen before
+ */
+static bool SeenBefore(const uint8_t* data, size_t len)
+{
+    const uint64_t h = Hash(data, len);
+
+    for (uint32_t i = 0U; i < SEEN_SLOTS; i++)
+    {
+        uint64_t* slot = &f_seen[(h + i) & (SEEN_SLOTS - 1U)];
+
+        if (*slot == h)
+        {
+            return true;
+        }
+        if (*slot == 0U)
+        {
+            *slot = h;
+            return false;
+        }
+    }
+
+    /* Set full, count as new */
+    return false;
+}
+
+static uint64_t DelayUs(void)
+{
+    int64_t ms = (int64_t)f_imp.delayMs;
+
+    if (f_imp.jitterMs > 0U)
+    {
+        ms += (int64_t)(Random() % ((2U * f_imp.jitterMs) + 1U)) - (int64_t)f_imp.jitterMs;
+    }
+
+    return (ms > 0) ? ((uint64_t)ms * 1000U) : 0U;
+}
+
+static void Enqueue(Direction_t dir, const uint8_t* data, size_t len, uint64_t releaseUs)
+{
+    for (size_t i = 0U; i < MAX_PENDING; i++)
+    {
+        if (!f_pending[i].used)
+        {
+            f_pending[i].used = true;
+            f_pending[i].dir = dir;
+            f_pending[i].releaseUs = releaseUs;
+            f_pending[i].len = len;
+            memcpy(f_pending[i].data, data, len);
+            return;
+        }
+    }
+
+    /* Queue full, behaves like a tail drop */
+    f_stats.overflows++;
+}
+
+static void Impair(Direction_t dir, const uint8_t* data, size_t len)
+{
+    const uint64_t now = NowUs();
+
+    if (Chance(f_imp.lossPct))
+    {
+        f_stats.dropped++;
+        return;
+    }
+
+    uint64_t release = now + DelayUs();
+
+    if (Chance(f_imp.reorderPct))
+    {
+        f_stats.reordered++;
+        release += ((uint64_t)f_imp.delayMs + (2U * (uint64_t)f_imp.jitterMs) + REORDER_EXTRA_MS) * 1000U;
+    }
+
+    Enqueue(dir, data, len, release);
+
+    if (Chance(f_imp.duplicatePct))
+    {
+        f_stats.duplicated++;
+        Enqueue(dir, data, len, now + DelayUs());
+    }
+}
+
+/** Send the pending datagrams that are due
+ * 
+ * @return Time until the next one is due in ms, -1 if none are pending
+ */
+static int Release(int clientSock, int serverSock, const struct sockaddr_in* client, bool clientKnown)
+{
+    const uint64_t now = NowUs();
+    uint64_t next = UINT64_MAX;
+
+    for (size_t i = 0U; i < MAX_PENDING; i++)
+    {
+        Pending_t* p = &f_pending[i];
+
+        if (!p->used)
+        {
+            continue;
+        }
+
+        if (p->releaseUs > now)
+        {
+            next = (p->releaseUs < next) ? p->releaseUs : next;
+            continue;
+        }
+
+        if (p->dir == DIR_TO_SERVER)
+        {
+            (void)send(serverSock, p->data, p->len, 0);
+        }
+        else if (clientKnown)
+        {
+            (void)sendto(clientSock, p->data, p->len, 0, (const struct sockaddr*)client, sizeof(*client));
+        }
+
+        p->used = false;
+    }
+
+    if (next == UINT64_MAX)
+    {
+        return -1;
+    }
+
+    return (int)((next - now + 999U) / 1000U);
+}
+
+static void PrintSummary(void)
+{
+    const double seconds = (f_stats.lastUs > f_stats.firstUs) ?
+        (double)(f_stats.lastUs - f_stats.firstUs) / 1e6 : 0.0;
+
+    printf("{\"delay_ms\":%u,\"jitter_ms\":%u,\"loss_pct\":%.2f,\"reorder_pct\":%.2f,"
+           "\"duplicate_pct\":%.2f,\"seed\":%u,\"elapsed_s\":%.3f,\"goodput_kbps\":%.1f,"
+           "\"client_datagrams\":%u,\"client_bytes\":%llu,\"unique_bytes\":%llu,"
+           "\"repeated\":%u,\"server_datagrams\":%u,\"server_bytes\":%llu,"
+           "\"dropped\":%u,\"duplicated\":%u,\"reordered\":%u,\"overflows\":%u}\n",
+        (unsigned)f_imp.delayMs,
+        (unsigned)f_imp.jitterMs,
+        f_imp.lossPct,
+        f_imp.reorderPct,
+        f_imp.duplicatePct,
+        (unsigned)f_imp.seed,
+        seconds,
+        (seconds > 0.0) ? ((double)f_stats.uniqueBytes * 8.0 / 1000.0) / seconds : 0.0,
+        (unsigned)f_stats.clientDatagrams,
+        (unsigned long long)f_stats.clientBytes,
+        (unsigned long long)f_stats.uniqueBytes,
+        (unsigned)f_stats.repeated,
+        (unsigned)f_stats.serverDatagrams,
+        (unsigned long long)f_stats.serverBytes,
+        (unsigned)f_stats.dropped,
+        (unsigned)f_stats.duplicated,
+        (unsigned)f_stats.reordered,
+        (unsigned)f_stats.overflows);
+    fflush(stdout);
+}
+
+static void Stop(int sig)
+{
+    (void)sig;
+    f_stop = 1;
+}
+
+static bool ParseServer(const char* arg, struct sockaddr_in* addr)
+{
+    char host[64];
+    const char* colon = strrchr(arg, ':');
+
+    if ((colon == NULL) || ((size_t)(colon - arg) >= sizeof(host)))
+    {
+        return false;
+    }
+
+    memcpy(host, arg, (size_t)(colon - arg));
+    host[colon - arg] = '\0';
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)strtoul(colon + 1, NULL, 10));
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "Usage: udp_proxy [options]\n");
+    fprintf(stderr, "  -l <port>       Client side port, default 7000\n");
+    fprintf(stderr, "  -s <ip:port>    Update server, default 127.0.0.1:7007\n");
+    fprintf(stderr, "  -d <ms>         One way latency\n");
+    fprintf(stderr, "  -j <ms>         Uniform jitter, +- ms\n");
+    fprintf(stderr, "  -L <percent>    Loss\n");
+    fprintf(stderr, "  -r <percent>    Reordering\n");
+    fprintf(stderr, "  -D <percent>    Duplication\n");
+    fprintf(stderr, "  -S <seed>       Random seed, default 1\n");
+    fprintf(stderr, "  -i <seconds>    Idle time ending the run, default 3\n");
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv)
+{
+    uint16_t listenPort = 7000U;
+    struct sockaddr_in server;
+    (void)ParseServer("127.0.0.1:7007", &server);
+
+    for (int i = 1; i < argc; i++)
+    {
+        const bool hasArg = (i + 1) < argc;
+        const char* opt = argv[i];
+
+        if (!hasArg || (opt[0] != '-') || (opt[1] == '\0') || (opt[2] != '\0'))
+        {
+            Usage();
+            return 1;
+        }
+
+        const char* arg = argv[++i];
+
+        switch (opt[1])
+        {
+        case 'l': listenPort = (uint16_t)strtoul(arg, NULL, 10); break;
+        case 's':
+            if (!ParseServer(arg, &server))
+            {
+                Usage();
+                return 1;
+            }
+            break;
+        case 'd': f_imp.delayMs = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'j': f_imp.jitterMs = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'L': f_imp.lossPct = strtod(arg, NULL); break;
+        case 'r': f_imp.reorderPct = strtod(arg, NULL); break;
+        case 'D': f_imp.duplicatePct = strtod(arg, NULL); break;
+        case 'S': f_imp.seed = (uint32_t)strtoul(arg, NULL, 0); break;
+        case 'i': f_imp.idleS = (uint32_t)strtoul(arg, NULL, 10); break;
+        default:
+            Usage();
+            return 1;
+        }
+    }
+
+    f_rng = (f_imp.seed == 0U) ? 1U : f_imp.seed;
+
+    const int clientSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    const int serverSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(listenPort),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+
+    if ((clientSock < 0) || (serverSock < 0) ||
+        (bind(clientSock, (const struct sockaddr*)&local, sizeof(local)) != 0) ||
+        (connect(serverSock, (const struct sockaddr*)&server, sizeof(server)) != 0))
+    {
+        perror("udp_proxy");
+        return 1;
+    }
+
+    (void)signal(SIGINT, Stop);
+    (void)signal(SIGTERM, Stop);
+
+    fprintf(stderr, "Proxy :%u -> %s:%u, delay %u +- %u ms, loss %.2f%%, reorder %.2f%%, duplicate %.2f%%\n",
+        (unsigned)listenPort, inet_ntoa(server.sin_addr), (unsigned)ntohs(server.sin_port),
+        (unsigned)f_imp.delayMs, (unsigned)f_imp.jitterMs,
+        f_imp.lossPct, f_imp.reorderPct, f_imp.duplicatePct);
+
+    struct sockaddr_in client;
+    bool clientKnown = false;
+    static uint8_t buf[MAX_DATAGRAM];
+
+    while (!f_stop)
+    {
+        int timeout = Release(clientSock, serverSock, &client, clientKnown);
+
+        if ((f_stats.clientDatagrams > 0U) && (timeout < 0))
+        {
+            const uint64_t idleUs = NowUs() - f_stats.lastUs;
+            const uint64_t limitUs = (uint64_t)f_imp.idleS * 1000000U;
+
+            if (idleUs >= limitUs)
+            {
+                break;
+            }
+            timeout = (int)((limitUs - idleUs + 999U) / 1000U);
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = clientSock, .events = POLLIN },
+            { .fd = serverSock, .events = POLLIN },
+        };
+
+        if (poll(fds, 2, timeout) <= 0)
+        {
+            continue;
+        }
+
+        if ((fds[0].revents & POLLIN) != 0)
+        {
+            socklen_t addrLen = sizeof(client);
+            const ssize_t len = recvfrom(clientSock, buf, sizeof(buf), 0, (struct sockaddr*)&client, &addrLen);
+
+            if (len > 0)
+            {
+                const uint64_t now = NowUs();
+                f_stats.firstUs = (f_stats.clientDatagrams == 0U) ? now : f_stats.firstUs;
+                f_stats.lastUs = now;
+                f_stats.clientDatagrams++;
+                f_stats.clientBytes += (uint64_t)len;
+                clientKnown = true;
+
+                if (SeenBefore(buf, (size_t)len))
+                {
+                    f_stats.repeated++;
+                }
+                else
+                {
+                    f_stats.uniqueBytes += (uint64_t)len;
+                }
+
+                Impair(DIR_TO_SERVER, buf, (size_t)len);
+            }
+        }
+
+        if ((fds[1].revents & POLLIN) != 0)
+        {
+            const ssize_t len = recv(serverSock, buf, sizeof(buf), 0);
+
+            if (len > 0)
+            {
+                f_stats.lastUs = NowUs();
+                f_stats.serverDatagrams++;
+                f_stats.serverBytes += (uint64_t)len;
+                Impair(DIR_TO_CLIENT, buf, (size_t)len);
+            }
+        }
+    }
+
+    PrintSummary();
+    close(clientSock);
+    close(serverSock);
+    return 0;
+}
+
+/* EoF udp_proxy.c */
@@ -0,0 +1,204 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * updateserver_sim.c
+ *
+ * @brief Host build of the application update server. The unmodified
+ *        updateserver.c serves the UDP protocol on POSIX sockets and stores
+ *        into a file backed W25Q128 image, so updateclient can be run
+ *        against localhost and the server profiled with perf. A reset
+ *        request ends the process, leaving the image for the bootloader
+ *        simulation. SIGINT and SIGTERM do the same, so a benchmark can stop
+ *        the server and collect its statistics. With -r the session log of
+ *        the served PDUs, responses, callbacks and flash operations is
+ *        written to a file for replay_sim.
+ * 
+ *        updateserver_sim [-f w25q128.bin] [-t] [-r session.bin]
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "flash_scheduler.h"
+#include "metadata.h"
+#include "server.h"
+#include "session_log.h"
+#include "stm32f4xx_it.h"
+#include "system_reset.h"
+#include "w25q_sim.h"
+
+#include "fragmentstore/default_app_types.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+/* Running firmware of the simulated device */
+const Metadata_t FIRMWARE_METADATA =
+{
+    .magic = "_M_E_T_A_D_A_T_A",
+    .type = DEFAULT_APP_TYPE_FIRMWARE,
+    .version = 1U,
+    .rollbackNumber = 1U,
+    .firmwareId = 0x51A1A7EDU,
+    .startAddress = 0x08020000U,
+    .firmwareSize = 0x00000000U,
+    .name = "host_simulation",
+};
+
+static w25qxx_handle_t f_handle;
+static FILE* f_capture = NULL;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static void Usage(void)
+{
+    fprintf(stderr, "Usage: updateserver_sim [-f <w25q128.bin>] [-t] [-r <session.bin>]\n");
+    fprintf(stderr, "  -f  External flash image, created erased if missing\n");
+    fprintf(stderr, "  -t  Sleep for the W25Q128 busy times\n");
+    fprintf(stderr, "  -r  Record the session log\n");
+}
+
+static void CaptureWrite(const uint8_t* data, size_t size)
+{
+    (void)fwrite(data, 1U, size, f_capture);
+}
+
+static void Terminate(int sig)
+{
+    (void)sig;
+    SERVER_PrintStats();
+    system_reset_graceful();
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+void SERVER_NotifyCallback(void)
+{
+}
+
+void TIM6_Delay_us(uint32_t us)
+{
+    (void)usleep(us);
+}
+
+uint32_t TIM6_GetTime_us(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint32_t)ts.tv_sec * 1000000U) + ((uint32_t)ts.tv_nsec / 1000U);
+}
+
+void system_reset_graceful(void)
+{
+    FLASH_SCHED_PrintStats();
+    W25Q_SIM_Close();
+
+    if (f_capture != NULL)
+    {
+        SESSION_LOG_Stop();
+        fclose(f_capture);
+    }
+
+    printf("Reset requested, flash image saved\r\n");
+    exit(0);
+}
+
+void system_reset_hard(void)
+{
+    system_reset_graceful();
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = "w25q128.bin";
+    const char* capturePath = NULL;
+    bool timing = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((0 == strcmp(argv[i], "-f")) && ((i + 1) < argc))
+        {
+            path = argv[++i];
+        }
+        else if ((0 == strcmp(argv[i], "-r")) && ((i + 1) < argc))
+        {
+            capturePath = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "-t"))
+        {
+            timing = true;
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (!W25Q_SIM_Open(path))
+    {
+        return 1;
+    }
+
+    if (capturePath != NULL)
+    {
+        f_capture = fopen(capturePath, "wb");
+        if (f_capture == NULL)
+        {
+            perror(capturePath);
+            W25Q_SIM_Close();
+            return 1;
+        }
+        SESSION_LOG_Start(CaptureWrite);
+    }
+
+    (void)signal(SIGINT, Terminate);
+    (void)signal(SIGTERM, Terminate);
+
+    W25Q_SIM_SetTiming(timing);
+    (void)FLASH_SCHED_Init();
+
+    printf("Simulated W25Q128 %s, timing %s\r\n", path, timing ? "on" : "off");
+
+    /* Returns only if the server could not start */
+    SERVER_UdpUpdateServer(&f_handle);
+
+    W25Q_SIM_Close();
+    return 1;
+}
+
+/* EoF updateserver_sim.c */
@@ -0,0 +1,266 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * w25q_sim.c
+ *
+ * @brief Simulated W25Q128 backed by a memory mapped image file. Busy times
+ *        are the typical values of the W25Q128JV datasheet, reads are timed
+ *        at the 21 MHz SPI clock of the target.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "w25q_sim.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define ERASE_VALUE         (0xFFU)
+
+#define PAGE_PROGRAM_US     (400U)
+#define ERASE_4K_US         (45000U)
+#define ERASE_32K_US        (120000U)
+#define ERASE_64K_US        (150000U)
+
+/* Command, address and dummy bytes of a fast read, and bytes per us */
+#define READ_OVERHEAD_BYTES (5U)
+#define SPI_BYTES_PER_US    (2.625)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static uint8_t* f_mem = NULL;
+static bool f_timing = false;
+static W25qSimStats_t f_stats;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static void Busy(uint64_t us)
+{
+    f_stats.busyUs += us;
+
+    if (f_timing && (us > 0U))
+    {
+        const struct timespec ts = {
+            .tv_sec = (time_t)(us / 1000000U),
+            .tv_nsec = (long)((us % 1000000U) * 1000U),
+        };
+        (void)nanosleep(&ts, NULL);
+    }
+}
+
+static bool InRange(uint32_t address, size_t size)
+{
+    return (f_mem != NULL) && (size <= W25Q_SIM_SIZE) && (address <= (W25Q_SIM_SIZE - size));
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+bool W25Q_SIM_Open(const char* path)
+{
+    int fd = -1;
+    bool fresh = true;
+
+    if (path != NULL)
+    {
+        struct stat st;
+        fresh = (stat(path, &st) != 0) || (st.st_size != (off_t)W25Q_SIM_SIZE);
+
+        fd = open(path, O_RDWR | O_CREAT, 0644);
+        if ((fd < 0) || (ftruncate(fd, W25Q_SIM_SIZE) != 0))
+        {
+            perror(path);
+            return false;
+        }
+    }
+
+    void* mem = mmap(NULL, W25Q_SIM_SIZE, PROT_READ | PROT_WRITE,
+        (fd < 0) ? (MAP_PRIVATE | MAP_ANONYMOUS) : MAP_SHARED, fd, 0);
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    if (mem == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+
+    f_mem = mem;
+    memset(&f_stats, 0, sizeof(f_stats));
+
+    if (fresh)
+    {
+        memset(f_mem, ERASE_VALUE, W25Q_SIM_SIZE);
+    }
+
+    return true;
+}
+
+void W25Q_SIM_Close(void)
+{
+    if (f_mem != NULL)
+    {
+        (void)msync(f_mem, W25Q_SIM_SIZE, MS_SYNC);
+        (void)munmap(f_mem, W25Q_SIM_SIZE);
+        f_mem = NULL;
+    }
+}
+
+void W25Q_SIM_SetTiming(bool enabled)
+{
+    f_timing = enabled;
+}
+
+bool W25Q_SIM_Read(uint32_t address, uint8_t* data, size_t size)
+{
+    if (!InRange(address, size))
+    {
+        return false;
+    }
+
+    memcpy(data, &f_mem[address], size);
+    const uint64_t us = (uint64_t)((double)(size + READ_OVERHEAD_BYTES) / SPI_BYTES_PER_US);
+    f_stats.bytesRead += size;
+    f_stats.readUs += us;
+    Busy(us);
+    return true;
+}
+
+bool W25Q_SIM_PageProgram(uint32_t address, const uint8_t* data, size_t size)
+{
+    if ((size > W25Q_SIM_PAGE_SIZE) || !InRange(address, 1U))
+    {
+        return false;
+    }
+
+    const uint32_t page = address & ~(W25Q_SIM_PAGE_SIZE - 1U);
+    uint32_t offset = address - page;
+
+    for (size_t i = 0U; i < size; i++)
+    {
+        uint8_t* cell = &f_mem[page + offset];
+
+        if ((*cell & data[i]) != data[i])
+        {
+            f_stats.programConflicts++;
+        }
+
+        /* Programming can only clear bits */
+        *cell &= data[i];
+        offset = (offset + 1U) % W25Q_SIM_PAGE_SIZE;
+    }
+
+    f_stats.pagePrograms++;
+    f_stats.bytesProgrammed += size;
+    Busy((uint64_t)((double)(size + 4U) / SPI_BYTES_PER_US) + PAGE_PROGRAM_US);
+    return true;
+}
+
+bool W25Q_SIM_Program(uint32_t address, const uint8_t* data, size_t size)
+{
+    if (!InRange(address, size))
+    {
+        return false;
+    }
+
+    while (size > 0U)
+    {
+        const size_t room = W25Q_SIM_PAGE_SIZE - (address % W25Q_SIM_PAGE_SIZE);
+        const size_t len = (size < room) ? size : room;
+
+        if (!W25Q_SIM_PageProgram(address, data, len))
+        {
+            return false;
+        }
+
+        address += (uint32_t)len;
+        data += len;
+        size -= len;
+    }
+
+    return true;
+}
+
+bool W25Q_SIM_EraseBlock(uint32_t address, uint32_t blockSize)
+{
+    if (((blockSize != 0x1000U) && (blockSize != 0x8000U) && (blockSize != 0x10000U)) ||
+        ((address % blockSize) != 0U) ||
+        !InRange(address, blockSize))
+    {
+        return false;
+    }
+
+    memset(&f_mem[address], ERASE_VALUE, blockSize);
+
+    if (blockSize == 0x1000U)
+    {
+        f_stats.erases4k++;
+        Busy(ERASE_4K_US);
+    }
+    else if (blockSize == 0x8000U)
+    {
+        f_stats.erases32k++;
+        Busy(ERASE_32K_US);
+    }
+    else
+    {
+        f_stats.erases64k++;
+        Busy(ERASE_64K_US);
+    }
+
+    return true;
+}
+
+uint8_t* W25Q_SIM_Memory(void)
+{
+    return f_mem;
+}
+
+W25qSimStats_t W25Q_SIM_GetStats(void)
+{
+    return f_stats;
+}
+
+/* EoF w25q_sim.c */
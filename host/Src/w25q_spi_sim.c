@@ -0,0 +1,339 @@
+/* MIT License
+ * 
+ * Copyright (c) 2025 Mikael Penttinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ * w25q_spi_sim.c
+ *
+ * @brief SPI command decoder of the simulated W25Q128. In single line SPI
+ *        mode the driver passes the instruction, address and dummy bytes in
+ *        the transmit buffer, the same way w25qxx_init.c receives them on
+ *        the target. The device is never busy between commands, the busy
+ *        time of programs and erases is counted by w25q_sim.
+*/
+
+/*----------------------------------------------------------------------------*/
+/* INCLUDE DIRECTIVES                                                         */
+/*----------------------------------------------------------------------------*/
+
+#include "w25q_spi_sim.h"
+#include "w25q_sim.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+/* MACRO DEFINITIONS                                                          */
+/*----------------------------------------------------------------------------*/
+
+#define CMD_WRITE_STATUS_1      (0x01U)
+#define CMD_PAGE_PROGRAM        (0x02U)
+#define CMD_READ_DATA           (0x03U)
+#define CMD_WRITE_DISABLE       (0x04U)
+#define CMD_READ_STATUS_1       (0x05U)
+#define CMD_WRITE_ENABLE        (0x06U)
+#define CMD_FAST_READ           (0x0BU)
+#define CMD_WRITE_STATUS_3      (0x11U)
+#define CMD_READ_STATUS_3       (0x15U)
+#define CMD_SECTOR_ERASE_4K     (0x20U)
+#define CMD_WRITE_STATUS_2      (0x31U)
+#define CMD_READ_STATUS_2       (0x35U)
+#define CMD_BLOCK_ERASE_32K     (0x52U)
+#define CMD_CHIP_ERASE          (0x60U)
+#define CMD_MANUFACTURER_ID     (0x90U)
+#define CMD_JEDEC_ID            (0x9FU)
+#define CMD_RELEASE_POWER_DOWN  (0xABU)
+#define CMD_CHIP_ERASE_ALT      (0xC7U)
+#define CMD_BLOCK_ERASE_64K     (0xD8U)
+
+#define READ_CMD_LEN            (4U)
+#define FAST_READ_CMD_LEN       (5U)
+
+#define STATUS_1_WEL            (0x02U)
+
+#define MANUFACTURER_WINBOND    (0xEFU)
+#define DEVICE_ID_W25Q128       (0x17U)
+#define JEDEC_MEMORY_TYPE       (0x40U)
+#define JEDEC_CAPACITY_16MB     (0x18U)
+
+/* 21 MHz SPI clock of the target */
+#define SPI_BYTES_PER_US        (2.625)
+
+#define BLOCK_64K               (0x10000U)
+
+/*----------------------------------------------------------------------------*/
+/* VARIABLE DEFINITIONS                                                       */
+/*----------------------------------------------------------------------------*/
+
+static w25qxx_handle_t f_handle;
+static uint8_t f_status[3];
+static W25qSpiSimStats_t f_stats;
+
+/*----------------------------------------------------------------------------*/
+/* PRIVATE FUNCTION DEFINITIONS                                               */
+/*----------------------------------------------------------------------------*/
+
+static uint32_t CommandAddress(const uint8_t* in_buf, uint32_t in_len)
+{
+    if (in_len < READ_CMD_LEN)
+    {
+        return UINT32_MAX;
+    }
+
+    return ((uint32_t)in_buf[1] << 16) | ((uint32_t)in_buf[2] << 8) | in_buf[3];
+}
+
+/** Erase commands need the write enable latch and clear it like programs */
+static bool Erase(uint32_t address, uint32_t blockSize)
+{
+    f_stats.erases++;
+
+    if ((f_status[0] & STATUS_1_WEL) == 0U)
+    {
+        return false;
+    }
+
+    f_status[0] &= (uint8_t)~STATUS_1_WEL;
+    return W25Q_SIM_EraseBlock(address, blockSize);
+}
+
+static bool ChipErase(void)
+{
+    f_stats.erases++;
+
+    if ((f_status[0] & STATUS_1_WEL) == 0U)
+    {
+        return false;
+    }
+
+    f_status[0] &= (uint8_t)~STATUS_1_WEL;
+
+    for (uint32_t address = 0U; address < W25Q_SIM_SIZE; address += BLOCK_64K)
+    {
+        if (!W25Q_SIM_EraseBlock(address, BLOCK_64K))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool PageProgram(const uint8_t* in_buf, uint32_t in_len)
+{
+    f_stats.pagePrograms++;
+
+    if (((f_status[0] & STATUS_1_WEL) == 0U) || (in_len < READ_CMD_LEN))
+    {
+        return false;
+    }
+
+    f_status[0] &= (uint8_t)~STATUS_1_WEL;
+    return W25Q_SIM_PageProgram(CommandAddress(in_buf, in_len), &in_buf[READ_CMD_LEN], in_len - READ_CMD_LEN);
+}
+
+static void FillRepeated(uint8_t* out_buf, uint32_t out_len, const uint8_t* pattern, uint32_t patternLen)
+{
+    for (uint32_t i = 0U; i < out_len; i++)
+    {
+        out_buf[i] = pattern[i % patternLen];
+    }
+}
+
+static bool Execute(const uint8_t* in_buf, uint32_t in_len, uint8_t* out_buf, uint32_t out_len)
+{
+    static const uint8_t manufacturerId[] = { MANUFACTURER_WINBOND, DEVICE_ID_W25Q128 };
+    static const uint8_t jedecId[] = { MANUFACTURER_WINBOND, JEDEC_MEMORY_TYPE, JEDEC_CAPACITY_16MB };
+    static const uint8_t deviceId[] = { DEVICE_ID_W25Q128 };
+
+    switch (in_buf[0])
+    {
+    case CMD_READ_DATA:
+    case CMD_FAST_READ:
+        f_stats.reads++;
+        return W25Q_SIM_Read(CommandAddress(in_buf, in_len), out_buf, out_len);
+
+    case CMD_PAGE_PROGRAM:
+        return PageProgram(in_buf, in_len);
+
+    case CMD_SECTOR_ERASE_4K:
+        return Erase(CommandAddress(in_buf, in_len), 0x1000U);
+
+    case CMD_BLOCK_ERASE_32K:
+        return Erase(CommandAddress(in_buf, in_len), 0x8000U);
+
+    case CMD_BLOCK_ERASE_64K:
+        return Erase(CommandAddress(in_buf, in_len), BLOCK_64K);
+
+    case CMD_CHIP_ERASE:
+    case CMD_CHIP_ERASE_ALT:
+        return ChipErase();
+
+    case CMD_READ_STATUS_1:
+    case CMD_READ_STATUS_2:
+    case CMD_READ_STATUS_3:
+        f_stats.statusReads++;
+        FillRepeated(out_buf, out_len,
+            &f_status[(in_buf[0] == CMD_READ_STATUS_1) ? 0U : (in_buf[0] == CMD_READ_STATUS_2) ? 1U : 2U], 1U);
+        return true;
+
+    case CMD_WRITE_ENABLE:
+        f_stats.writeEnables++;
+        f_status[0] |= STATUS_1_WEL;
+        return true;
+
+    case CMD_WRITE_DISABLE:
+        f_stats.writeEnables++;
+        f_status[0] &= (uint8_t)~STATUS_1_WEL;
+        return true;
+
+    case CMD_WRITE_STATUS_1:
+    case CMD_WRITE_STATUS_2:
+    case CMD_WRITE_STATUS_3:
+        f_stats.other++;
+        if (in_len > 1U)
+        {
+            f_status[(in_buf[0] == CMD_WRITE_STATUS_1) ? 0U : (in_buf[0] == CMD_WRITE_STATUS_2) ? 1U : 2U] =
+                (in_buf[0] == CMD_WRITE_STATUS_1) ? (uint8_t)(in_buf[1] & ~STATUS_1_WEL) : in_buf[1];
+        }
+        return true;
+
+    case CMD_MANUFACTURER_ID:
+        f_stats.other++;
+        FillRepeated(out_buf, out_len, manufacturerId, sizeof(manufacturerId));
+        return true;
+
+    case CMD_JEDEC_ID:
+        f_stats.other++;
+        FillRepeated(out_buf, out_len, jedecId, sizeof(jedecId));
+        return true;
+
+    case CMD_RELEASE_POWER_DOWN:
+        f_stats.other++;
+        FillRepeated(out_buf, out_len, deviceId, sizeof(deviceId));
+        return true;
+
+    default:
+        /* Resets, power down, unique ID and SFDP reads return zeros */
+        f_stats.other++;
+        memset(out_buf, 0, out_len);
+        return true;
+    }
+}
+
+static uint8_t SpiInit(void)
+{
+    return 0U;
+}
+
+static uint8_t SpiDeInit(void)
+{
+    return 0U;
+}
+
+static uint8_t SpiWriteRead(uint8_t instruction, uint8_t instruction_line,
+                            uint32_t address, uint8_t address_line, uint8_t address_len,
+                            uint32_t alternate, uint8_t alternate_line, uint8_t alternate_len,
+                            uint8_t dummy, uint8_t *in_buf, uint32_t in_len,
+                            uint8_t *out_buf, uint32_t out_len, uint8_t data_line)
+{
+    (void)instruction;
+    (void)address;
+    (void)address_len;
+    (void)alternate;
+    (void)alternate_len;
+
+    if ((instruction_line != 0) ||
+        (address_line != 0) ||
+        (alternate_line != 0) ||
+        (dummy != 0) ||
+        (data_line != 1) ||
+        (in_len == 0U))
+    {
+        return 1U;
+    }
+
+    f_stats.transactions++;
+    f_stats.bytesOut += in_len;
+    f_stats.bytesIn += out_len;
+    f_stats.transferUs += (uint64_t)((double)(in_len + out_len) / SPI_BYTES_PER_US);
+
+    return Execute(in_buf, in_len, out_buf, out_len) ? 0U : 1U;
+}
+
+static void DelayMs(uint32_t ms)
+{
+    (void)ms;
+}
+
+static void DelayUs(uint32_t us)
+{
+    (void)us;
+}
+
+static void DebugPrint(const char* const fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    (void)vprintf(fmt, args);
+    va_end(args);
+}
+
+/*----------------------------------------------------------------------------*/
+/* PUBLIC FUNCTION DEFINITIONS                                                */
+/*----------------------------------------------------------------------------*/
+
+w25qxx_handle_t* W25Q_SPI_SIM_Init(void)
+{
+    memset(&f_handle, 0, sizeof(f_handle));
+    memset(f_status, 0, sizeof(f_status));
+
+    DRIVER_W25QXX_LINK_INIT(&f_handle, w25qxx_handle_t);
+    DRIVER_W25QXX_LINK_SPI_QSPI_INIT(&f_handle, SpiInit);
+    DRIVER_W25QXX_LINK_SPI_QSPI_DEINIT(&f_handle, SpiDeInit);
+    DRIVER_W25QXX_LINK_SPI_QSPI_WRITE_READ(&f_handle, SpiWriteRead);
+    DRIVER_W25QXX_LINK_DELAY_MS(&f_handle, DelayMs);
+    DRIVER_W25QXX_LINK_DELAY_US(&f_handle, DelayUs);
+    DRIVER_W25QXX_LINK_DEBUG_PRINT(&f_handle, DebugPrint);
+
+    if ((0U != w25qxx_set_type(&f_handle, W25Q128)) ||
+        (0U != w25qxx_set_interface(&f_handle, W25QXX_INTERFACE_SPI)) ||
+        (0U != w25qxx_set_dual_quad_spi(&f_handle, W25QXX_BOOL_FALSE)) ||
+        (0U != w25qxx_init(&f_handle)))
+    {
+        fprintf(stderr, "w25qxx_init failed\n");
+        return NULL;
+    }
+
+    memset(&f_stats, 0, sizeof(f_stats));
+    return &f_handle;
+}
+
+W25qSpiSimStats_t W25Q_SPI_SIM_GetStats(void)
+{
+    return f_stats;
+}
+
+/* EoF w25q_spi_sim.c */
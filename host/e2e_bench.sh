@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# End-to-end update benchmark. Runs updateserver_sim behind udp_proxy and
+# uploads a signed image with updateclient through the proxy. Prints the
+# proxy JSON line extended with the client run time, exit status and the
+# busy NACKs answered by the server.
+#
+#   e2e_bench.sh <bin dir> <updateclient> <signed.hex> [udp_proxy options]
+#
+
+BIN=$1
+CLIENT=$2
+IMAGE=$3
+shift 3
+
+WORK=$(mktemp -d)
+
+"$BIN/updateserver_sim" -f "$WORK/w25q128.bin" -t > "$WORK/server.log" 2>&1 &
+SERVER=$!
+"$BIN/udp_proxy" -l 7000 -s 127.0.0.1:7007 -i 3600 "$@" > "$WORK/proxy.json" &
+PROXY=$!
+sleep 1
+
+START=$(date +%s%N)
+"$CLIENT" -a 127.0.0.1 -p 7000 upload "$IMAGE" > "$WORK/client.log" 2>&1
+STATUS=$?
+END=$(date +%s%N)
+
+kill -TERM $PROXY
+wait $PROXY
+kill -TERM $SERVER
+wait $SERVER
+
+BUSY=$(sed -n 's/^Answered \([0-9]*\) busy requests.*/\1/p' "$WORK/server.log")
+CLIENT_MS=$(( (END - START) / 1000000 ))
+
+sed "s/}\$/,\"client_ms\":$CLIENT_MS,\"client_status\":$STATUS,\"nack_busy\":${BUSY:-null}}/" "$WORK/proxy.json"
+echo "Logs in $WORK" >&2
+exit $STATUS